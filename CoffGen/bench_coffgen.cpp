@@ -0,0 +1,143 @@
+// time of the builders an import member is made of, per call:
+//
+// usage: bench_coffgen [--json <file>] [count ...]
+//
+// AddSymbol: count extern symbols with long names into the symbol table of a
+//   coff builder, their names going to its string table
+// AppendString: count names into a string table of its own
+// AppendData: count 8-byte pieces into a section, every fourth relocated
+// GetRawData: the object of AddSymbol, GetDataLength and GetRawData
+//
+// counts are 100, 1k and 10k by default: AddSymbol looks the name up in the
+// symbols added before (FindSymbol), the time per symbol grows with the
+// object, and an object of an import library has a handful of them.
+// the allocations of every case are counted by the counting operator new
+// (coffHooks.h). with --json every result is also written to the file as a
+// JSON line:
+// {"bench": "coffgen", "case": "AddSymbol", "n": 1000, "ms": 0.1, "ns_per_item": 100.0,
+//  "allocs_per_item": 2.00, "alloc_bytes_per_item": 48.0}
+
+#include "cofffactory.h"
+#include "coffHooks.h"
+#include "coffInterfaces.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace Sora;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+static FILE *json = 0;
+
+// before: the allocation totals at the start of the case
+static void Report(const char *name, int n, double ms,
+                   const AllocStats &before) {
+  AllocStats after = GetAllocTotals();
+  double allocs = (double)(after.count - before.count) / n;
+  double bytes = (double)(after.bytes - before.bytes) / n;
+  printf("%-14s %9d %10.2f %12.1f %12.2f %12.1f\n", name, n, ms, ms * 1e6 / n,
+         allocs, bytes);
+  if (json)
+    fprintf(json,
+            "{\"bench\": \"coffgen\", \"case\": \"%s\", \"n\": %d, "
+            "\"ms\": %.3f, \"ns_per_item\": %.1f, \"allocs_per_item\": %.2f, "
+            "\"alloc_bytes_per_item\": %.1f}\n",
+            name, n, ms, ms * 1e6 / n, allocs, bytes);
+}
+
+// names like the thunks of a big dll, longer than the 8 bytes kept inline
+static std::vector<std::string> MakeNames(int n) {
+  std::vector<std::string> names(n);
+  char buf[64];
+  for (int i = 0; i < n; ++i) {
+    snprintf(buf, sizeof(buf), "__imp_BenchFunction%07dEx", i);
+    names[i] = buf;
+  }
+  return names;
+}
+
+static void Bench(int n) {
+  ICoffFactory *fac = GetX64CoffFactory();
+  std::vector<std::string> names = MakeNames(n);
+
+  ICoffBuilder *coff = fac->CreateCoffBuilder();
+  ISectionBuilder *text = fac->CreateSectionBuilder();
+  text->SetName(".text");
+  text->SetCharacteristics(SECH_READ | SECH_EXEC | SECH_CODE | SECH_ALIGN16);
+  coff->AppendSection(text);
+  ISymbolTableBuilder *symbols = coff->GetSymbolTableBuilder();
+
+  AllocStats before = GetAllocTotals();
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < n; ++i)
+    symbols->AddSymbol(text, i * 8, names[i].c_str(), SYST_EXTERN, 0);
+  Report("AddSymbol", n, MsSince(start), before);
+
+  IStringTableBuilder *strings = fac->CreateStringTableBuilder();
+  before = GetAllocTotals();
+  start = Clock::now();
+  for (int i = 0; i < n; ++i)
+    strings->AppendString(names[i].c_str());
+  Report("AppendString", n, MsSince(start), before);
+  strings->Dispose();
+
+  // relocations against the symbols added above
+  BYTE data[8] = {0};
+  before = GetAllocTotals();
+  start = Clock::now();
+  for (int i = 0; i < n; ++i) {
+    if (i % 4 == 0) {
+      IRelocatableVar *reloc[1] = {fac->CreateRelocatableVar()};
+      reloc[0]->Set(names[i].c_str(), text, 0, 0, VARelocate64);
+      text->AppendData(data, sizeof(data), reloc, 1);
+    } else {
+      text->AppendData(data, sizeof(data), 0, 0);
+    }
+  }
+  Report("AppendData", n, MsSince(start), before);
+
+  before = GetAllocTotals();
+  start = Clock::now();
+  coff->PushRelocs();
+  std::vector<BYTE> raw(coff->GetDataLength());
+  coff->GetRawData(raw.data());
+  Report("GetRawData", n, MsSince(start), before);
+  coff->Dispose();
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<int> counts;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      json = fopen(argv[++i], "w");
+      if (json == 0) {
+        printf("Fail to create %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else {
+      counts.push_back(atoi(argv[i]));
+    }
+  }
+  if (counts.empty())
+    counts = {100, 1000, 10000};
+
+  printf("%-14s %9s %10s %12s %12s %12s\n", "case", "n", "ms", "ns/item",
+         "allocs/item", "bytes/item");
+  EnableAllocCounting(true);
+  for (size_t i = 0; i < counts.size(); ++i)
+    Bench(counts[i]);
+
+  if (json)
+    fclose(json);
+  return 0;
+}
@@ -0,0 +1,290 @@
+#ifndef COFFFORMAT_H
+#define COFFFORMAT_H
+
+// the PE/COFF and archive definitions of winnt.h the modules use, and the
+// few Win32 string functions of the builders. on Windows they come from the
+// SDK; elsewhere from here, laid out as in winnt.h (packed where it packs),
+// so the output is the same byte for byte on every host. the builders copy
+// the structures straight into the output: little-endian hosts only.
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+#else
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "PE/COFF structures are little-endian, big-endian hosts are not supported"
+#endif
+
+// types
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t DWORD32;
+typedef uint64_t DWORD64;
+typedef uint64_t ULONGLONG;
+typedef int16_t SHORT;
+typedef int32_t LONG;
+typedef char CHAR;
+
+typedef BYTE *PBYTE, *LPBYTE;
+typedef const BYTE *LPCBYTE;
+typedef WORD *PWORD;
+typedef DWORD *PDWORD;
+typedef DWORD32 *PDWORD32;
+typedef void *LPVOID;
+typedef CHAR *LPSTR;
+typedef const CHAR *LPCSTR;
+typedef const CHAR *LPCTSTR;
+
+#ifndef TEXT
+#define TEXT(s) s
+#endif
+
+// Win32 string functions
+
+inline int lstrlenA(LPCSTR s) { return s ? (int)strlen(s) : 0; }
+
+inline LPSTR lstrcpyA(LPSTR to, LPCSTR from) { return strcpy(to, from); }
+
+inline int lstrcmpA(LPCSTR a, LPCSTR b) { return strcmp(a, b); }
+
+inline int wsprintfA(LPSTR buf, LPCSTR fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  // wsprintf never writes more than 1024 chars
+  int r = vsnprintf(buf, 1025, fmt, args);
+  va_end(args);
+  return r;
+}
+
+#define ZeroMemory(p, len) memset((p), 0, (len))
+
+// COFF file header
+
+#define IMAGE_FILE_MACHINE_UNKNOWN 0
+#define IMAGE_FILE_MACHINE_I386 0x014c
+#define IMAGE_FILE_MACHINE_IA64 0x0200
+#define IMAGE_FILE_MACHINE_AMD64 0x8664
+#define IMAGE_FILE_MACHINE_ARM64 0xAA64
+
+#define IMAGE_FILE_DLL 0x2000
+
+typedef struct _IMAGE_FILE_HEADER {
+  WORD Machine;
+  WORD NumberOfSections;
+  DWORD TimeDateStamp;
+  DWORD PointerToSymbolTable;
+  DWORD NumberOfSymbols;
+  WORD SizeOfOptionalHeader;
+  WORD Characteristics;
+} IMAGE_FILE_HEADER, *PIMAGE_FILE_HEADER;
+
+// section header
+
+#define IMAGE_SIZEOF_SHORT_NAME 8
+
+typedef struct _IMAGE_SECTION_HEADER {
+  BYTE Name[IMAGE_SIZEOF_SHORT_NAME];
+  union {
+    DWORD PhysicalAddress;
+    DWORD VirtualSize;
+  } Misc;
+  DWORD VirtualAddress;
+  DWORD SizeOfRawData;
+  DWORD PointerToRawData;
+  DWORD PointerToRelocations;
+  DWORD PointerToLinenumbers;
+  WORD NumberOfRelocations;
+  WORD NumberOfLinenumbers;
+  DWORD Characteristics;
+} IMAGE_SECTION_HEADER, *PIMAGE_SECTION_HEADER;
+
+#define IMAGE_SCN_CNT_CODE 0x00000020
+#define IMAGE_SCN_CNT_INITIALIZED_DATA 0x00000040
+#define IMAGE_SCN_CNT_UNINITIALIZED_DATA 0x00000080
+#define IMAGE_SCN_LNK_INFO 0x00000200
+#define IMAGE_SCN_LNK_REMOVE 0x00000800
+#define IMAGE_SCN_LNK_COMDAT 0x00001000
+#define IMAGE_SCN_ALIGN_1BYTES 0x00100000
+#define IMAGE_SCN_ALIGN_2BYTES 0x00200000
+#define IMAGE_SCN_ALIGN_4BYTES 0x00300000
+#define IMAGE_SCN_ALIGN_8BYTES 0x00400000
+#define IMAGE_SCN_ALIGN_16BYTES 0x00500000
+#define IMAGE_SCN_ALIGN_32BYTES 0x00600000
+#define IMAGE_SCN_ALIGN_64BYTES 0x00700000
+#define IMAGE_SCN_MEM_EXECUTE 0x20000000
+#define IMAGE_SCN_MEM_READ 0x40000000
+#define IMAGE_SCN_MEM_WRITE 0x80000000
+
+// symbol table, relocations (winnt.h packs these to 2 bytes)
+
+#pragma pack(push, 2)
+
+typedef struct _IMAGE_SYMBOL {
+  union {
+    BYTE ShortName[8];
+    struct {
+      DWORD Short;
+      DWORD Long;
+    } Name;
+    DWORD LongName[2];
+  } N;
+  DWORD Value;
+  SHORT SectionNumber;
+  WORD Type;
+  BYTE StorageClass;
+  BYTE NumberOfAuxSymbols;
+} IMAGE_SYMBOL, *PIMAGE_SYMBOL;
+
+typedef union _IMAGE_AUX_SYMBOL {
+  struct {
+    DWORD Length;
+    WORD NumberOfRelocations;
+    WORD NumberOfLinenumbers;
+    DWORD CheckSum;
+    SHORT Number;
+    BYTE Selection;
+    BYTE bReserved;
+    SHORT HighNumber;
+  } Section;
+  struct {
+    BYTE Name[18];
+  } File;
+} IMAGE_AUX_SYMBOL, *PIMAGE_AUX_SYMBOL;
+
+typedef struct _IMAGE_RELOCATION {
+  union {
+    DWORD VirtualAddress;
+    DWORD RelocCount;
+  };
+  DWORD SymbolTableIndex;
+  WORD Type;
+} IMAGE_RELOCATION, *PIMAGE_RELOCATION;
+
+#pragma pack(pop)
+
+#define IMAGE_SIZEOF_SYMBOL 18
+#define IMAGE_SIZEOF_AUX_SYMBOL 18
+#define IMAGE_SIZEOF_RELOCATION 10
+
+#define IMAGE_SYM_UNDEFINED 0
+#define IMAGE_SYM_ABSOLUTE -1
+#define IMAGE_SYM_DEBUG -2
+
+#define IMAGE_SYM_DTYPE_NULL 0
+#define IMAGE_SYM_DTYPE_FUNCTION 2
+
+#define IMAGE_SYM_CLASS_EXTERNAL 0x0002
+#define IMAGE_SYM_CLASS_STATIC 0x0003
+#define IMAGE_SYM_CLASS_LABEL 0x0006
+#define IMAGE_SYM_CLASS_FUNCTION 0x0065
+#define IMAGE_SYM_CLASS_FILE 0x0067
+#define IMAGE_SYM_CLASS_SECTION 0x0068
+#define IMAGE_SYM_CLASS_WEAK_EXTERNAL 0x0069
+
+#define IMAGE_COMDAT_SELECT_NODUPLICATES 1
+#define IMAGE_COMDAT_SELECT_ANY 2
+#define IMAGE_COMDAT_SELECT_SAME_SIZE 3
+#define IMAGE_COMDAT_SELECT_EXACT_MATCH 4
+#define IMAGE_COMDAT_SELECT_ASSOCIATIVE 5
+#define IMAGE_COMDAT_SELECT_LARGEST 6
+
+#define IMAGE_REL_I386_DIR32 0x0006
+#define IMAGE_REL_I386_DIR32NB 0x0007
+
+#define IMAGE_REL_AMD64_ADDR64 0x0001
+#define IMAGE_REL_AMD64_ADDR32 0x0002
+#define IMAGE_REL_AMD64_ADDR32NB 0x0003
+
+#define IMAGE_REL_IA64_DIR32 0x0004
+#define IMAGE_REL_IA64_DIR64 0x0005
+#define IMAGE_REL_IA64_DIR32NB 0x0010
+
+// import descriptors
+
+#define IMAGE_ORDINAL_FLAG64 0x8000000000000000ull
+#define IMAGE_ORDINAL_FLAG32 0x80000000
+
+typedef struct _IMAGE_IMPORT_DESCRIPTOR {
+  union {
+    DWORD Characteristics;
+    DWORD OriginalFirstThunk;
+  };
+  DWORD TimeDateStamp;
+  DWORD ForwarderChain;
+  DWORD Name;
+  DWORD FirstThunk;
+} IMAGE_IMPORT_DESCRIPTOR, *PIMAGE_IMPORT_DESCRIPTOR;
+
+// archive (library) format
+
+#define IMAGE_ARCHIVE_START_SIZE 8
+#define IMAGE_ARCHIVE_START "!<arch>\n"
+#define IMAGE_ARCHIVE_END "`\n"
+#define IMAGE_ARCHIVE_PAD "\n"
+#define IMAGE_ARCHIVE_LINKER_MEMBER "/               "
+#define IMAGE_ARCHIVE_LONGNAMES_MEMBER "//              "
+
+typedef struct _IMAGE_ARCHIVE_MEMBER_HEADER {
+  BYTE Name[16];
+  BYTE Date[12];
+  BYTE UserID[6];
+  BYTE GroupID[6];
+  BYTE Mode[8];
+  BYTE Size[10];
+  BYTE EndHeader[2];
+} IMAGE_ARCHIVE_MEMBER_HEADER, *PIMAGE_ARCHIVE_MEMBER_HEADER;
+
+#define IMAGE_SIZEOF_ARCHIVE_MEMBER_HDR 60
+
+// image headers
+
+#define IMAGE_DOS_SIGNATURE 0x5A4D
+#define IMAGE_NT_SIGNATURE 0x00004550
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC 0x10b
+#define IMAGE_NT_OPTIONAL_HDR64_MAGIC 0x20b
+#define IMAGE_DIRECTORY_ENTRY_EXPORT 0
+
+typedef struct _IMAGE_DATA_DIRECTORY {
+  DWORD VirtualAddress;
+  DWORD Size;
+} IMAGE_DATA_DIRECTORY, *PIMAGE_DATA_DIRECTORY;
+
+typedef struct _IMAGE_EXPORT_DIRECTORY {
+  DWORD Characteristics;
+  DWORD TimeDateStamp;
+  WORD MajorVersion;
+  WORD MinorVersion;
+  DWORD Name;
+  DWORD Base;
+  DWORD NumberOfFunctions;
+  DWORD NumberOfNames;
+  DWORD AddressOfFunctions;
+  DWORD AddressOfNames;
+  DWORD AddressOfNameOrdinals;
+} IMAGE_EXPORT_DIRECTORY, *PIMAGE_EXPORT_DIRECTORY;
+
+#endif // _WIN32
+
+static_assert(sizeof(IMAGE_FILE_HEADER) == 20, "bad IMAGE_FILE_HEADER");
+static_assert(sizeof(IMAGE_SECTION_HEADER) == 40, "bad IMAGE_SECTION_HEADER");
+static_assert(sizeof(IMAGE_SYMBOL) == 18, "bad IMAGE_SYMBOL");
+static_assert(sizeof(IMAGE_AUX_SYMBOL) == 18, "bad IMAGE_AUX_SYMBOL");
+static_assert(sizeof(IMAGE_RELOCATION) == 10, "bad IMAGE_RELOCATION");
+static_assert(sizeof(IMAGE_IMPORT_DESCRIPTOR) == 20,
+              "bad IMAGE_IMPORT_DESCRIPTOR");
+static_assert(sizeof(IMAGE_ARCHIVE_MEMBER_HEADER) == 60,
+              "bad IMAGE_ARCHIVE_MEMBER_HEADER");
+static_assert(sizeof(IMAGE_EXPORT_DIRECTORY) == 40,
+              "bad IMAGE_EXPORT_DIRECTORY");
+
+#endif
@@ -0,0 +1,96 @@
+#include "coffHooks.h"
+
+#include <atomic>
+
+namespace Sora {
+static std::atomic<IBuildListener *> g_listener(0);
+
+thread_local BuildPhase t_currentPhase = BP_COUNT;
+
+struct AllocCounters {
+  std::atomic<long long> count;
+  std::atomic<long long> bytes;
+  std::atomic<long long> peakLive;
+};
+// by phase, BP_COUNT for outside any phase
+static AllocCounters g_allocs[BP_COUNT + 1];
+static std::atomic<long long> g_liveBytes(0);
+static std::atomic<bool> g_allocCounting(false);
+static std::atomic<bool> g_allocHookLinked(false);
+
+extern "C" IBuildListener *SetBuildListener(IBuildListener *listener) {
+  return g_listener.exchange(listener);
+}
+
+IBuildListener *GetBuildListener() {
+  return g_listener.load(std::memory_order_acquire);
+}
+
+void SetAllocHookLinked() { g_allocHookLinked = true; }
+
+bool EnableAllocCounting(bool on) {
+  g_allocCounting = on && g_allocHookLinked;
+  return g_allocHookLinked;
+}
+
+bool IsAllocCounting() {
+  return g_allocCounting.load(std::memory_order_relaxed);
+}
+
+void ResetAllocStats() {
+  for (int i = 0; i <= BP_COUNT; ++i) {
+    g_allocs[i].count = 0;
+    g_allocs[i].bytes = 0;
+    g_allocs[i].peakLive = 0;
+  }
+}
+
+void CountAlloc(size_t bytes) {
+  AllocCounters &c = g_allocs[t_currentPhase];
+  c.count.fetch_add(1, std::memory_order_relaxed);
+  c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  long long live =
+      g_liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  long long peak = c.peakLive.load(std::memory_order_relaxed);
+  while (live > peak && !c.peakLive.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed))
+    ;
+}
+
+void CountFree(size_t bytes) {
+  g_liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+AllocStats GetAllocStats(BuildPhase phase) {
+  const AllocCounters &c = g_allocs[phase < BP_COUNT ? phase : BP_COUNT];
+  AllocStats r = {c.count.load(), c.bytes.load(), c.peakLive.load()};
+  return r;
+}
+
+AllocStats GetAllocTotals() {
+  AllocStats r = {0, 0, 0};
+  for (int i = 0; i <= BP_COUNT; ++i) {
+    AllocStats s = GetAllocStats((BuildPhase)i);
+    r.count += s.count;
+    r.bytes += s.bytes;
+    if (s.peakLive > r.peakLive)
+      r.peakLive = s.peakLive;
+  }
+  return r;
+}
+
+long long GetLiveBytes() { return g_liveBytes.load(); }
+
+const char *GetBuildPhaseName(BuildPhase phase) {
+  static const char *names[BP_COUNT] = {
+      "parse",       "addimport",   "descriptor", "pushrelocs", "build",
+      "linkmembers", "filloffsets", "rawdata",    "write"};
+  return phase < BP_COUNT ? names[phase] : "";
+}
+
+const char *GetBuildCounterName(BuildCounter counter) {
+  static const char *names[BC_COUNT] = {"exports", "members", "symbols",
+                                        "bytes"};
+  return counter < BC_COUNT ? names[counter] : "";
+}
+}; // namespace Sora
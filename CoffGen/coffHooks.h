@@ -0,0 +1,124 @@
+#ifndef COFFHOOKS_H
+#define COFFHOOKS_H
+
+#include "coffTrace.h"
+
+#include <cstddef>
+
+namespace Sora {
+// the phases of making a library. the builders report the library phases,
+// frontends report the others around them
+enum BuildPhase {
+  BP_PARSE,       // frontend: reading the export list
+  BP_ADDIMPORT,   // AddImportFunctionBy...: building one member object
+  BP_DESCRIPTOR,  // the import descriptors and null thunks of the dlls
+  BP_PUSHRELOCS,  // ICoffBuilder::PushRelocs, in BP_ADDIMPORT for the imports
+  BP_BUILD,       // IImportLibraryBuilder::Build, includes BP_LINKMEMBERS,
+                  // BP_FILLOFFSETS and, for a sharded library, the shards'
+                  // BP_ADDIMPORT
+  BP_LINKMEMBERS, // sorting and merging the symbol index of the link members
+  BP_FILLOFFSETS, // ILibraryBuilder::FillOffsets
+  BP_RAWDATA,     // GetRawData of the library
+  BP_WRITE,       // frontend: writing the library
+  BP_COUNT
+};
+
+enum BuildCounter {
+  BC_EXPORTS, // frontend: symbols of the export list
+  BC_MEMBERS, // archive members added
+  BC_SYMBOLS, // public symbols of the members, the linker member entries
+  BC_BYTES,   // bytes of library data produced by GetRawData
+  BC_COUNT
+};
+
+// receives the phases and counters of every thread. phases of one thread
+// nest, but several threads report at the same time: implementations must be
+// thread-safe
+class IBuildListener {
+public:
+  virtual void PhaseBegin(BuildPhase) = 0;
+  virtual void PhaseEnd(BuildPhase) = 0;
+  virtual void Count(BuildCounter, long long n) = 0;
+};
+
+// install the process wide listener, 0 to remove it
+// return: the previous listener
+extern "C" IBuildListener *SetBuildListener(IBuildListener *);
+IBuildListener *GetBuildListener();
+
+inline void CountBuild(BuildCounter c, long long n) {
+  IBuildListener *l = GetBuildListener();
+  if (l != 0)
+    l->Count(c, n);
+}
+
+// the innermost phase open on this thread, BP_COUNT outside any phase
+extern thread_local BuildPhase t_currentPhase;
+
+// name of a phase or a counter for reports: parse, addimport, ...
+const char *GetBuildPhaseName(BuildPhase);
+const char *GetBuildCounterName(BuildCounter);
+
+// reports a phase for the lifetime of the object, and traces it as a span
+class CPhaseScope {
+  IBuildListener *m_listener;
+  BuildPhase m_phase;
+  BuildPhase m_outer;
+#ifdef IMPLIBGEN_TRACE
+  CTraceScope m_trace;
+#endif
+
+public:
+  explicit CPhaseScope(BuildPhase phase)
+      : m_listener(GetBuildListener()), m_phase(phase),
+        m_outer(t_currentPhase)
+#ifdef IMPLIBGEN_TRACE
+        ,
+        m_trace(GetBuildPhaseName(phase))
+#endif
+  {
+    t_currentPhase = phase;
+    if (m_listener != 0)
+      m_listener->PhaseBegin(phase);
+  }
+
+  ~CPhaseScope() {
+    if (m_listener != 0)
+      m_listener->PhaseEnd(m_phase);
+    t_currentPhase = m_outer;
+  }
+};
+
+// allocation accounting, off by default. the counting operator new of
+// coffNew.cpp, linked into a program, reports every allocation and free here
+// while counting is on. an allocation is counted against the innermost phase
+// open on its thread (BP_COUNT: outside any phase), its free against the
+// process, whenever it comes; the frees of blocks allocated with counting off
+// are not counted. sizes are those malloc gives, usually a little more than
+// asked.
+struct AllocStats {
+  long long count;    // allocations
+  long long bytes;    // bytes allocated
+  long long peakLive; // the most bytes allocated and not freed yet at an
+                      // allocation of the phase, over the whole process
+};
+
+// return: false if the counting operator new isn't linked, nothing counted
+bool EnableAllocCounting(bool on);
+bool IsAllocCounting();
+// zeroes the counters, the live bytes stay
+void ResetAllocStats();
+// phase: BP_COUNT for the allocations outside any phase
+AllocStats GetAllocStats(BuildPhase phase);
+// the sum over all the phases and outside
+AllocStats GetAllocTotals();
+// bytes of the counted allocations not freed yet
+long long GetLiveBytes();
+
+// for coffNew.cpp
+void SetAllocHookLinked();
+void CountAlloc(size_t bytes);
+void CountFree(size_t bytes);
+}; // namespace Sora
+
+#endif
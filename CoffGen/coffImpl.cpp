@@ -1,5 +1,6 @@
 #include "cofffactory.h"
-#include "coffinterfaces.h"
+#include "coffHooks.h"
+#include "coffInterfaces.h"
 
 #include <algorithm>
 #include <string>
@@ -60,12 +61,21 @@ BYTE ArchTraits<ArchIA64>::PadData = 0x00;
 
 template <class T> class CDispose : public T {
 protected:
-  virtual ~CDispose() = 0 {}
+  virtual ~CDispose() = 0;
 
 public:
   void Dispose() { delete this; }
 };
 
+template <class T> CDispose<T>::~CDispose() {}
+
+template <typename Arch> class CCoffBuilder;
+template <typename Arch> class CSectionBuilder;
+template <typename Arch> class CSymbolTableBuilder;
+template <typename Arch> class CStringTableBuilder;
+template <typename Arch> class CRelocatableVar;
+template <typename Arch> class CRelocationTableBuilder;
+
 template <typename Arch> class CCoffFactory : public ICoffFactory {
 public:
   ICoffBuilder *CreateCoffBuilder() { return new CCoffBuilder<Arch>(); }
@@ -132,6 +142,7 @@ public:
   ISymbolTableBuilder *GetSymbolTableBuilder() { return m_symbolTable; }
 
   void PushRelocs() {
+    CPhaseScope phase(BP_PUSHRELOCS);
     Sections::iterator i, iend;
     for (i = m_sections.begin(), iend = m_sections.end(); i != iend; ++i) {
       (*i)->PushRelocs(m_symbolTable);
@@ -269,6 +280,9 @@ public:
   ~CSectionBuilder() { m_relocTable->Dispose(); }
 
   void SetName(LPCSTR p) {
+    // short names are NUL-padded, don't leak stack garbage into the header
+    std::fill(m_name, m_name + IMAGE_SIZEOF_SHORT_NAME, 0);
+
     int pl = lstrlenA(p);
     if (pl >= IMAGE_SIZEOF_SHORT_NAME) // no long name support
       std::copy(p, p + IMAGE_SIZEOF_SHORT_NAME, m_name);
@@ -602,7 +616,7 @@ public:
     }
   }
 
-  int GetPtrLength() { return sizeof(ArchTraits<Arch>::UIntPtr); }
+  int GetPtrLength() { return sizeof(typename ArchTraits<Arch>::UIntPtr); }
 
   int GetCount() { return m_relocs.size(); }
 
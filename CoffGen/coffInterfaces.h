@@ -1,7 +1,7 @@
 #ifndef COFFINTERFACES_H
 #define COFFINTERFACES_H
 
-#include <Windows.h>
+#include "coffFormat.h"
 
 namespace Sora {
 // indicate that the object offers method to free
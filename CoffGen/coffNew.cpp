@@ -0,0 +1,81 @@
+// the counting global operator new and delete of the allocation accounting
+// (coffHooks.h). linked into a program as an object of its own, the
+// coffgen_new object library; with counting off an allocation costs a
+// header of 16 bytes and one relaxed atomic load more than malloc.
+
+#include "coffHooks.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#define MallocSize _msize
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define MallocSize malloc_size
+#else
+#include <malloc.h>
+#define MallocSize malloc_usable_size
+#endif
+
+namespace {
+struct CHookLinked {
+  CHookLinked() { Sora::SetAllocHookLinked(); }
+} s_linked;
+
+// every block starts with the bytes counted for it, 0 if it was allocated
+// with counting off: only the frees of counted blocks are counted, those of
+// blocks from before the start never take the live bytes down
+const size_t HeaderSize = alignof(std::max_align_t);
+
+void *Allocate(size_t size) {
+  if (size > (size_t)-1 - HeaderSize)
+    return 0;
+  char *block = (char *)malloc(size + HeaderSize);
+  if (block == 0)
+    return 0;
+  size_t counted = 0;
+  if (Sora::IsAllocCounting()) {
+    counted = MallocSize(block) - HeaderSize;
+    Sora::CountAlloc(counted);
+  }
+  *(size_t *)block = counted;
+  return block + HeaderSize;
+}
+
+void Free(void *p) {
+  if (p == 0)
+    return;
+  char *block = (char *)p - HeaderSize;
+  size_t counted = *(size_t *)block;
+  if (counted != 0)
+    Sora::CountFree(counted);
+  free(block);
+}
+} // namespace
+
+void *operator new(size_t size) {
+  void *p = Allocate(size);
+  if (p == 0)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return Allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return Allocate(size);
+}
+
+void operator delete(void *p) noexcept { Free(p); }
+void operator delete[](void *p) noexcept { Free(p); }
+void operator delete(void *p, size_t) noexcept { Free(p); }
+void operator delete[](void *p, size_t) noexcept { Free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { Free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { Free(p); }
@@ -0,0 +1,184 @@
+#include "coffTrace.h"
+
+#ifdef IMPLIBGEN_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Sora {
+typedef std::chrono::steady_clock Clock;
+
+struct TraceEvent {
+  char type; // X: span, C: counter
+  const char *name;
+  const char *argName;
+  std::string arg;
+  bool quote;
+  long long ts; // ns since StartTrace
+  long long dur;
+};
+
+// the events of one thread, only that thread appends to them. the lock
+// keeps StartTrace and WriteTrace off a vector being appended to: a thread
+// may be past IsTracing when the trace is written
+struct TraceThread {
+  int tid;
+  std::mutex lock;
+  std::vector<TraceEvent> events;
+
+  void Append(TraceEvent &&ev) {
+    std::lock_guard<std::mutex> l(lock);
+    events.push_back(std::move(ev));
+  }
+};
+
+static std::atomic<bool> g_tracing(false);
+// Clock::time_point::rep of the start, read by every thread
+static std::atomic<Clock::rep> g_start(0);
+static std::mutex g_lock;
+// threads that ended keep their events here
+static std::vector<std::unique_ptr<TraceThread>> g_threads;
+static int g_mainTid = 0;
+static thread_local TraceThread *t_thread = 0;
+
+static TraceThread &ThisThread() {
+  if (t_thread == 0) {
+    std::lock_guard<std::mutex> l(g_lock);
+    TraceThread *t = new TraceThread;
+    t->tid = (int)g_threads.size();
+    g_threads.emplace_back(t);
+    t_thread = t;
+  }
+  return *t_thread;
+}
+
+static long long Now() {
+  Clock::time_point start(
+      Clock::duration(g_start.load(std::memory_order_relaxed)));
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                              start)
+      .count();
+}
+
+void StartTrace() {
+  g_mainTid = ThisThread().tid;
+  {
+    std::lock_guard<std::mutex> l(g_lock);
+    for (size_t i = 0; i < g_threads.size(); ++i) {
+      std::lock_guard<std::mutex> t(g_threads[i]->lock);
+      g_threads[i]->events.clear();
+    }
+  }
+  g_start = Clock::now().time_since_epoch().count();
+  g_tracing = true;
+}
+
+bool IsTracing() { return g_tracing.load(std::memory_order_relaxed); }
+
+static void WriteString(FILE *f, const std::string &s) {
+  fputc('"', f);
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+bool WriteTrace(const char *path) {
+  g_tracing = false;
+  FILE *f = fopen(path, "w");
+  if (f == 0)
+    return false;
+
+  std::lock_guard<std::mutex> l(g_lock);
+  fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+             "\"tid\": %d, \"args\": {\"name\": \"implibgen\"}}",
+          g_mainTid);
+  for (size_t i = 0; i < g_threads.size(); ++i) {
+    TraceThread &t = *g_threads[i];
+    std::lock_guard<std::mutex> tl(t.lock);
+    char name[32];
+    if (t.tid == g_mainTid)
+      snprintf(name, sizeof(name), "main");
+    else
+      snprintf(name, sizeof(name), "thread %d", t.tid);
+    fprintf(f,
+            ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+            t.tid, name);
+    for (size_t e = 0; e < t.events.size(); ++e) {
+      const TraceEvent &ev = t.events[e];
+      fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": 1, "
+                 "\"tid\": %d, \"ts\": %.3f",
+              ev.name, ev.type, t.tid, ev.ts / 1e3);
+      if (ev.type == 'X')
+        fprintf(f, ", \"dur\": %.3f", ev.dur / 1e3);
+      if (ev.argName != 0) {
+        fprintf(f, ", \"args\": {\"%s\": ", ev.argName);
+        if (ev.quote)
+          WriteString(f, ev.arg);
+        else
+          fputs(ev.arg.c_str(), f);
+        fputc('}', f);
+      }
+      fputc('}', f);
+    }
+  }
+  fprintf(f, "\n]}\n");
+  return fclose(f) == 0;
+}
+
+CTraceScope::CTraceScope(const char *name)
+    : m_start(IsTracing() ? Now() : -1), m_name(name), m_argName(0),
+      m_quote(false) {}
+
+CTraceScope::CTraceScope(const char *name, const char *argName,
+                         const char *arg)
+    : m_start(IsTracing() ? Now() : -1), m_name(name), m_argName(argName),
+      m_quote(true) {
+  if (m_start >= 0 && arg != 0)
+    m_arg = arg;
+}
+
+CTraceScope::CTraceScope(const char *name, const char *argName,
+                         const std::string &arg)
+    : m_start(IsTracing() ? Now() : -1), m_name(name), m_argName(argName),
+      m_quote(true) {
+  if (m_start >= 0)
+    m_arg = arg;
+}
+
+CTraceScope::CTraceScope(const char *name, const char *argName, long long arg)
+    : m_start(IsTracing() ? Now() : -1), m_name(name), m_argName(argName),
+      m_quote(false) {
+  if (m_start >= 0)
+    m_arg = std::to_string(arg);
+}
+
+CTraceScope::~CTraceScope() {
+  if (m_start < 0 || !IsTracing())
+    return;
+  TraceEvent ev = {'X',     m_name, m_argName, std::move(m_arg),
+                   m_quote, m_start, Now() - m_start};
+  ThisThread().Append(std::move(ev));
+}
+
+void TraceCounter(const char *name, long long value) {
+  if (!IsTracing())
+    return;
+  TraceEvent ev = {'C', name, "value", std::to_string(value), false, Now(), 0};
+  ThisThread().Append(std::move(ev));
+}
+}; // namespace Sora
+
+#endif
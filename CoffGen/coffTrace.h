@@ -0,0 +1,66 @@
+#ifndef COFFTRACE_H
+#define COFFTRACE_H
+
+// timeline tracing in the Chrome trace-event format, for chrome://tracing
+// and ui.perfetto.dev: the spans of every thread on a track of its own, with
+// the dll or member they work on, and counters. compiled in with
+// IMPLIBGEN_TRACE (cmake -DIMPLIBGEN_TRACE=ON); without it the macros below
+// are empty and cost nothing. compiled in, a span costs one atomic load until
+// StartTrace, the phase scopes of coffHooks.h are spans as well.
+
+#ifdef IMPLIBGEN_TRACE
+
+#include <string>
+
+namespace Sora {
+// starts recording, the times are relative to this call
+void StartTrace();
+bool IsTracing();
+
+// stops recording and writes the events of all the threads as JSON. call it
+// once the traced work is done, the spans still open are lost
+// return: false if the file can't be written
+bool WriteTrace(const char *path);
+
+// a span from the constructor to the destructor on the calling thread.
+// name: a string literal. the argument is copied
+class CTraceScope {
+public:
+  explicit CTraceScope(const char *name);
+  CTraceScope(const char *name, const char *argName, const char *arg);
+  CTraceScope(const char *name, const char *argName, const std::string &arg);
+  CTraceScope(const char *name, const char *argName, long long arg);
+  ~CTraceScope();
+
+private:
+  long long m_start; // -1: not tracing
+  const char *m_name;
+  const char *m_argName;
+  std::string m_arg;
+  bool m_quote; // the argument is a string
+
+  CTraceScope(const CTraceScope &);
+  CTraceScope &operator=(const CTraceScope &);
+};
+
+// the value of a counter from now on, name: a string literal
+void TraceCounter(const char *name, long long value);
+}; // namespace Sora
+
+#define SORA_TRACE_CAT2(a, b) a##b
+#define SORA_TRACE_CAT(a, b) SORA_TRACE_CAT2(a, b)
+#define SORA_TRACE_SCOPE(name)                                                 \
+  Sora::CTraceScope SORA_TRACE_CAT(trace_, __LINE__)(name)
+#define SORA_TRACE_SCOPE_ARG(name, argName, arg)                               \
+  Sora::CTraceScope SORA_TRACE_CAT(trace_, __LINE__)(name, argName, arg)
+#define SORA_TRACE_COUNTER(name, value) Sora::TraceCounter(name, value)
+
+#else
+
+#define SORA_TRACE_SCOPE(name) ((void)0)
+#define SORA_TRACE_SCOPE_ARG(name, argName, arg) ((void)0)
+#define SORA_TRACE_COUNTER(name, value) ((void)0)
+
+#endif
+
+#endif
@@ -1,12 +1,134 @@
 #include "cofffactory.h"
-#include "coffinterfaces.h"
-#include <Windows.h>
+#include "coffHooks.h"
+#include "coffInterfaces.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <thread>
 using namespace Sora;
 
-#define OFFSET(stru, memb) ((DWORD) & ((stru *)0)->memb)
+#define OFFSET(stru, memb) ((DWORD)offsetof(stru, memb))
+
+static bool Check(bool ok, const char *what) {
+  if (!ok)
+    printf("FAILED: %s\n", what);
+  return ok;
+}
+
+// the test links the counting operator new of coffNew.cpp
+static bool TestAllocCounting() {
+  // volatile: a new and delete in a row may be left out by the compiler
+  void *volatile before = operator new(64);
+  bool ok = Check(EnableAllocCounting(true), "counting operator new linked");
+  ResetAllocStats();
+  long long live = GetLiveBytes();
+  operator delete(before);
+  ok &= Check(GetLiveBytes() == live, "free of a block from before counting");
+
+  ICoffFactory *fac = GetX64CoffFactory();
+  ICoffBuilder *coff;
+  {
+    CPhaseScope phase(BP_ADDIMPORT);
+    coff = fac->CreateCoffBuilder();
+    ISectionBuilder *sec = fac->CreateSectionBuilder();
+    sec->SetName(".text");
+    coff->AppendSection(sec);
+    BYTE data[8] = {0};
+    IRelocatableVar *reloc[1] = {fac->CreateRelocatableVar()};
+    reloc[0]->Set("__imp_add", sec, 0, 0, VARelocate64);
+    sec->AppendData(data, sizeof(data), reloc, 1);
+    coff->PushRelocs();
+  }
+  void *volatile outside = operator new(16);
+  operator delete(outside);
+
+  AllocStats add = GetAllocStats(BP_ADDIMPORT);
+  AllocStats push = GetAllocStats(BP_PUSHRELOCS);
+  AllocStats other = GetAllocStats(BP_COUNT);
+  ok &= Check(add.count > 0 && add.bytes > 0 && add.peakLive > live,
+              "allocations of addimport");
+  ok &= Check(push.count > 0, "allocations of the nested pushrelocs");
+  ok &= Check(other.count == 1, "allocation outside any phase");
+  ok &= Check(GetAllocTotals().count == add.count + push.count + other.count,
+              "totals");
+
+  coff->Dispose();
+  ok &= Check(GetLiveBytes() == live, "live bytes back after the frees");
+
+  // counted, freed with counting off
+  outside = operator new(16);
+  EnableAllocCounting(false);
+  operator delete(outside);
+  ok &= Check(GetLiveBytes() == live, "free of a counted block when off");
+
+  outside = operator new(16);
+  operator delete(outside);
+  ok &= Check(GetAllocStats(BP_COUNT).count == 2, "nothing counted when off");
+  return ok;
+}
+
+#ifdef IMPLIBGEN_TRACE
+static bool Contains(const std::string &text, const char *what) {
+  return Check(text.find(what) != std::string::npos, what);
+}
+
+static bool TestTrace() {
+  SORA_TRACE_SCOPE("before the start");
+  StartTrace();
+  {
+    SORA_TRACE_SCOPE_ARG("library", "dll", "quote\"d.dll");
+    CPhaseScope phase(BP_BUILD);
+    SORA_TRACE_COUNTER("queue", 3);
+  }
+  std::thread worker([] { SORA_TRACE_SCOPE_ARG("shard", "shard", 7LL); });
+  worker.join();
+  bool ok = Check(WriteTrace("trace.json"), "trace written");
+
+  std::ifstream f("trace.json");
+  std::stringstream text;
+  text << f.rdbuf();
+  std::string t = text.str();
+  ok &= Contains(t, "\"traceEvents\"");
+  ok &= Contains(t, "\"name\": \"library\", \"ph\": \"X\"");
+  ok &= Contains(t, "\"args\": {\"dll\": \"quote\\\"d.dll\"}");
+  ok &= Contains(t, "\"name\": \"build\", \"ph\": \"X\"");
+  ok &= Contains(t, "\"ph\": \"C\"");
+  ok &= Contains(t, "\"args\": {\"value\": 3}");
+  ok &= Contains(t, "\"args\": {\"shard\": 7}");
+  ok &= Contains(t, "\"args\": {\"name\": \"main\"}");
+  ok &= Contains(t, "\"args\": {\"name\": \"thread 1\"}");
+  ok &= Check(t.find("before the start") == std::string::npos,
+              "span open before the start left out");
+  ok &= Check(!IsTracing(), "tracing stopped by WriteTrace");
+
+  // a worker still appending while the trace is started and written
+  std::atomic<bool> stop(false);
+  std::thread busy([&stop] {
+    while (!stop)
+      SORA_TRACE_SCOPE("busy");
+  });
+  for (int i = 0; i < 10; ++i) {
+    StartTrace();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ok &= Check(WriteTrace("trace.json"), "trace written while appended to");
+  }
+  stop = true;
+  busy.join();
+  return ok;
+}
+#endif
 
 int main() {
+  if (!TestAllocCounting())
+    return 1;
+#ifdef IMPLIBGEN_TRACE
+  if (!TestTrace())
+    return 1;
+#endif
+
   ICoffFactory *fac = GetX86CoffFactory();
   ICoffBuilder *coff = fac->CreateCoffBuilder();
   ISectionBuilder *id2 = fac->CreateSectionBuilder();
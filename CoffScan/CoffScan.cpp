@@ -0,0 +1,244 @@
+#include "CoffScan.h"
+
+#include "MappedFile.h"
+#include "WorkPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace Sora {
+namespace {
+inline WORD Read16(const BYTE *p) {
+  WORD r;
+  memcpy(&r, p, sizeof(r));
+  return r;
+}
+
+inline DWORD Read32(const BYTE *p) {
+  DWORD r;
+  memcpy(&r, p, sizeof(r));
+  return r;
+}
+
+const char ArchiveMagic[] = "!<arch>\n";
+const size_t ArchiveHeaderSize = 60;
+
+// ANON_OBJECT_HEADER_BIGOBJ::ClassID
+const BYTE BigObjClassId[16] = {0xC7, 0xA1, 0xBA, 0xD1, 0xEE, 0xBA,
+                                0xA9, 0x4B, 0xAF, 0x20, 0xFA, 0xF6,
+                                0x6A, 0xA4, 0xDC, 0xB8};
+
+const BYTE SymClassExternal = 2; // IMAGE_SYM_CLASS_EXTERNAL
+
+bool KnownMachine(WORD machine) {
+  switch (machine) {
+  case 0x14C:  // i386
+  case 0x8664: // amd64
+  case 0x1C4:  // armnt
+  case 0xAA64: // arm64
+  case 0xA641: // arm64ec
+  case 0xA64E: // arm64x
+    return true;
+  }
+  return false;
+}
+
+class CCoffScanner {
+public:
+  CCoffScanner(const char *fileName, std::vector<std::string_view> &names)
+      : m_fileName(fileName), m_names(names), m_objects(0) {}
+
+  // return: false if data is neither an archive nor an object
+  bool ScanFile(const BYTE *data, size_t len) {
+    if (len >= 8 && memcmp(data, ArchiveMagic, 8) == 0) {
+      ScanArchive(data, len);
+      return true;
+    }
+    return ScanObject(data, len);
+  }
+
+  size_t GetObjectCount() const { return m_objects; }
+
+private:
+  const char *m_fileName;
+  std::vector<std::string_view> &m_names;
+  size_t m_objects;
+
+  [[noreturn]] void Fail(const char *msg) const {
+    throw std::runtime_error(std::string(m_fileName) + ": " + msg);
+  }
+
+  void ScanArchive(const BYTE *data, size_t len) {
+    size_t pos = 8;
+    while (pos + ArchiveHeaderSize <= len) {
+      const BYTE *h = data + pos;
+      if (h[58] != '`' || h[59] != '\n')
+        Fail("Bad archive member header");
+
+      char size[11];
+      memcpy(size, h + 48, 10);
+      size[10] = 0;
+      size_t n = strtoul(size, 0, 10);
+      pos += ArchiveHeaderSize;
+      if (n > len - pos)
+        Fail("Truncated archive member");
+
+      // the linker members and the long names: "/", "//", "/<ECSYMBOLS>/"
+      bool special = h[0] == '/' && (h[1] == ' ' || h[1] == '/' || h[1] == '<');
+      if (!special)
+        ScanObject(data + pos, n);
+      pos += n + (n & 1);
+    }
+  }
+
+  // return: false if data is no object, import objects are objects
+  bool ScanObject(const BYTE *data, size_t len) {
+    if (len < 20)
+      return false;
+
+    WORD sig1 = Read16(data), sig2 = Read16(data + 2);
+    if (sig1 == 0 && sig2 == 0xFFFF) {
+      // import object (version 0), /bigobj, or something else anonymous
+      WORD version = Read16(data + 4);
+      if (version >= 2 && len >= 56 && memcmp(data + 12, BigObjClassId, 16) == 0)
+        ScanSymbols(data, len, Read32(data + 48), Read32(data + 52), 20);
+      return true;
+    }
+
+    if (!KnownMachine(sig1))
+      return false;
+    ScanSymbols(data, len, Read32(data + 8), Read32(data + 12), 18);
+    return true;
+  }
+
+  // symSize: 18, or 20 for /bigobj with a 32-bit section number
+  void ScanSymbols(const BYTE *data, size_t len, DWORD symbols, DWORD count,
+                   size_t symSize) {
+    ++m_objects;
+    if (count == 0)
+      return;
+    if (symbols > len || (len - symbols) / symSize < count)
+      Fail("Truncated symbol table");
+
+    // the string table follows the symbols, its size includes itself
+    const BYTE *strings = data + symbols + count * symSize;
+    size_t stringsLen = 0;
+    if ((size_t)(data + len - strings) >= 4)
+      stringsLen = std::min<size_t>(Read32(strings), data + len - strings);
+
+    for (DWORD i = 0; i < count; ++i) {
+      const BYTE *s = data + symbols + (size_t)i * symSize;
+      DWORD value = Read32(s + 8);
+      long section = symSize == 20 ? (long)(int)Read32(s + 12)
+                                   : (long)(short)Read16(s + 12);
+      BYTE storage = s[symSize - 2];
+      BYTE aux = s[symSize - 1];
+      i += aux;
+
+      // undefined, not a common symbol (value: its size)
+      if (section != 0 || storage != SymClassExternal || value != 0)
+        continue;
+
+      if (Read32(s) != 0) {
+        const char *p = (const char *)s;
+        m_names.push_back(std::string_view(p, strnlen(p, 8)));
+        continue;
+      }
+
+      DWORD offset = Read32(s + 4);
+      if (offset < 4 || offset >= stringsLen)
+        Fail("Bad symbol name offset");
+      const char *p = (const char *)strings + offset;
+      m_names.push_back(std::string_view(p, strnlen(p, stringsLen - offset)));
+    }
+  }
+};
+} // namespace
+
+size_t ScanCoffReferences(const BYTE *data, size_t len, const char *fileName,
+                          std::vector<std::string_view> &names) {
+  CCoffScanner scanner(fileName, names);
+  if (!scanner.ScanFile(data, len))
+    throw std::runtime_error(std::string(fileName) +
+                             ": Not a COFF object or archive");
+  return scanner.GetObjectCount();
+}
+
+CSymbolReferences::CSymbolReferences() : m_objects(0) {}
+
+void CSymbolReferences::Add(const std::vector<std::string_view> &names) {
+  std::vector<std::string_view>::const_iterator i, iend;
+  for (i = names.begin(), iend = names.end(); i != iend; ++i) {
+    if (m_set.find(*i) != m_set.end())
+      continue;
+    m_names.emplace_back(*i);
+    m_set.insert(m_names.back());
+  }
+}
+
+void CSymbolReferences::Scan(const BYTE *data, size_t len,
+                             const char *fileName) {
+  std::vector<std::string_view> names;
+  m_objects += ScanCoffReferences(data, len, fileName, names);
+  Add(names);
+}
+
+void CSymbolReferences::ScanFiles(const std::vector<std::string> &paths,
+                                  CWorkPool *pool) {
+  // the files stay mapped until their names are merged
+  struct File {
+    CMappedFile map;
+    std::vector<std::string_view> names;
+    size_t objects = 0;
+  };
+  std::vector<std::unique_ptr<File>> files(paths.size());
+
+  auto scan = [&paths, &files](size_t i) {
+    files[i].reset(new File);
+    File &f = *files[i];
+    if (!f.map.Open(paths[i].c_str()))
+      throw std::runtime_error("Fail to open input file " + paths[i]);
+    f.objects = ScanCoffReferences(f.map.GetData(), f.map.GetSize(),
+                                   paths[i].c_str(), f.names);
+  };
+
+  if (pool != 0) {
+    CTaskGroup group(*pool);
+    for (size_t i = 0; i < paths.size(); ++i)
+      group.Run([&scan, i]() { scan(i); });
+    group.Wait();
+  } else {
+    for (size_t i = 0; i < paths.size(); ++i)
+      scan(i);
+  }
+
+  for (size_t i = 0; i < files.size(); ++i) {
+    Add(files[i]->names);
+    m_objects += files[i]->objects;
+  }
+}
+
+bool CSymbolReferences::Contains(std::string_view name) const {
+  return m_set.find(name) != m_set.end();
+}
+
+void PruneUnreferenced(CManifest &m, const CSymbolReferences &refs) {
+  std::vector<ExportSymbol>::iterator i, out = m.symbols.begin();
+  for (i = m.symbols.begin(); i != m.symbols.end(); ++i) {
+    bool called = !i->thunk.empty() && refs.Contains(i->thunk);
+    if (!called && !refs.Contains(i->pubname))
+      continue;
+
+    if (!called && !i->thunk.empty()) {
+      i->flags |= ESF_NOSTUB;
+      i->thunk = std::string_view();
+    }
+    if (out != i)
+      *out = *i;
+    ++out;
+  }
+  m.symbols.erase(out, m.symbols.end());
+}
+}; // namespace Sora
@@ -0,0 +1,59 @@
+#ifndef COFFSCAN_H
+#define COFFSCAN_H
+
+#include "Manifest.h"
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace Sora {
+class CWorkPool;
+
+// the undefined external symbols of COFF objects (regular and /bigobj) and
+// archives of them: the symbols a binary linked from them looks for in the
+// import libraries. import objects and members in other formats (LTCG
+// bitcode...) are skipped.
+class CSymbolReferences {
+public:
+  CSymbolReferences();
+  CSymbolReferences(const CSymbolReferences &) = delete;
+  CSymbolReferences &operator=(const CSymbolReferences &) = delete;
+
+  // an object or an archive in memory, the names are copied.
+  // fileName: for error messages
+  void Scan(const BYTE *data, size_t len, const char *fileName);
+
+  // the files are mapped and scanned on the pool, 0: on this thread.
+  // throws std::runtime_error for a file that can't be read or is neither an
+  // object nor an archive
+  void ScanFiles(const std::vector<std::string> &paths, CWorkPool *pool);
+
+  bool Contains(std::string_view name) const;
+  size_t Size() const { return m_set.size(); }
+
+  size_t GetObjectCount() const { return m_objects; }
+
+private:
+  std::deque<std::string> m_names; // the strings of m_set
+  std::unordered_set<std::string_view> m_set;
+  size_t m_objects;
+
+  void Add(const std::vector<std::string_view> &names);
+};
+
+// the undefined names of an object or archive in memory, pointing into data
+// return: the objects read
+size_t ScanCoffReferences(const BYTE *data, size_t len, const char *fileName,
+                          std::vector<std::string_view> &names);
+
+// keep the symbols of m that are referenced: by their thunk, the stub is
+// called, or their pubname, the import pointer is used. the symbols only
+// referenced by pubname lose their stub (ESF_NOSTUB).
+void PruneUnreferenced(CManifest &m, const CSymbolReferences &refs);
+}; // namespace Sora
+
+#endif
@@ -0,0 +1,695 @@
+// cost of the archive work of a link against an import library, to measure
+// choices of its format on Linux, without a Windows linker
+//
+// usage: bench_link [--json <file>] [--refs <fraction>] [--objects <n>]
+//                   [--seed <n>] [--repeat <n>] [--arch 32|64]
+//                   [export count | library ...]
+//
+// a count is a synthetic export set (SyntheticManifest.h) built into a
+// library in memory, anything else a library file. the referencing objects
+// are made with CoffGen: a seeded share (--refs, 0.1 by default) of the
+// __imp_ symbols of the library's index, half of them called by their thunk
+// if it has one, spread over --objects objects (16). then a link is run like
+// link.exe does it, a round of every stage for the names undefined so far:
+// index: the second linker member and the long names read, n: symbols
+// objects: the undefined symbols of the objects, n: references
+// lookup: the binary search of the index for every undefined name not yet
+//         defined, n: lookups, bytes: the string bytes compared
+// extract: the headers of the members found, their names, n: members
+// parse: headers, sections, relocations, symbols and strings of the members,
+//        short import objects too; their defined externals resolve names,
+//        the undefined ones (import descriptor, null thunk) make the next
+//        round. n: members
+// group: the .idata$ sections sorted by the suffix of their name, stable,
+//        and laid out aligned, n: sections, bytes: written
+//
+// the best time of --repeat (5) links for every stage. counts are 1k, 10k
+// and 50k by default, the most the WORD indexes of the second linker member
+// reach is 65535 members. with --json every result is also written to the
+// file as a JSON line:
+// {"bench": "link", "library": "synthetic 1000", "case": "lookup", "n": 200,
+//  "ms": 0.1, "ns_per_item": 100.0, "bytes": 4000, "bytes_per_item": 20.0}
+
+#include "CoffScan.h"
+#include "MappedFile.h"
+#include "SyntheticManifest.h"
+
+#include "LibGenHelperInterfaces.h"
+#include "cofffactory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_set>
+#include <vector>
+
+using namespace Sora;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+static WORD Read16(const BYTE *p) {
+  WORD r;
+  memcpy(&r, p, sizeof(r));
+  return r;
+}
+
+static DWORD Read32(const BYTE *p) {
+  DWORD r;
+  memcpy(&r, p, sizeof(r));
+  return r;
+}
+
+static const size_t ArchiveHeaderSize = 60;
+static const BYTE SymClassExternal = 2; // IMAGE_SYM_CLASS_EXTERNAL
+
+enum Stage { ST_INDEX, ST_OBJECTS, ST_LOOKUP, ST_EXTRACT, ST_PARSE, ST_GROUP,
+             ST_COUNT };
+
+static const char *stageNames[ST_COUNT] = {"index",   "objects", "lookup",
+                                           "extract", "parse",   "group"};
+
+struct StageStats {
+  double ms = 0;
+  size_t n = 0;
+  size_t bytes = 0;
+};
+
+struct LinkStats {
+  StageStats stages[ST_COUNT];
+  size_t members = 0; // pulled
+  size_t unresolved = 0;
+  size_t idataSize = 0;
+  DWORD check = 0; // the relocations read add up here, kept by the optimizer
+};
+
+// the archive and its index, the second linker member
+struct Archive {
+  const BYTE *data = 0;
+  size_t size = 0;
+  DWORD memberCount = 0;
+  const BYTE *offsets = 0; // of the members
+  DWORD symbolCount = 0;
+  const BYTE *indices = 0; // 1-based WORD index of the member of a symbol
+  std::vector<const char *> names; // sorted
+  const char *longNames = 0;
+  size_t longNamesSize = 0;
+  WORD machine = 0; // of the first member
+};
+
+// the size of the member whose header is at pos
+static size_t MemberSize(const Archive &a, size_t pos) {
+  if (pos > a.size || a.size - pos < ArchiveHeaderSize)
+    throw std::runtime_error("Truncated archive member header");
+  const BYTE *h = a.data + pos;
+  if (h[58] != '`' || h[59] != '\n')
+    throw std::runtime_error("Bad archive member header");
+  char size[11];
+  memcpy(size, h + 48, 10);
+  size[10] = 0;
+  size_t n = strtoul(size, 0, 10);
+  if (n > a.size - pos - ArchiveHeaderSize)
+    throw std::runtime_error("Truncated archive member");
+  return n;
+}
+
+static void LoadIndex(Archive &a, StageStats &st) {
+  if (a.size < 8 || memcmp(a.data, "!<arch>\n", 8) != 0)
+    throw std::runtime_error("Not an archive");
+
+  // first linker member, second linker member, long names, then the objects
+  size_t pos = 8;
+  for (int i = 0; pos < a.size; ++i) {
+    size_t n = MemberSize(a, pos);
+    const BYTE *h = a.data + pos, *p = h + ArchiveHeaderSize;
+    st.bytes += ArchiveHeaderSize;
+    if (i == 1 && h[0] == '/' && h[1] == ' ') {
+      if (n < 8)
+        throw std::runtime_error("Truncated second linker member");
+      a.memberCount = Read32(p);
+      if (a.memberCount > 0xFFFF)
+        throw std::runtime_error(
+            "More members than the second linker member indexes");
+      if ((n - 8) / 4 < a.memberCount)
+        throw std::runtime_error("Truncated second linker member");
+      a.offsets = p + 4;
+      a.symbolCount = Read32(a.offsets + 4 * a.memberCount);
+      a.indices = a.offsets + 4 * a.memberCount + 4;
+      const char *s = (const char *)a.indices + 2 * (size_t)a.symbolCount;
+      const char *end = (const char *)p + n;
+      if (s > end)
+        throw std::runtime_error("Truncated second linker member");
+      a.names.reserve(a.symbolCount);
+      for (DWORD k = 0; k < a.symbolCount; ++k) {
+        const char *z = (const char *)memchr(s, 0, end - s);
+        if (z == 0)
+          throw std::runtime_error("Truncated second linker member");
+        a.names.push_back(s);
+        s = z + 1;
+      }
+      st.bytes += n;
+    } else if (h[0] == '/' && h[1] == '/') {
+      a.longNames = (const char *)p;
+      a.longNamesSize = n;
+      st.bytes += n;
+    } else if (h[0] != '/' || h[1] != ' ') {
+      if (n >= 8)
+        a.machine = Read16(p) == 0 && Read16(p + 2) == 0xFFFF ? Read16(p + 6)
+                                                              : Read16(p);
+      break;
+    }
+    pos += ArchiveHeaderSize + n + (n & 1);
+  }
+  if (a.offsets == 0)
+    throw std::runtime_error("No second linker member");
+  st.n = a.symbolCount;
+}
+
+// strcmp of a NUL-terminated name of the index and a name, the bytes read
+// added to bytes
+static int Compare(const char *a, std::string_view b, size_t &bytes) {
+  size_t i = 0;
+  while (i < b.size() && a[i] == b[i] && a[i] != 0)
+    ++i;
+  bytes += i + 1;
+  if (i == b.size())
+    return a[i] == 0 ? 0 : 1;
+  return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+}
+
+// return: the 0-based member defining name, -1 if none
+static int Lookup(const Archive &a, std::string_view name, size_t &bytes) {
+  size_t lo = 0, hi = a.names.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int c = Compare(a.names[mid], name, bytes);
+    if (c == 0) {
+      bytes += 2;
+      return (int)Read16(a.indices + 2 * mid) - 1;
+    }
+    if (c < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return -1;
+}
+
+struct Member {
+  const BYTE *data;
+  size_t size;
+  std::string_view name;
+};
+
+struct Section {
+  std::string_view suffix; // after '$'
+  const BYTE *data;        // 0: zeros
+  size_t size;
+  size_t align;
+};
+
+// the state of one link
+class CLink {
+public:
+  CLink(const Archive &a, LinkStats &stats) : m_archive(a), m_stats(stats) {}
+
+  void Run(const std::vector<std::vector<BYTE>> &objects) {
+    std::vector<std::string_view> pending, next;
+    std::vector<bool> pulled(m_archive.memberCount);
+    std::vector<int> found;
+    std::vector<Member> members;
+
+    Clock::time_point start = Clock::now();
+    StageStats &obj = m_stats.stages[ST_OBJECTS];
+    std::vector<std::string_view> names;
+    for (size_t i = 0; i < objects.size(); ++i) {
+      ScanCoffReferences(objects[i].data(), objects[i].size(), "bench.obj",
+                         names);
+      obj.bytes += objects[i].size();
+    }
+    for (size_t i = 0; i < names.size(); ++i)
+      if (m_seen.insert(names[i]).second)
+        pending.push_back(names[i]);
+    obj.n = names.size();
+    obj.ms += MsSince(start);
+
+    while (!pending.empty()) {
+      StageStats &lookup = m_stats.stages[ST_LOOKUP];
+      start = Clock::now();
+      found.clear();
+      for (size_t i = 0; i < pending.size(); ++i) {
+        if (m_defined.find(pending[i]) != m_defined.end())
+          continue;
+        ++lookup.n;
+        int member = Lookup(m_archive, pending[i], lookup.bytes);
+        if (member < 0 || (DWORD)member >= m_archive.memberCount)
+          ++m_stats.unresolved;
+        else if (!pulled[member]) {
+          pulled[member] = true;
+          found.push_back(member);
+        }
+      }
+      lookup.ms += MsSince(start);
+
+      start = Clock::now();
+      members.clear();
+      for (size_t i = 0; i < found.size(); ++i)
+        members.push_back(Extract(found[i]));
+      m_stats.stages[ST_EXTRACT].ms += MsSince(start);
+
+      start = Clock::now();
+      next.clear();
+      for (size_t i = 0; i < members.size(); ++i)
+        Parse(members[i], next);
+      m_stats.stages[ST_PARSE].ms += MsSince(start);
+      m_stats.members += members.size();
+
+      pending.swap(next);
+    }
+
+    start = Clock::now();
+    Group();
+    m_stats.stages[ST_GROUP].ms += MsSince(start);
+  }
+
+private:
+  const Archive &m_archive;
+  LinkStats &m_stats;
+  std::unordered_set<std::string_view> m_defined, m_seen;
+  std::vector<Section> m_sections;
+  std::deque<std::string> m_strings; // names made for short import objects
+  std::vector<BYTE> m_idata;
+
+  Member Extract(int index) {
+    StageStats &st = m_stats.stages[ST_EXTRACT];
+    size_t pos = Read32(m_archive.offsets + 4 * (size_t)index);
+    Member m;
+    m.size = MemberSize(m_archive, pos);
+    const char *h = (const char *)m_archive.data + pos;
+    m.data = (const BYTE *)h + ArchiveHeaderSize;
+    st.bytes += ArchiveHeaderSize + 4;
+
+    // "name/" or "/offset" into the long names
+    if (h[0] == '/' && h[1] >= '0' && h[1] <= '9') {
+      size_t offset = strtoul(h + 1, 0, 10);
+      if (offset >= m_archive.longNamesSize)
+        throw std::runtime_error("Bad long member name offset");
+      const char *s = m_archive.longNames + offset;
+      const char *z = (const char *)memchr(s, '/', m_archive.longNamesSize -
+                                                       offset);
+      m.name = std::string_view(s, z ? z - s : m_archive.longNamesSize - offset);
+    } else {
+      const char *z = (const char *)memchr(h, '/', 16);
+      m.name = std::string_view(h, z ? z - h : 16);
+    }
+    st.bytes += m.name.size();
+    ++st.n;
+    return m;
+  }
+
+  void Define(std::string_view name) { m_defined.insert(name); }
+
+  void Reference(std::string_view name, std::vector<std::string_view> &next) {
+    if (m_defined.find(name) == m_defined.end() && m_seen.insert(name).second)
+      next.push_back(name);
+  }
+
+  void Parse(const Member &m, std::vector<std::string_view> &next) {
+    StageStats &st = m_stats.stages[ST_PARSE];
+    ++st.n;
+    if (m.size < 20)
+      throw std::runtime_error(std::string(m.name) + ": Truncated member");
+    if (Read16(m.data) == 0 && Read16(m.data + 2) == 0xFFFF) {
+      if (Read16(m.data + 4) == 0)
+        ParseShortImport(m, next);
+      // else /bigobj or an anonymous object, not in import libraries
+      st.bytes += 20;
+      return;
+    }
+
+    const BYTE *p = m.data;
+    WORD sectionCount = Read16(p + 2);
+    DWORD symbols = Read32(p + 8), symbolCount = Read32(p + 12);
+    size_t headers = 20 + Read16(p + 16);
+    if (symbols > m.size || (m.size - symbols) / 18 < symbolCount ||
+        headers > m.size || (m.size - headers) / 40 < sectionCount)
+      throw std::runtime_error(std::string(m.name) + ": Truncated object");
+    st.bytes += headers + 40 * (size_t)sectionCount + 18 * (size_t)symbolCount;
+
+    const BYTE *strings = p + symbols + 18 * (size_t)symbolCount;
+    size_t stringsSize = 0;
+    if ((size_t)(p + m.size - strings) >= 4)
+      stringsSize = std::min<size_t>(Read32(strings), p + m.size - strings);
+
+    for (WORD i = 0; i < sectionCount; ++i) {
+      const BYTE *s = p + headers + 40 * (size_t)i;
+      std::string_view name = Name(s, strings, stringsSize, st.bytes);
+      DWORD size = Read32(s + 16), raw = Read32(s + 20);
+      DWORD relocs = Read32(s + 24);
+      WORD relocCount = Read16(s + 32);
+      DWORD chara = Read32(s + 36);
+
+      if (relocs > m.size || (m.size - relocs) / 10 < relocCount)
+        throw std::runtime_error(std::string(m.name) + ": Bad relocations");
+      for (WORD r = 0; r < relocCount; ++r) {
+        DWORD symbol = Read32(p + relocs + 10 * (size_t)r + 4);
+        if (symbol >= symbolCount)
+          throw std::runtime_error(std::string(m.name) + ": Bad relocation");
+        m_stats.check += symbol;
+      }
+      st.bytes += 10 * (size_t)relocCount;
+
+      if (name.size() < 7 || name.compare(0, 7, ".idata$") != 0)
+        continue;
+      Section sec;
+      sec.suffix = name.substr(7);
+      sec.size = size;
+      // IMAGE_SCN_CNT_UNINITIALIZED_DATA: zeros
+      if ((chara & 0x80) != 0 || raw == 0) {
+        sec.data = 0;
+      } else {
+        if (raw > m.size || m.size - raw < size)
+          throw std::runtime_error(std::string(m.name) + ": Bad section data");
+        sec.data = p + raw;
+      }
+      DWORD align = (chara >> 20) & 0xF;
+      sec.align = align == 0 ? 16 : (size_t)1 << (align - 1);
+      m_sections.push_back(sec);
+    }
+
+    for (DWORD i = 0; i < symbolCount; ++i) {
+      const BYTE *s = p + symbols + 18 * (size_t)i;
+      short section = (short)Read16(s + 12);
+      BYTE storage = s[16];
+      i += s[17];
+      if (storage != SymClassExternal)
+        continue;
+      std::string_view name = Name(s, strings, stringsSize, st.bytes);
+      if (section != 0)
+        Define(name);
+      else if (Read32(s + 8) == 0) // not a common symbol
+        Reference(name, next);
+    }
+  }
+
+  // of a section header or a symbol, "/offset" or an offset into strings
+  static std::string_view Name(const BYTE *s, const BYTE *strings,
+                               size_t stringsSize, size_t &bytes) {
+    size_t offset;
+    if (Read32(s) != 0) {
+      if (s[0] != '/' || s[1] < '0' || s[1] > '9')
+        return std::string_view((const char *)s, strnlen((const char *)s, 8));
+      char digits[8] = {};
+      memcpy(digits, s + 1, 7);
+      offset = strtoul(digits, 0, 10);
+    } else {
+      offset = Read32(s + 4);
+    }
+    if (offset < 4 || offset >= stringsSize)
+      throw std::runtime_error("Bad name offset");
+    const char *p = (const char *)strings + offset;
+    std::string_view name(p, strnlen(p, stringsSize - offset));
+    bytes += name.size() + 1;
+    return name;
+  }
+
+  // IMPORT_OBJECT_HEADER and "symbol\0dll\0": the linker makes the thunk,
+  // the import pointer and the hint/name, and pulls the import descriptor of
+  // the dll
+  void ParseShortImport(const Member &m, std::vector<std::string_view> &next) {
+    StageStats &st = m_stats.stages[ST_PARSE];
+    WORD machine = Read16(m.data + 6);
+    DWORD dataSize = Read32(m.data + 12);
+    WORD type = Read16(m.data + 18);
+    if (dataSize > m.size - 20)
+      throw std::runtime_error(std::string(m.name) + ": Truncated import");
+    const char *symbol = (const char *)m.data + 20;
+    size_t symbolLen = strnlen(symbol, dataSize);
+    const char *dll = symbol + symbolLen + 1;
+    size_t dllLen = strnlen(dll, dataSize - std::min<size_t>(
+                                              dataSize, symbolLen + 1));
+    st.bytes += symbolLen + dllLen + 2;
+
+    std::string_view name(symbol, symbolLen);
+    m_strings.push_back("__imp_" + std::string(name));
+    Define(m_strings.back());
+    if ((type & 3) == 0) // IMPORT_OBJECT_CODE
+      Define(name);
+
+    std::string_view stem(dll, dllLen);
+    stem = stem.substr(0, stem.rfind('.'));
+    m_strings.push_back("__IMPORT_DESCRIPTOR_" + std::string(stem));
+    Reference(m_strings.back(), next);
+
+    size_t ptr = machine == 0x14C || machine == 0x1C4 ? 4 : 8;
+    Section sec = {"5", 0, ptr, ptr};
+    m_sections.push_back(sec);
+    sec.suffix = "4";
+    m_sections.push_back(sec);
+    if (((type >> 2) & 7) != 0) { // not IMPORT_OBJECT_ORDINAL: a hint/name
+      sec.suffix = "6";
+      sec.size = (2 + symbolLen + 1 + 1) & ~(size_t)1;
+      sec.align = 2;
+      m_sections.push_back(sec);
+    }
+  }
+
+  // the sections of .idata sorted by their suffix, in the order they came
+  // within one, and laid out like the linker merges them into .idata
+  void Group() {
+    StageStats &st = m_stats.stages[ST_GROUP];
+    std::stable_sort(m_sections.begin(), m_sections.end(),
+                     [](const Section &a, const Section &b) {
+                       return a.suffix < b.suffix;
+                     });
+    size_t size = 0;
+    for (size_t i = 0; i < m_sections.size(); ++i)
+      size = (size + m_sections[i].align - 1) / m_sections[i].align *
+                 m_sections[i].align +
+             m_sections[i].size;
+
+    m_idata.assign(size, 0);
+    size_t pos = 0;
+    for (size_t i = 0; i < m_sections.size(); ++i) {
+      const Section &s = m_sections[i];
+      pos = (pos + s.align - 1) / s.align * s.align;
+      if (s.data != 0)
+        memcpy(&m_idata[pos], s.data, s.size);
+      pos += s.size;
+      st.bytes += s.size;
+    }
+    st.n = m_sections.size();
+    m_stats.idataSize = size;
+  }
+};
+
+// the referencing objects: a .text of one 32-bit address for every reference
+static std::vector<std::vector<BYTE>> MakeObjects(const Archive &a,
+                                                  double refs, int count,
+                                                  unsigned long long seed) {
+  std::mt19937_64 random(seed);
+  std::vector<std::vector<std::string>> names(count);
+  size_t next = 0, bytes = 0;
+  for (size_t i = 0; i < a.names.size(); ++i) {
+    const char *imp = a.names[i];
+    if (strncmp(imp, "__imp_", 6) != 0)
+      continue;
+    // the top 53 bits, the same on every platform unlike <random>'s
+    // distributions
+    if ((random() >> 11) * (1.0 / 9007199254740992.0) >= refs)
+      continue;
+    bool called = random() & 1;
+    if (called && Lookup(a, imp + 6, bytes) >= 0)
+      names[next].push_back(imp + 6);
+    else
+      names[next].push_back(imp);
+    next = (next + 1) % count;
+  }
+
+  ICoffFactory *fac =
+      a.machine == 0x14C ? GetX86CoffFactory() : GetX64CoffFactory();
+  std::vector<std::vector<BYTE>> objects(count);
+  for (int i = 0; i < count; ++i) {
+    ICoffBuilder *cb = fac->CreateCoffBuilder();
+    ISectionBuilder *text = fac->CreateSectionBuilder();
+    text->SetName(".text");
+    text->SetCharacteristics(SECH_READ | SECH_EXEC | SECH_CODE | SECH_ALIGN16);
+    cb->AppendSection(text);
+    // undefined before PushRelocs adds them with the size as their value,
+    // common symbols
+    for (size_t k = 0; k < names[i].size(); ++k)
+      cb->GetSymbolTableBuilder()->AddSymbol(0, 0, names[i][k].c_str(),
+                                             SYST_EXTERN, 0);
+    for (size_t k = 0; k < names[i].size(); ++k) {
+      DWORD zero = 0;
+      IRelocatableVar *var = fac->CreateRelocatableVar();
+      var->Set(names[i][k].c_str(), text, 0, sizeof(zero), VARelocate32);
+      text->AppendData((PBYTE)&zero, sizeof(zero), &var, 1);
+    }
+    cb->PushRelocs();
+    objects[i].resize(cb->GetDataLength());
+    cb->GetRawData(objects[i].data());
+    cb->Dispose();
+  }
+  return objects;
+}
+
+static FILE *json = 0;
+
+static void Report(const std::string &library, const char *name,
+                   const StageStats &st) {
+  size_t n = std::max<size_t>(st.n, 1);
+  printf("%-10s %9zu %10.3f %12.1f %12zu %12.1f\n", name, st.n, st.ms,
+         st.ms * 1e6 / n, st.bytes, (double)st.bytes / n);
+  if (json) {
+    std::string lib;
+    AppendJsonString(lib, library);
+    fprintf(json,
+            "{\"bench\": \"link\", \"library\": %s, \"case\": \"%s\", "
+            "\"n\": %zu, \"ms\": %.3f, \"ns_per_item\": %.1f, "
+            "\"bytes\": %zu, \"bytes_per_item\": %.1f}\n",
+            lib.c_str(), name, st.n, st.ms, st.ms * 1e6 / n, st.bytes,
+            (double)st.bytes / n);
+  }
+}
+
+struct Options {
+  double refs = 0.1;
+  int objects = 16;
+  unsigned long long seed = 1;
+  int repeat = 5;
+  int arch = 64;
+};
+
+static void Bench(const std::string &library, const BYTE *data, size_t size,
+                  const Options &o) {
+  Archive a;
+  a.data = data;
+  a.size = size;
+  std::vector<std::vector<BYTE>> objects;
+  LinkStats best;
+
+  for (int r = 0; r < o.repeat; ++r) {
+    LinkStats stats;
+    Archive index = a;
+    Clock::time_point start = Clock::now();
+    LoadIndex(index, stats.stages[ST_INDEX]);
+    stats.stages[ST_INDEX].ms = MsSince(start);
+    if (r == 0)
+      objects = MakeObjects(index, o.refs, o.objects, o.seed);
+
+    CLink link(index, stats);
+    link.Run(objects);
+    if (r == 0) {
+      best = stats;
+      a.memberCount = index.memberCount;
+      a.symbolCount = index.symbolCount;
+    }
+    for (int s = 0; s < ST_COUNT; ++s)
+      best.stages[s].ms = std::min(best.stages[s].ms, stats.stages[s].ms);
+  }
+
+  printf("%s: %zu bytes, %u members, %u symbols, %zu references in %d "
+         "objects\n",
+         library.c_str(), size, a.memberCount, a.symbolCount,
+         best.stages[ST_OBJECTS].n, o.objects);
+  StageStats total;
+  for (int s = 0; s < ST_COUNT; ++s) {
+    Report(library, stageNames[s], best.stages[s]);
+    total.ms += best.stages[s].ms;
+    total.bytes += best.stages[s].bytes;
+  }
+  total.n = best.members;
+  Report(library, "total", total);
+  printf("  %zu members pulled, %zu bytes of .idata in %zu sections, "
+         "%zu unresolved\n",
+         best.members, best.idataSize, best.stages[ST_GROUP].n,
+         best.unresolved);
+}
+
+static void BenchSynthetic(size_t count, const Options &o) {
+  SyntheticSpec spec;
+  spec.count = count;
+  spec.arch = o.arch;
+  spec.seed = o.seed;
+  CManifest m;
+  GenerateSyntheticManifest(spec, m);
+
+  IImportLibraryBuilder *b = CreateImpLibBuilder(m);
+  AddImports(m, b);
+  b->Build();
+  std::vector<BYTE> lib(b->GetDataLength());
+  b->GetRawData(lib.data());
+  b->Dispose();
+
+  Bench("synthetic " + std::to_string(count), lib.data(), lib.size(), o);
+}
+
+static void BenchFile(const char *path, const Options &o) {
+  CMappedFile f;
+  if (!f.Open(path))
+    throw std::runtime_error(std::string("Fail to open input file ") + path);
+  try {
+    Bench(path, f.GetData(), f.GetSize(), o);
+  } catch (std::runtime_error &e) {
+    throw std::runtime_error(std::string(path) + ": " + e.what());
+  }
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    Options o;
+    std::vector<const char *> inputs;
+    for (int i = 1; i < argc; ++i) {
+      bool hasValue = i + 1 < argc;
+      if (strcmp(argv[i], "--json") == 0 && hasValue) {
+        json = fopen(argv[++i], "w");
+        if (json == 0)
+          throw std::runtime_error(std::string("Fail to create ") + argv[i]);
+      } else if (strcmp(argv[i], "--refs") == 0 && hasValue) {
+        o.refs = atof(argv[++i]);
+      } else if (strcmp(argv[i], "--objects") == 0 && hasValue) {
+        o.objects = std::max(1, atoi(argv[++i]));
+      } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+        o.seed = strtoull(argv[++i], 0, 0);
+      } else if (strcmp(argv[i], "--repeat") == 0 && hasValue) {
+        o.repeat = std::max(1, atoi(argv[++i]));
+      } else if (strcmp(argv[i], "--arch") == 0 && hasValue) {
+        o.arch = atoi(argv[++i]);
+      } else {
+        inputs.push_back(argv[i]);
+      }
+    }
+    if (inputs.empty())
+      inputs = {"1000", "10000", "50000"};
+
+    printf("%-10s %9s %10s %12s %12s %12s\n", "case", "n", "ms", "ns/item",
+           "bytes", "bytes/item");
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      char *end;
+      unsigned long long count = strtoull(inputs[i], &end, 10);
+      if (end != inputs[i] && *end == 0)
+        BenchSynthetic((size_t)count, o);
+      else
+        BenchFile(inputs[i], o);
+    }
+  } catch (std::exception &e) {
+    printf("%s\n", e.what());
+    if (json)
+      fclose(json);
+    return EXIT_FAILURE;
+  }
+
+  if (json)
+    fclose(json);
+  return 0;
+}
@@ -0,0 +1,237 @@
+#include "CoffScan.h"
+#include "WorkPool.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace Sora;
+
+static int failures = 0;
+
+static void Check(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+static void Put16(std::vector<BYTE> &b, size_t at, WORD v) {
+  memcpy(&b[at], &v, sizeof(v));
+}
+
+static void Put32(std::vector<BYTE> &b, size_t at, DWORD v) {
+  memcpy(&b[at], &v, sizeof(v));
+}
+
+struct Symbol {
+  const char *name;
+  DWORD value;
+  int section;
+  BYTE storage;
+  BYTE aux;
+};
+
+// an x86 object with the symbols, names longer than 8 characters in the
+// string table. bigObj: the /bigobj layout
+static std::vector<BYTE> MakeObject(const std::vector<Symbol> &symbols,
+                                    bool bigObj) {
+  size_t header = bigObj ? 56 : 20, symSize = bigObj ? 20 : 18;
+  size_t count = 0;
+  for (size_t i = 0; i < symbols.size(); ++i)
+    count += 1 + symbols[i].aux;
+
+  std::vector<BYTE> b(header + count * symSize + 4);
+  std::string strings;
+  if (bigObj) {
+    static const BYTE classId[16] = {0xC7, 0xA1, 0xBA, 0xD1, 0xEE, 0xBA,
+                                     0xA9, 0x4B, 0xAF, 0x20, 0xFA, 0xF6,
+                                     0x6A, 0xA4, 0xDC, 0xB8};
+    Put16(b, 0, 0);
+    Put16(b, 2, 0xFFFF);
+    Put16(b, 4, 2);
+    Put16(b, 6, 0x14C);
+    memcpy(&b[12], classId, 16);
+    Put32(b, 48, (DWORD)header);
+    Put32(b, 52, (DWORD)count);
+  } else {
+    Put16(b, 0, 0x14C);
+    Put32(b, 8, (DWORD)header);
+    Put32(b, 12, (DWORD)count);
+  }
+
+  size_t at = header;
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    const Symbol &s = symbols[i];
+    size_t len = strlen(s.name);
+    if (len <= 8) {
+      memcpy(&b[at], s.name, len);
+    } else {
+      Put32(b, at + 4, (DWORD)(4 + strings.size()));
+      strings.append(s.name, len + 1);
+    }
+    Put32(b, at + 8, s.value);
+    if (bigObj)
+      Put32(b, at + 12, (DWORD)s.section);
+    else
+      Put16(b, at + 12, (WORD)s.section);
+    b[at + symSize - 2] = s.storage;
+    b[at + symSize - 1] = s.aux;
+    at += symSize * (1 + s.aux);
+  }
+
+  Put32(b, at, (DWORD)(4 + strings.size()));
+  b.insert(b.end(), strings.begin(), strings.end());
+  return b;
+}
+
+// an archive of the members, with a first linker member and long names
+static std::vector<BYTE> MakeArchive(
+    const std::vector<std::vector<BYTE>> &members) {
+  std::vector<BYTE> a((const BYTE *)"!<arch>\n", (const BYTE *)"!<arch>\n" + 8);
+  for (size_t i = 0; i <= members.size(); ++i) {
+    // the linker member, made of garbage that must not be read
+    std::vector<BYTE> data = i == 0 ? std::vector<BYTE>(7, 0xFF)
+                                    : members[i - 1];
+    char h[61];
+    snprintf(h, sizeof(h), "%-16s%-12s%-6s%-6s%-8s%-10zu`\n",
+             i == 0 ? "/" : "member.obj/", "0", "", "", "644", data.size());
+    a.insert(a.end(), h, h + 60);
+    a.insert(a.end(), data.begin(), data.end());
+    if (data.size() & 1)
+      a.push_back('\n');
+  }
+  return a;
+}
+
+static std::vector<std::string> Scan(const std::vector<BYTE> &b) {
+  std::vector<std::string_view> names;
+  ScanCoffReferences(b.data(), b.size(), "test.obj", names);
+  std::vector<std::string> r(names.begin(), names.end());
+  std::sort(r.begin(), r.end());
+  return r;
+}
+
+static const char defText[] = "LIBRARY kernel32\n"
+                              "EXPORTS\n"
+                              "  Sleep@4\n"
+                              "  GetTickCount\n"
+                              "  VeryLongFunctionName@8\n"
+                              "  Unused\n"
+                              "  SomeData DATA\n";
+
+int main() {
+  std::vector<Symbol> symbols = {
+      {".text", 0, 1, 3, 1},             // section symbol with an aux record
+      {"_main", 0, 1, 2, 0},             // defined
+      {"__imp__Sleep@4", 0, 0, 2, 0},    // called through the pointer
+      {"_GetTickCount", 0, 0, 2, 0},     // called through the stub
+      {"__imp__VeryLongFunctionName@8", 0, 0, 2, 0},
+      {"_VeryLongFunctionName@8", 0, 0, 2, 0},
+      {"_common", 4, 0, 2, 0},           // common data, defined by the linker
+      {"_static", 0, 0, 3, 0},           // static, not external
+      {"__imp__SomeData", 0, 0, 2, 0}};
+
+  std::vector<std::string> expected = {
+      "_GetTickCount", "_VeryLongFunctionName@8", "__imp__Sleep@4",
+      "__imp__SomeData", "__imp__VeryLongFunctionName@8"};
+
+  // objects
+  std::vector<BYTE> obj = MakeObject(symbols, false);
+  Check(Scan(obj) == expected, "undefined externals of an object");
+  std::vector<BYTE> big = MakeObject(symbols, true);
+  Check(Scan(big) == expected, "undefined externals of a /bigobj object");
+
+  // an import object defines symbols, it references none
+  std::vector<BYTE> imp(20 + 14, 0);
+  Put16(imp, 2, 0xFFFF);
+  Put16(imp, 6, 0x14C);
+  memcpy(&imp[20], "_Foo\0foo.dll", 13);
+  Check(Scan(imp).empty(), "import object");
+
+  // archives
+  std::vector<BYTE> lib = MakeArchive({obj, imp, big});
+  std::vector<std::string_view> names;
+  Check(ScanCoffReferences(lib.data(), lib.size(), "test.lib", names) == 2,
+        "objects of an archive");
+
+  std::string msg;
+  try {
+    std::vector<BYTE> text((const BYTE *)defText,
+                           (const BYTE *)defText + sizeof(defText));
+    Scan(text);
+  } catch (std::exception &e) {
+    msg = e.what();
+  }
+  Check(msg == "test.obj: Not a COFF object or archive", "not an object");
+
+  msg.clear();
+  try {
+    std::vector<BYTE> cut(obj.begin(), obj.begin() + 40);
+    Scan(cut);
+  } catch (std::exception &e) {
+    msg = e.what();
+  }
+  Check(msg == "test.obj: Truncated symbol table", "truncated object");
+
+  // files on the pool
+  {
+    std::ofstream("coffscan1.obj", std::ios::binary)
+        .write((const char *)obj.data(), obj.size());
+    std::ofstream("coffscan2.lib", std::ios::binary)
+        .write((const char *)lib.data(), lib.size());
+
+    CWorkPool pool(4);
+    CSymbolReferences refs;
+    refs.ScanFiles({"coffscan1.obj", "coffscan2.lib"}, &pool);
+    Check(refs.Size() == expected.size() && refs.GetObjectCount() == 3,
+          "files scanned on the pool");
+    remove("coffscan1.obj");
+    remove("coffscan2.lib");
+
+    msg.clear();
+    try {
+      refs.ScanFiles({"coffscan-missing.obj"}, &pool);
+    } catch (std::exception &e) {
+      msg = e.what();
+    }
+    Check(msg == "Fail to open input file coffscan-missing.obj",
+          "missing file");
+  }
+
+  // pruning
+  {
+    CSymbolReferences refs;
+    refs.Scan(obj.data(), obj.size(), "test.obj");
+
+    std::vector<char> text(defText, defText + sizeof(defText));
+    CManifest m;
+    ParseDefManifest(text.data(), text.size() - 1, 32, m, "kernel32.def");
+    PruneUnreferenced(m, refs);
+
+    Check(m.symbols.size() == 4, "unreferenced export dropped");
+    Check(m.symbols[0].name == "Sleep" && m.symbols[0].thunk.empty() &&
+              (m.symbols[0].flags & ESF_NOSTUB),
+          "referenced by pointer only, no stub");
+    Check(m.symbols[1].thunk == "_GetTickCount", "stub kept");
+    Check(m.symbols[2].thunk == "_VeryLongFunctionName@8", "both referenced");
+    Check(m.symbols[3].pubname == "__imp__SomeData", "data");
+
+    // the library is an archive of objects and import objects too
+    IImportLibraryBuilder *b = CreateImpLibBuilder(m);
+    AddImports(m, b);
+    b->Build();
+    std::vector<BYTE> built(b->GetDataLength());
+    b->GetRawData(built.data());
+    b->Dispose();
+
+    CSymbolReferences libRefs;
+    libRefs.Scan(built.data(), built.size(), "kernel32.lib");
+    Check(libRefs.GetObjectCount() > 0, "objects of a generated library");
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -2,13 +2,12 @@
 #include "ImpInterfaces.h"
 
 #include "cofffactory.h"
+#include "coffTrace.h"
 
-#include <WinNT.h>
-#include <Windows.h>
-
+#include <cstddef>
 #include <string>
 
-#define OFFSET(stru, memb) ((DWORD) & ((stru *)0)->memb)
+#define OFFSET(stru, memb) ((DWORD)offsetof(stru, memb))
 
 namespace Sora {
 typedef struct {
@@ -124,9 +123,10 @@ template <class Arch> class CImpSectionBuilder : public IImpSectionBuilder {
 public:
   ICoffFactory *GetCoffFactory() { return cf; }
 
-  int GetPtrSize() { return sizeof(ArchTraits<Arch>::UIntPtr); }
+  int GetPtrSize() { return sizeof(typename ArchTraits<Arch>::UIntPtr); }
 
   void BuildImportDescriptor(LPCSTR szDllName, ICoffBuilder *cb) {
+    SORA_TRACE_SCOPE_ARG("import descriptor", "dll", szDllName);
     IMAGE_IMPORT_DESCRIPTOR iid;
     ZeroMemory(&iid, sizeof(iid));
 
@@ -181,6 +181,7 @@ public:
   void BuildImportThunk(LPCSTR szDllName, LPCSTR szImpName, LPCSTR szFuncName,
                         LPCSTR szDllExpName, WORD nDllExpOrdinal,
                         ICoffBuilder *cb) {
+    SORA_TRACE_SCOPE_ARG("import thunk", "member", szImpName);
     std::string lookupSymbol;
 
     //----------------------------------------------
@@ -195,7 +196,7 @@ public:
       callstubSec->AppendData(ArchTraits<Arch>::JmpMemInst,
                               sizeof(ArchTraits<Arch>::JmpMemInst), 0, 0);
 
-      ArchTraits<Arch>::UIntPtr zeroptr = 0;
+      typename ArchTraits<Arch>::UIntPtr zeroptr = 0;
       IRelocatableVar *funcptr = cf->CreateRelocatableVar();
       funcptr->Set(szImpName, callstubSec, 0, sizeof(zeroptr),
                    ArchTraits<Arch>::PtrReloc);
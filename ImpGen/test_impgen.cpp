@@ -3,22 +3,22 @@
 #include "ImpFactory.h"
 #include "ImpInterfaces.h"
 
+#include <fstream>
+#include <vector>
+
 using namespace Sora;
 
 bool SaveCoff(LPCTSTR fn, ICoffBuilder *cb) {
   cb->PushRelocs();
 
-  HANDLE hFile = CreateFile(fn, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
-  if (hFile != INVALID_HANDLE_VALUE) {
+  std::ofstream f(fn, std::ios::binary);
+  if (f.is_open()) {
     int len = cb->GetDataLength();
-    BYTE *buf = new BYTE[len];
-    cb->GetRawData(buf);
-
-    DWORD olen;
-    WriteFile(hFile, buf, len, &olen, 0);
-    CloseHandle(hFile);
+    std::vector<BYTE> buf(len);
+    cb->GetRawData(buf.data());
 
-    return olen == len;
+    f.write((const char *)buf.data(), len);
+    return !!f;
   }
   return false;
 }
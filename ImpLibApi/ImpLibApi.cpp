@@ -0,0 +1,291 @@
+#include "implib.h"
+
+#include "Manifest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace {
+// the message of implib_last_error, one per thread
+thread_local std::string t_error;
+
+class CApiError : public std::runtime_error {
+public:
+  int status;
+
+  CApiError(int s, const std::string &message)
+      : std::runtime_error(message), status(s) {}
+};
+
+const char *CConvName(int cconv) {
+  switch (cconv) {
+  case IMPLIB_CCONV_CDECL:
+    return "CDECL";
+  case IMPLIB_CCONV_STDCALL:
+    return "STDCALL";
+  case IMPLIB_CCONV_FASTCALL:
+    return "FASTCALL";
+  case IMPLIB_CCONV_VECTORCALL:
+    return "VECTORCALL";
+  }
+  return "";
+}
+
+// the fields of the first version of implib_library, up to export_size:
+// callers built against it pass this size, newer ones more
+const size_t LibraryV1Size =
+    offsetof(implib_library, export_size) + sizeof(size_t);
+
+// the descriptors into a manifest, the strings are copied
+void ReadLibrary(const implib_library *caller, Sora::CManifest &m) {
+  if (caller == 0 || caller->struct_size < LibraryV1Size)
+    throw CApiError(IMPLIB_E_ARGUMENT, "bad implib_library struct_size");
+
+  // the fields the caller knows, those past its struct_size are zero
+  implib_library copy;
+  memset(&copy, 0, sizeof(copy));
+  memcpy(&copy, caller, std::min(caller->struct_size, sizeof(copy)));
+  const implib_library *lib = &copy;
+
+  if (lib->dll_name == 0 || lib->dll_name[0] == 0)
+    throw CApiError(IMPLIB_E_ARGUMENT, "no dll_name");
+  if (lib->arch != 32 && lib->arch != 64)
+    throw CApiError(IMPLIB_E_ARGUMENT,
+                    "arch " + std::to_string(lib->arch) + ", not 32 or 64");
+  if (lib->export_count > 0 && lib->exports == 0)
+    throw CApiError(IMPLIB_E_ARGUMENT, "no exports");
+
+  // older callers pass a smaller export_size, their missing fields are zero
+  size_t stride = lib->export_size;
+  if (stride == 0)
+    stride = sizeof(implib_export);
+  size_t used = stride < sizeof(implib_export) ? stride : sizeof(implib_export);
+
+  m.dllName = m.Store(lib->dll_name);
+  m.arch = lib->arch;
+  m.symbols.reserve(lib->export_count);
+
+  const char *p = (const char *)lib->exports;
+  for (size_t n = 0; n < lib->export_count; ++n, p += stride) {
+    implib_export e;
+    memset(&e, 0, sizeof(e));
+    memcpy(&e, p, used);
+
+    std::string where = "export " + std::to_string(n);
+    Sora::ExportSymbol s = {};
+    s.ord = e.ordinal;
+    s.argBytes = -1;
+    if (e.name != 0)
+      s.name = m.Store(e.name);
+    if (e.flags & IMPLIB_EXPORT_NONAME)
+      s.flags |= Sora::ESF_NONAME;
+    if (e.flags & IMPLIB_EXPORT_DATA)
+      s.flags |= Sora::ESF_DATA;
+
+    if (e.flags & IMPLIB_EXPORT_DECORATE) {
+      if (s.name.empty())
+        throw CApiError(IMPLIB_E_ARGUMENT, where + ": decorated without name");
+      s.flags |= Sora::ESF_DERIVED;
+      s.cconv = CConvName(e.cconv);
+      s.argBytes = e.arg_bytes;
+    } else {
+      if (e.thunk != 0 && !(e.flags & IMPLIB_EXPORT_DATA))
+        s.thunk = m.Store(e.thunk);
+      if (e.pubname != 0)
+        s.pubname = m.Store(e.pubname);
+      else if (e.thunk != 0)
+        s.pubname = m.Store("__imp_", e.thunk);
+      else
+        throw CApiError(IMPLIB_E_ARGUMENT, where + ": no thunk or pubname");
+    }
+
+    if ((s.name.empty() || (s.flags & Sora::ESF_NONAME)) && s.ord <= 0)
+      throw CApiError(IMPLIB_E_ARGUMENT, where + ": by ordinal without ordinal");
+    m.symbols.push_back(s);
+  }
+
+  Sora::DecorateSymbols(m);
+}
+
+// the image memory, from the caller's allocator or malloc
+class CImage {
+  const implib_allocator *m_alloc;
+  void *m_data;
+  size_t m_size;
+
+public:
+  explicit CImage(const implib_allocator *alloc)
+      : m_alloc(alloc), m_data(0), m_size(0) {}
+
+  ~CImage() {
+    if (m_data == 0)
+      return;
+    if (m_alloc == 0)
+      free(m_data);
+    else if (m_alloc->free != 0)
+      m_alloc->free(m_alloc->ctx, m_data, m_size);
+  }
+
+  void Build(const Sora::CManifest &m) {
+    Sora::IImportLibraryBuilder *builder = Sora::CreateImpLibBuilder(m);
+    try {
+      Sora::AddImports(m, builder);
+      builder->Build();
+
+      m_size = builder->GetDataLength();
+      if (m_alloc == 0)
+        m_data = malloc(m_size ? m_size : 1);
+      else
+        m_data = m_alloc->alloc(m_alloc->ctx, m_size);
+      if (m_data == 0)
+        throw CApiError(IMPLIB_E_NO_MEMORY, "allocator failed for " +
+                                                std::to_string(m_size) +
+                                                " bytes");
+
+      builder->GetRawData((PBYTE)m_data);
+    } catch (...) {
+      builder->Dispose();
+      throw;
+    }
+    builder->Dispose();
+  }
+
+  void Write(implib_sink sink, void *ctx) {
+    if (sink(ctx, m_data, m_size) != 0)
+      throw CApiError(IMPLIB_E_OUTPUT, "sink failed");
+  }
+
+  // hand the image over to the caller
+  void Release(void **data, size_t *size) {
+    *data = m_data;
+    *size = m_size;
+    m_data = 0;
+  }
+};
+
+// exceptions never cross the API: they become the status and the message
+template <class F> int Guard(int parseStatus, F f) {
+  try {
+    f();
+    t_error.clear();
+    return IMPLIB_OK;
+  } catch (const CApiError &e) {
+    t_error = e.what();
+    return e.status;
+  } catch (const std::bad_alloc &) {
+    t_error = "out of memory";
+    return IMPLIB_E_NO_MEMORY;
+  } catch (const std::exception &e) {
+    t_error = e.what();
+    return parseStatus;
+  } catch (...) {
+    t_error = "unknown error";
+    return IMPLIB_E_INTERNAL;
+  }
+}
+} // namespace
+
+extern "C" {
+IMPLIB_API unsigned implib_version(void) {
+  return (IMPLIB_VERSION_MAJOR << 16) | IMPLIB_VERSION_MINOR;
+}
+
+IMPLIB_API int implib_build(const implib_library *lib,
+                            const implib_allocator *alloc, void **data,
+                            size_t *size) {
+  return Guard(IMPLIB_E_INTERNAL, [&] {
+    if (data == 0 || size == 0)
+      throw CApiError(IMPLIB_E_ARGUMENT, "no data or size");
+    if (alloc != 0 && alloc->alloc == 0)
+      throw CApiError(IMPLIB_E_ARGUMENT, "allocator without alloc");
+
+    Sora::CManifest m;
+    ReadLibrary(lib, m);
+    CImage image(alloc);
+    image.Build(m);
+    image.Release(data, size);
+  });
+}
+
+IMPLIB_API int implib_write(const implib_library *lib,
+                            const implib_allocator *alloc, implib_sink sink,
+                            void *ctx) {
+  return Guard(IMPLIB_E_INTERNAL, [&] {
+    if (sink == 0)
+      throw CApiError(IMPLIB_E_ARGUMENT, "no sink");
+    if (alloc != 0 && alloc->alloc == 0)
+      throw CApiError(IMPLIB_E_ARGUMENT, "allocator without alloc");
+
+    Sora::CManifest m;
+    ReadLibrary(lib, m);
+    CImage image(alloc);
+    image.Build(m);
+    image.Write(sink, ctx);
+  });
+}
+
+IMPLIB_API int implib_write_manifest(const void *text, size_t len, int arch,
+                                     const implib_allocator *alloc,
+                                     implib_sink sink, void *ctx) {
+  return Guard(IMPLIB_E_PARSE, [&] {
+    if (text == 0 && len > 0)
+      throw CApiError(IMPLIB_E_ARGUMENT, "no text");
+    if (arch != 0 && arch != 32 && arch != 64)
+      throw CApiError(IMPLIB_E_ARGUMENT,
+                      "arch " + std::to_string(arch) + ", not 0, 32 or 64");
+    if (sink == 0)
+      throw CApiError(IMPLIB_E_ARGUMENT, "no sink");
+    if (alloc != 0 && alloc->alloc == 0)
+      throw CApiError(IMPLIB_E_ARGUMENT, "allocator without alloc");
+
+    // parsed in place: a copy of the caller's text
+    Sora::CManifest m;
+    char *copy = m.Allocate(len + 1);
+    if (len > 0)
+      memcpy(copy, text, len);
+    copy[len] = 0;
+    Sora::ParseManifest(copy, len, arch, m, "manifest");
+    if (m.dllName.empty())
+      throw CApiError(IMPLIB_E_PARSE, "manifest: no dll name");
+
+    CImage image(alloc);
+    try {
+      image.Build(m);
+    } catch (const CApiError &) {
+      throw;
+    } catch (const std::bad_alloc &) {
+      throw;
+    } catch (const std::exception &e) {
+      throw CApiError(IMPLIB_E_INTERNAL, e.what());
+    }
+    image.Write(sink, ctx);
+  });
+}
+
+IMPLIB_API void implib_free(void *data) { free(data); }
+
+IMPLIB_API const char *implib_last_error(void) { return t_error.c_str(); }
+
+IMPLIB_API const char *implib_status_string(int status) {
+  switch (status) {
+  case IMPLIB_OK:
+    return "ok";
+  case IMPLIB_E_ARGUMENT:
+    return "bad argument";
+  case IMPLIB_E_NO_MEMORY:
+    return "out of memory";
+  case IMPLIB_E_OUTPUT:
+    return "output failed";
+  case IMPLIB_E_PARSE:
+    return "bad export list";
+  case IMPLIB_E_INTERNAL:
+    return "internal error";
+  }
+  return "unknown status";
+}
+}
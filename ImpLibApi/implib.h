@@ -0,0 +1,138 @@
+/*
+ * implib: import libraries in-process, through a stable C ABI.
+ *
+ * Thread safety: every function may be called from any number of threads at
+ * the same time. A call only touches its arguments and the memory it
+ * allocates, there is no shared state between calls. The callbacks of a call
+ * run on the calling thread, one at a time, before the call returns; an
+ * allocator or a sink given to concurrent calls must be thread-safe itself.
+ * Input strings and arrays are only read during the call.
+ *
+ * Memory: the library image is put in memory from the caller's allocator,
+ * or malloc without one. The builders inside use the C++ runtime heap for
+ * their own objects, all released before the call returns.
+ *
+ * Compatibility: within a major version only additions are made: functions,
+ * flags, status codes and structure fields at the end. Callers pass the size
+ * of the structures they were built with, fields they don't know are given
+ * their defaults.
+ */
+
+#ifndef IMPLIB_H
+#define IMPLIB_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(IMPLIB_BUILD)
+#define IMPLIB_API __declspec(dllexport)
+#else
+#define IMPLIB_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define IMPLIB_API __attribute__((visibility("default")))
+#else
+#define IMPLIB_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IMPLIB_VERSION_MAJOR 1
+#define IMPLIB_VERSION_MINOR 0
+
+enum implib_status {
+  IMPLIB_OK = 0,
+  IMPLIB_E_ARGUMENT = 1,  /* a bad library or export descriptor */
+  IMPLIB_E_NO_MEMORY = 2, /* the allocator or the heap failed */
+  IMPLIB_E_OUTPUT = 3,    /* the sink returned nonzero */
+  IMPLIB_E_PARSE = 4,     /* implib_write_manifest: the export list */
+  IMPLIB_E_INTERNAL = 5
+};
+
+enum implib_export_flags {
+  IMPLIB_EXPORT_NONAME = 1,  /* import by ordinal even if a name is given */
+  IMPLIB_EXPORT_DATA = 2,    /* a variable: no call stub */
+  IMPLIB_EXPORT_DECORATE = 4 /* thunk and pubname made of name, cconv and
+                                arg_bytes like for a .def file */
+};
+
+/* for IMPLIB_EXPORT_DECORATE on x86: cdecl _name, stdcall _name@n,
+ * fastcall @name@n, vectorcall name@@n. x64 names are never decorated. */
+enum implib_cconv {
+  IMPLIB_CCONV_UNKNOWN = 0, /* _name */
+  IMPLIB_CCONV_CDECL = 1,
+  IMPLIB_CCONV_STDCALL = 2,
+  IMPLIB_CCONV_FASTCALL = 3,
+  IMPLIB_CCONV_VECTORCALL = 4
+};
+
+typedef struct implib_export {
+  const char *name;    /* exported from the dll: Sleep. NULL: by ordinal */
+  const char *thunk;   /* the call stub: _Sleep@4. NULL: no stub */
+  const char *pubname; /* the import pointer: __imp__Sleep@4.
+                          NULL: __imp_ + thunk */
+  int ordinal;         /* the ordinal of by-ordinal imports */
+  int flags;           /* implib_export_flags */
+  int cconv;           /* implib_cconv, for IMPLIB_EXPORT_DECORATE */
+  int arg_bytes;       /* the @n of stdcall, fastcall and vectorcall names,
+                          -1: unknown */
+} implib_export;
+
+typedef struct implib_library {
+  size_t struct_size;           /* sizeof(implib_library) */
+  const char *dll_name;         /* kernel32.dll, also the member name */
+  int arch;                     /* 32: x86, 64: x64 */
+  const implib_export *exports; /* in library order */
+  size_t export_count;
+  size_t export_size; /* sizeof(implib_export), the stride of exports */
+} implib_library;
+
+/* memory for the library image, e.g. from an arena. free may be NULL */
+typedef struct implib_allocator {
+  void *(*alloc)(void *ctx, size_t size);
+  void (*free)(void *ctx, void *p, size_t size);
+  void *ctx;
+} implib_allocator;
+
+/* receives the library image, in one or more pieces in order.
+ * return: 0 to go on, nonzero fails the call with IMPLIB_E_OUTPUT */
+typedef int (*implib_sink)(void *ctx, const void *data, size_t size);
+
+/* (IMPLIB_VERSION_MAJOR << 16) | IMPLIB_VERSION_MINOR of the library */
+IMPLIB_API unsigned implib_version(void);
+
+/* the library image in memory from alloc, NULL: malloc, release it with
+ * implib_free. *data and *size are set on success only */
+IMPLIB_API int implib_build(const implib_library *lib,
+                            const implib_allocator *alloc, void **data,
+                            size_t *size);
+
+/* the library image handed to sink. alloc provides the memory the image is
+ * made in, NULL: malloc; it is released before the call returns */
+IMPLIB_API int implib_write(const implib_library *lib,
+                            const implib_allocator *alloc, implib_sink sink,
+                            void *ctx);
+
+/* the library of an export list in any format mkimplib reads: .def text,
+ * JSON or binary manifest, or the PE image of the dll.
+ * arch: for .def text, 32 or 64; 0: x86 */
+IMPLIB_API int implib_write_manifest(const void *text, size_t len, int arch,
+                                     const implib_allocator *alloc,
+                                     implib_sink sink, void *ctx);
+
+/* an image of implib_build without allocator */
+IMPLIB_API void implib_free(void *data);
+
+/* the message of the last failed call of the calling thread, "" if none */
+IMPLIB_API const char *implib_last_error(void);
+
+/* IMPLIB_E_ARGUMENT -> "bad argument" ... */
+IMPLIB_API const char *implib_status_string(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
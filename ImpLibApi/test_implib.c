@@ -0,0 +1,234 @@
+/* the C API from C: the header must compile without C++ */
+#include "implib.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);          \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+/* a sink gathering the pieces */
+struct buffer {
+  char *data;
+  size_t size;
+  int calls;
+};
+
+static int append(void *ctx, const void *data, size_t size) {
+  struct buffer *b = (struct buffer *)ctx;
+  b->data = (char *)realloc(b->data, b->size + size);
+  memcpy(b->data + b->size, data, size);
+  b->size += size;
+  b->calls += 1;
+  return 0;
+}
+
+static int refuse(void *ctx, const void *data, size_t size) {
+  (void)ctx;
+  (void)data;
+  (void)size;
+  return 1;
+}
+
+/* a bump allocator, nothing is freed before the end */
+struct arena {
+  char mem[1 << 16];
+  size_t used;
+  int allocs;
+  int frees;
+};
+
+static void *arena_alloc(void *ctx, size_t size) {
+  struct arena *a = (struct arena *)ctx;
+  void *p;
+  if (size > sizeof(a->mem) - a->used)
+    return NULL;
+  p = a->mem + a->used;
+  a->used += (size + 15) & ~(size_t)15;
+  a->allocs += 1;
+  return p;
+}
+
+static void arena_free(void *ctx, void *p, size_t size) {
+  (void)p;
+  (void)size;
+  ((struct arena *)ctx)->frees += 1;
+}
+
+static const char def[] = "LIBRARY test.dll\n"
+                          "EXPORTS\n"
+                          "  Sleep@4\n"
+                          "  GetTickCount\n"
+                          "  @Fast@8\n"
+                          "  g_value DATA\n"
+                          "  Hidden @7 NONAME\n";
+
+/* the exports of def, decorated by the library */
+static const implib_export decorated[] = {
+    {"Sleep", NULL, NULL, 0, IMPLIB_EXPORT_DECORATE, IMPLIB_CCONV_STDCALL, 4},
+    {"GetTickCount", NULL, NULL, 0, IMPLIB_EXPORT_DECORATE,
+     IMPLIB_CCONV_CDECL, -1},
+    {"Fast", NULL, NULL, 0, IMPLIB_EXPORT_DECORATE, IMPLIB_CCONV_FASTCALL, 8},
+    {"g_value", NULL, NULL, 0, IMPLIB_EXPORT_DECORATE | IMPLIB_EXPORT_DATA,
+     IMPLIB_CCONV_CDECL, -1},
+    {"Hidden", NULL, NULL, 7, IMPLIB_EXPORT_DECORATE | IMPLIB_EXPORT_NONAME,
+     IMPLIB_CCONV_CDECL, -1},
+};
+
+/* and decorated by the caller */
+static const implib_export spelled[] = {
+    {"Sleep", "_Sleep@4", NULL, 0, 0, 0, -1},
+    {"GetTickCount", "_GetTickCount", "__imp__GetTickCount", 0, 0, 0, -1},
+    {"Fast", "@Fast@8", NULL, 0, 0, 0, -1},
+    {"g_value", NULL, "__imp__g_value", 0, IMPLIB_EXPORT_DATA, 0, -1},
+    {NULL, "_Hidden", NULL, 7, 0, 0, -1},
+};
+
+static implib_library library(const implib_export *exports, size_t count) {
+  implib_library lib;
+  memset(&lib, 0, sizeof(lib));
+  lib.struct_size = sizeof(lib);
+  lib.dll_name = "test.dll";
+  lib.arch = 32;
+  lib.exports = exports;
+  lib.export_count = count;
+  lib.export_size = sizeof(implib_export);
+  return lib;
+}
+
+int main(void) {
+  struct buffer fromDef = {NULL, 0, 0};
+  struct buffer fromDesc = {NULL, 0, 0};
+  struct arena *arena = (struct arena *)calloc(1, sizeof(struct arena));
+  implib_allocator alloc;
+  implib_library lib;
+  void *data;
+  size_t size;
+  int r;
+
+  alloc.alloc = arena_alloc;
+  alloc.free = arena_free;
+  alloc.ctx = arena;
+
+  CHECK(implib_version() >> 16 == IMPLIB_VERSION_MAJOR);
+
+  /* .def text and descriptors make the same library */
+  r = implib_write_manifest(def, strlen(def), 32, NULL, append, &fromDef);
+  CHECK(r == IMPLIB_OK);
+  CHECK(fromDef.size > 8 && memcmp(fromDef.data, "!<arch>\n", 8) == 0);
+
+  lib = library(decorated, 5);
+  r = implib_write(&lib, &alloc, append, &fromDesc);
+  CHECK(r == IMPLIB_OK);
+  CHECK(fromDesc.size == fromDef.size &&
+        memcmp(fromDesc.data, fromDef.data, fromDef.size) == 0);
+  CHECK(arena->allocs == 1 && arena->frees == 1);
+
+  lib = library(spelled, 5);
+  r = implib_build(&lib, &alloc, &data, &size);
+  CHECK(r == IMPLIB_OK);
+  CHECK(size == fromDef.size && memcmp(data, fromDef.data, size) == 0);
+  CHECK(arena->allocs == 2 && arena->frees == 1);
+
+  r = implib_build(&lib, NULL, &data, &size);
+  CHECK(r == IMPLIB_OK);
+  CHECK(size == fromDef.size && memcmp(data, fromDef.data, size) == 0);
+  implib_free(data);
+
+  /* a newer caller with a longer implib_export */
+  lib = library(spelled, 5);
+  lib.export_size = sizeof(implib_export) + 16;
+  {
+    char wide[5][sizeof(implib_export) + 16];
+    int i;
+    for (i = 0; i < 5; ++i)
+      memcpy(wide[i], &spelled[i], sizeof(implib_export));
+    lib.exports = (const implib_export *)wide;
+    r = implib_build(&lib, NULL, &data, &size);
+    CHECK(r == IMPLIB_OK);
+    CHECK(size == fromDef.size && memcmp(data, fromDef.data, size) == 0);
+    implib_free(data);
+  }
+
+  /* a caller built against the first implib_library, and a newer one */
+  lib = library(spelled, 5);
+  lib.struct_size = offsetof(implib_library, export_size) + sizeof(size_t);
+  r = implib_build(&lib, NULL, &data, &size);
+  CHECK(r == IMPLIB_OK);
+  CHECK(size == fromDef.size && memcmp(data, fromDef.data, size) == 0);
+  implib_free(data);
+  {
+    struct {
+      implib_library lib;
+      int added;
+    } newer;
+    newer.lib = library(spelled, 5);
+    newer.lib.struct_size = sizeof(newer);
+    newer.added = 1;
+    r = implib_build(&newer.lib, NULL, &data, &size);
+    CHECK(r == IMPLIB_OK);
+    CHECK(size == fromDef.size && memcmp(data, fromDef.data, size) == 0);
+    implib_free(data);
+  }
+
+  /* errors come back as status and message */
+  lib = library(decorated, 5);
+  lib.arch = 16;
+  CHECK(implib_build(&lib, NULL, &data, &size) == IMPLIB_E_ARGUMENT);
+  CHECK(strstr(implib_last_error(), "arch") != NULL);
+
+  lib = library(decorated, 5);
+  lib.dll_name = NULL;
+  CHECK(implib_build(&lib, NULL, &data, &size) == IMPLIB_E_ARGUMENT);
+
+  lib = library(decorated, 5);
+  lib.struct_size = 8;
+  CHECK(implib_build(&lib, NULL, &data, &size) == IMPLIB_E_ARGUMENT);
+
+  {
+    implib_export bad = {NULL, NULL, NULL, 0, 0, 0, -1};
+    lib = library(&bad, 1);
+    CHECK(implib_build(&lib, NULL, &data, &size) == IMPLIB_E_ARGUMENT);
+    CHECK(strstr(implib_last_error(), "export 0") != NULL);
+  }
+
+  lib = library(decorated, 5);
+  CHECK(implib_write(&lib, &alloc, refuse, NULL) == IMPLIB_E_OUTPUT);
+  CHECK(arena->allocs == arena->frees + 1);
+
+  arena->used = sizeof(arena->mem);
+  CHECK(implib_build(&lib, &alloc, &data, &size) == IMPLIB_E_NO_MEMORY);
+
+  r = implib_write_manifest("EXPORTS\n  Bad @x\n", 17, 32, NULL, append,
+                            &fromDesc);
+  CHECK(r == IMPLIB_E_PARSE);
+  CHECK(strstr(implib_last_error(), "ordinal") != NULL);
+
+  CHECK(implib_write_manifest(def, strlen(def), 48, NULL, append, &fromDesc) ==
+        IMPLIB_E_ARGUMENT);
+
+  /* a good call clears the message */
+  lib = library(decorated, 5);
+  CHECK(implib_build(&lib, NULL, &data, &size) == IMPLIB_OK);
+  implib_free(data);
+  CHECK(implib_last_error()[0] == 0);
+  CHECK(strcmp(implib_status_string(IMPLIB_E_OUTPUT), "output failed") == 0);
+
+  free(fromDef.data);
+  free(fromDesc.data);
+  free(arena);
+
+  if (failures != 0)
+    return 1;
+  printf("test_implib: ok\n");
+  return 0;
+}
@@ -1,7 +1,5 @@
 #include "ImpLibFix.h"
 
-#include <winnt.h>
-
 #include <algorithm>
 #include <string>
 
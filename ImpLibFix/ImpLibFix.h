@@ -1,7 +1,7 @@
 #ifndef IMPLIBFIX_H
 #define IMPLIBFIX_H
 
-#include <Windows.h>
+#include "coffFormat.h"
 
 namespace Sora {
 // not include the \0
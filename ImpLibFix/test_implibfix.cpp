@@ -1,21 +1,39 @@
 #include "ImpLibFix.h"
+
+#include <algorithm>
 #include <stdio.h>
+#include <string.h>
+#include <string>
+
+// "!<arch>\n", a linker member and a single object member
+static std::string BuildArchive() {
+  std::string r = IMAGE_ARCHIVE_START;
+  r += "/               0           0     0     0       4         `\n";
+  r += std::string(4, '\0');
+  r += "a.dll/          0           0     0     0       3         `\n";
+  r += "obj";
+  r += IMAGE_ARCHIVE_PAD;
+  return r;
+}
 
 int main() {
-  FILE *f = fopen("ims.lib", "rb+");
-  fseek(f, 0, SEEK_END);
-  int fs = ftell(f);
-  fseek(f, 0, SEEK_SET);
+  std::string lib = BuildArchive();
+  int fs = lib.size();
 
   PBYTE buf = new BYTE[fs];
-  fread(buf, 1, fs, f);
+  std::copy(lib.begin(), lib.end(), buf);
 
-  Sora::RenameImpLibObjects("member/", buf, fs);
+  int cnt = Sora::RenameImpLibObjects("member/", buf, fs);
 
-  fseek(f, 0, SEEK_SET);
-  fwrite(buf, 1, fs, f);
-
-  fclose(f);
+  FILE *f = fopen("ims.lib", "wb");
+  if (f != 0) {
+    fwrite(buf, 1, fs, f);
+    fclose(f);
+  }
 
+  bool ok = cnt == 1 && memcmp(buf + IMAGE_ARCHIVE_START_SIZE + 60 + 4,
+                               "member/         ", 16) == 0;
   delete[] buf;
+
+  return ok ? 0 : 1;
 }
@@ -1,12 +1,14 @@
 #include "LibFactory.h"
 #include "LibInterfaces.h"
 
+#include "coffHooks.h"
+
 #include <algorithm>
+#include <cstring>
 #include <exception>
-#include <map>
-#include <set>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -51,29 +53,103 @@ static DWORD32 GetBigEndian(DWORD32 val) {
 
 class CBaseLinkMemberBuilder : public IHasRawData {
 public:
-  struct StringLesser {
-    bool operator()(const std::string &lhs, const std::string &rhs) const {
-      return strcmp(lhs.c_str(), rhs.c_str()) < 0;
-    }
+  // a public symbol and the member defining it
+  struct Symbol {
+    std::string name;
+    ICoffBuilder *member;
   };
 
+  static bool SymbolLesser(const Symbol &lhs, const Symbol &rhs) {
+    return strcmp(lhs.name.c_str(), rhs.name.c_str()) < 0;
+  }
+
+  static bool SymbolEqual(const Symbol &lhs, const Symbol &rhs) {
+    return lhs.name == rhs.name;
+  }
+
 protected:
   // slm: Second link Member
-  typedef std::map<ICoffBuilder *, int> OffsetCollection;
+  typedef std::unordered_map<ICoffBuilder *, int> OffsetCollection;
   OffsetCollection m_offsets;
-  typedef std::map<std::string, ICoffBuilder *, StringLesser> SymbolCollection;
+  // sorted by name up to m_indexed, the first member added wins a name.
+  // symbols of later members are appended and sorted in by BuildIndex
+  typedef std::vector<Symbol> SymbolCollection;
   SymbolCollection m_symbols;
+  size_t m_indexed;
 
-  template <typename Iterator> int GetIterIndex(Iterator x, Iterator begin) {
-    int r = 0;
-    while (x != begin) {
-      ++begin;
-      ++r;
+public:
+  CBaseLinkMemberBuilder() : m_indexed(0) {}
+
+  void BuildIndex() {
+    if (m_indexed == m_symbols.size())
+      return;
+
+    CPhaseScope phase(BP_LINKMEMBERS);
+    // stable: of equal names the one of the earlier member comes first
+    SymbolCollection::iterator mid = m_symbols.begin() + m_indexed;
+    std::stable_sort(mid, m_symbols.end(), SymbolLesser);
+    std::inplace_merge(m_symbols.begin(), mid, m_symbols.end(), SymbolLesser);
+    m_symbols.erase(
+        std::unique(m_symbols.begin(), m_symbols.end(), SymbolEqual),
+        m_symbols.end());
+    m_indexed = m_symbols.size();
+  }
+
+  // takes the members and symbols of shards as if they were appended here
+  // one by one. the sorted indexes are merged in one pass, of equal names the
+  // one of the earliest index is kept
+  void AppendLinkMembers(CBaseLinkMemberBuilder **shards, int count) {
+    CPhaseScope phase(BP_LINKMEMBERS);
+    // run 0 is the index of this builder
+    BuildIndex();
+    std::vector<SymbolCollection *> runs(1, &m_symbols);
+    size_t total = m_symbols.size();
+    for (int i = 0; i < count; ++i) {
+      shards[i]->BuildIndex();
+      runs.push_back(&shards[i]->m_symbols);
+      total += shards[i]->m_symbols.size();
+      m_offsets.insert(shards[i]->m_offsets.begin(),
+                       shards[i]->m_offsets.end());
+    }
+
+    // (run, position) of the next symbol of every run, the smallest on top
+    typedef std::pair<size_t, size_t> Cursor;
+    std::vector<Cursor> heap;
+    for (size_t r = 0; r < runs.size(); ++r) {
+      if (!runs[r]->empty())
+        heap.push_back(Cursor(r, 0));
+    }
+    auto greater = [&runs](const Cursor &a, const Cursor &b) {
+      int c = strcmp((*runs[a.first])[a.second].name.c_str(),
+                     (*runs[b.first])[b.second].name.c_str());
+      return c > 0 || (c == 0 && a.first > b.first);
+    };
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    SymbolCollection merged;
+    merged.reserve(total);
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      Cursor &top = heap.back();
+      Symbol &s = (*runs[top.first])[top.second];
+      if (merged.empty() || merged.back().name != s.name)
+        merged.push_back(std::move(s));
+
+      if (++top.second < runs[top.first]->size())
+        std::push_heap(heap.begin(), heap.end(), greater);
+      else
+        heap.pop_back();
+    }
+
+    m_symbols.swap(merged);
+    m_indexed = m_symbols.size();
+    for (int i = 0; i < count; ++i) {
+      shards[i]->m_offsets.clear();
+      shards[i]->m_symbols.clear();
+      shards[i]->m_indexed = 0;
     }
-    return r;
   }
 
-public:
   bool SetMemberOffset(ICoffBuilder *member, int offset) {
     OffsetCollection::iterator x = m_offsets.find(member);
     if (x != m_offsets.end()) {
@@ -90,8 +166,11 @@ public:
         member->GetSymbolTableBuilder()->GetPublicSymbolNames();
     int cnt = sns->GetCount();
     int i;
-    for (i = 0; i < cnt; ++i)
-      m_symbols.emplace(sns->GetString(i), member);
+    for (i = 0; i < cnt; ++i) {
+      Symbol s = {sns->GetString(i), member};
+      m_symbols.push_back(s);
+    }
+    CountBuild(BC_SYMBOLS, cnt);
 
     sns->Dispose();
   }
@@ -128,8 +207,8 @@ public:
       iend = m_symbols.end();
       for (; i != iend; ++i) {
         OffsetCollection::iterator x;
-        x = m_offsets.find(i->second);
-        tmp.push_back(std::make_pair(x->second, i->first));
+        x = m_offsets.find(i->member);
+        tmp.push_back(std::make_pair(x->second, i->name));
       }
 
       std::sort(tmp.begin(), tmp.end(),
@@ -171,7 +250,7 @@ public:
     // string table
     SymbolCollection::iterator i = m_symbols.begin(), iend = m_symbols.end();
     for (; i != iend; ++i)
-      r += i->first.size() + 1; // null terminated
+      r += i->name.size() + 1; // null terminated
 
     return r;
   }
@@ -192,12 +271,15 @@ public:
     ++pMemberCnt;
 
     PDWORD32 arrMemberOffset = pMemberCnt;
-    std::set<int> tmpOffsets;
+    std::vector<int> tmpOffsets;
     {
       OffsetCollection::iterator i = m_offsets.begin(), iend = m_offsets.end();
       for (; i != iend; ++i)
-        tmpOffsets.insert(i->second);
+        tmpOffsets.push_back(i->second);
 
+      std::sort(tmpOffsets.begin(), tmpOffsets.end());
+      tmpOffsets.erase(std::unique(tmpOffsets.begin(), tmpOffsets.end()),
+                       tmpOffsets.end());
       std::copy(tmpOffsets.begin(), tmpOffsets.end(), arrMemberOffset);
       arrMemberOffset += tmpOffsets.size();
     }
@@ -210,11 +292,11 @@ public:
     {
       SymbolCollection::iterator i = m_symbols.begin(), iend = m_symbols.end();
       for (; i != iend; ++i) {
-        ICoffBuilder *c = i->second;
+        ICoffBuilder *c = i->member;
         OffsetCollection::iterator x = m_offsets.find(c);
-        std::set<int>::iterator y = tmpOffsets.find(x->second);
-        *pSymbolBelongOffset =
-            GetIterIndex(y, tmpOffsets.begin()) + 1; // 1-based index
+        std::vector<int>::iterator y = std::lower_bound(
+            tmpOffsets.begin(), tmpOffsets.end(), x->second);
+        *pSymbolBelongOffset = (y - tmpOffsets.begin()) + 1; // 1-based index
         ++pSymbolBelongOffset;
       }
     }
@@ -223,9 +305,9 @@ public:
     {
       SymbolCollection::iterator i = m_symbols.begin(), iend = m_symbols.end();
       for (; i != iend; ++i) {
-        int sl = i->first.size();
+        int sl = i->name.size();
 
-        i->first.copy(pStringTable, sl);
+        i->name.copy(pStringTable, sl);
         pStringTable += sl;
         *pStringTable = 0;
         ++pStringTable;
@@ -244,7 +326,7 @@ public:
     // string table
     SymbolCollection::iterator i = m_symbols.begin(), iend = m_symbols.end();
     for (; i != iend; ++i)
-      r += i->first.size() + 1; // null terminated
+      r += i->name.size() + 1; // null terminated
 
     return r;
   }
@@ -286,6 +368,7 @@ public:
 
   void GetRawData(PBYTE buf) {
     PBYTE pBufBegin = buf;
+    m_linkMember.BuildIndex();
 
     // sign
     std::copy(IMAGE_ARCHIVE_START,
@@ -314,6 +397,8 @@ public:
       buf += i->second->GetDataLength();
       DoPad(buf, buf - pBufBegin);
     }
+
+    CountBuild(BC_BYTES, buf - pBufBegin);
   }
 
   int GetDataLength() { return CalcSizeOrFillOffsets(false); }
@@ -322,12 +407,32 @@ public:
     cb->PushRelocs();
     m_members.push_back(std::make_pair(std::string(szName), cb));
     m_linkMember.AppendMember(cb);
+    CountBuild(BC_MEMBERS, 1);
+  }
+
+  void FillOffsets() {
+    CPhaseScope phase(BP_FILLOFFSETS);
+    CalcSizeOrFillOffsets(true);
   }
 
-  void FillOffsets() { CalcSizeOrFillOffsets(true); }
+  void BuildIndex() { m_linkMember.BuildIndex(); }
+
+  void AppendLibraries(ILibraryBuilder **shards, int count) {
+    SORA_TRACE_SCOPE_ARG("append libraries", "shards", (long long)count);
+    std::vector<CBaseLinkMemberBuilder *> linkMembers;
+    for (int i = 0; i < count; ++i) {
+      CLibraryBuilder *s = static_cast<CLibraryBuilder *>(shards[i]);
+      m_members.insert(m_members.end(), s->m_members.begin(),
+                       s->m_members.end());
+      s->m_members.clear();
+      linkMembers.push_back(&s->m_linkMember);
+    }
+    m_linkMember.AppendLinkMembers(linkMembers.data(), count);
+  }
 
   int CalcSizeOrFillOffsets(bool bFillOffset) {
     int curPos = 0;
+    m_linkMember.BuildIndex();
 
     // sign
     curPos += IMAGE_ARCHIVE_START_SIZE;
@@ -12,6 +12,17 @@ public:
   // call this method to calculate the offset for first and second link member
   // before retrive raw data
   virtual void FillOffsets() = 0;
+
+  // sorts the symbols of the members added so far into the index of the link
+  // members. FillOffsets does it too; a shard built on another thread calls it
+  // there, so that only the merge is left for AppendLibraries
+  virtual void BuildIndex() = 0;
+
+  // moves the members of libraries built separately, shards, behind the
+  // members added so far, in order, and merges their symbol indexes in one
+  // pass. the result is the same as adding the members here one by one.
+  // the shards are left empty, dispose them
+  virtual void AppendLibraries(ILibraryBuilder **shards, int count) = 0;
 };
 }; // namespace Sora
 
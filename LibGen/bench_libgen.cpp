@@ -0,0 +1,160 @@
+// time of the archive around the members of an import library
+//
+// usage: bench_libgen [--json <file>] [member count ...]
+//
+// every member is a small object with two extern symbols, like the thunk and
+// the __imp_ pointer of an import:
+// AddObject: the members into a library, their symbols into the link members
+// BuildIndex: the sort of the symbols of the first and second link member
+// FillOffsets: the member offsets written into the link members
+// GetRawData: GetDataLength and GetRawData of the whole archive
+// AppendLibraries: the same members in 4 shards, indexed and merged
+//
+// counts are 1k, 10k and 100k by default. the allocations of every case are
+// counted by the counting operator new (coffHooks.h). with --json every
+// result is also written to the file as a JSON line:
+// {"bench": "libgen", "case": "AddObject", "n": 1000, "ms": 0.1, "ns_per_item": 100.0,
+//  "allocs_per_item": 2.00, "alloc_bytes_per_item": 48.0}
+
+#include "LibFactory.h"
+#include "LibInterfaces.h"
+
+#include "cofffactory.h"
+#include "coffHooks.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace Sora;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+static FILE *json = 0;
+
+// before: the allocation totals at the start of the case
+static void Report(const char *name, int n, double ms,
+                   const AllocStats &before) {
+  AllocStats after = GetAllocTotals();
+  double allocs = (double)(after.count - before.count) / n;
+  double bytes = (double)(after.bytes - before.bytes) / n;
+  printf("%-16s %9d %10.2f %12.1f %12.2f %12.1f\n", name, n, ms, ms * 1e6 / n,
+         allocs, bytes);
+  if (json)
+    fprintf(json,
+            "{\"bench\": \"libgen\", \"case\": \"%s\", \"n\": %d, "
+            "\"ms\": %.3f, \"ns_per_item\": %.1f, \"allocs_per_item\": %.2f, "
+            "\"alloc_bytes_per_item\": %.1f}\n",
+            name, n, ms, ms * 1e6 / n, allocs, bytes);
+}
+
+static std::vector<ICoffBuilder *> MakeMembers(int n) {
+  ICoffFactory *fac = GetX64CoffFactory();
+  std::vector<ICoffBuilder *> r(n);
+  BYTE code[8] = {0xff, 0x25};
+  char name[64];
+  for (int i = 0; i < n; ++i) {
+    r[i] = fac->CreateCoffBuilder();
+    ISectionBuilder *text = fac->CreateSectionBuilder();
+    text->SetName(".text");
+    text->SetCharacteristics(SECH_READ | SECH_EXEC | SECH_CODE | SECH_ALIGN2);
+    text->AppendData(code, sizeof(code), 0, 0);
+    r[i]->AppendSection(text);
+
+    ISymbolTableBuilder *symbols = r[i]->GetSymbolTableBuilder();
+    snprintf(name, sizeof(name), "BenchFunction%07dEx", i);
+    symbols->AddSymbol(text, 0, name, SYST_EXTERN, 0);
+    snprintf(name, sizeof(name), "__imp_BenchFunction%07dEx", i);
+    symbols->AddSymbol(text, 0, name, SYST_EXTERN, 0);
+  }
+  return r;
+}
+
+static void Bench(int n) {
+  std::vector<ICoffBuilder *> members = MakeMembers(n);
+
+  ILibraryBuilder *lib = CreateLibraryBuilder();
+  AllocStats before = GetAllocTotals();
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < n; ++i)
+    lib->AddObject("bench.dll", members[i]);
+  Report("AddObject", n, MsSince(start), before);
+
+  before = GetAllocTotals();
+  start = Clock::now();
+  lib->BuildIndex();
+  Report("BuildIndex", n, MsSince(start), before);
+
+  before = GetAllocTotals();
+  start = Clock::now();
+  lib->FillOffsets();
+  Report("FillOffsets", n, MsSince(start), before);
+
+  before = GetAllocTotals();
+  start = Clock::now();
+  std::vector<BYTE> raw(lib->GetDataLength());
+  lib->GetRawData(raw.data());
+  Report("GetRawData", n, MsSince(start), before);
+  lib->Dispose();
+
+  // the members again, a library keeps no reference to them once disposed
+  const int shardCount = 4;
+  ILibraryBuilder *merged = CreateLibraryBuilder();
+  ILibraryBuilder *shards[shardCount];
+  before = GetAllocTotals();
+  start = Clock::now();
+  for (int s = 0; s < shardCount; ++s) {
+    shards[s] = CreateLibraryBuilder();
+    for (int i = n * s / shardCount; i < n * (s + 1) / shardCount; ++i)
+      shards[s]->AddObject("bench.dll", members[i]);
+    shards[s]->BuildIndex();
+  }
+  merged->AppendLibraries(shards, shardCount);
+  merged->FillOffsets();
+  Report("AppendLibraries", n, MsSince(start), before);
+
+  std::vector<BYTE> rawMerged(merged->GetDataLength());
+  merged->GetRawData(rawMerged.data());
+  if (rawMerged != raw)
+    printf("  the merged library differs\n");
+  for (int s = 0; s < shardCount; ++s)
+    shards[s]->Dispose();
+  merged->Dispose();
+
+  for (int i = 0; i < n; ++i)
+    members[i]->Dispose();
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<int> counts;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      json = fopen(argv[++i], "w");
+      if (json == 0) {
+        printf("Fail to create %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else {
+      counts.push_back(atoi(argv[i]));
+    }
+  }
+  if (counts.empty())
+    counts = {1000, 10000, 100000};
+
+  printf("%-16s %9s %10s %12s %12s %12s\n", "case", "n", "ms", "ns/item",
+         "allocs/item", "bytes/item");
+  EnableAllocCounting(true);
+  for (size_t i = 0; i < counts.size(); ++i)
+    Bench(counts[i]);
+
+  if (json)
+    fclose(json);
+  return 0;
+}
@@ -1,28 +1,71 @@
 #include "LibFactory.h"
 #include "LibInterfaces.h"
 
+#include "../CoffGen/coffHooks.h"
 #include "../CoffGen/coffInterfaces.h"
 #include "../ImpGen/ImpFactory.h"
 #include "../ImpGen/ImpInterfaces.h"
 
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
 using namespace Sora;
 
 bool SaveRawData(LPCTSTR fn, IHasRawData *cb) {
-  HANDLE hFile = CreateFile(fn, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
-  if (hFile != INVALID_HANDLE_VALUE) {
+  std::ofstream f(fn, std::ios::binary);
+  if (f.is_open()) {
     int len = cb->GetDataLength();
-    BYTE *buf = new BYTE[len];
-    cb->GetRawData(buf);
-
-    DWORD olen;
-    WriteFile(hFile, buf, len, &olen, 0);
-    CloseHandle(hFile);
+    std::vector<BYTE> buf(len);
+    cb->GetRawData(buf.data());
 
-    return olen == len;
+    f.write((const char *)buf.data(), len);
+    return !!f;
   }
   return false;
 }
 
+// single-threaded test, no locking needed
+class CTestListener : public IBuildListener {
+public:
+  int phases[BP_COUNT];
+  long long counts[BC_COUNT];
+  int open;
+
+  CTestListener() : open(0) {
+    std::fill(phases, phases + BP_COUNT, 0);
+    std::fill(counts, counts + BC_COUNT, 0LL);
+  }
+  void PhaseBegin(BuildPhase) { ++open; }
+  void PhaseEnd(BuildPhase p) {
+    --open;
+    ++phases[p];
+  }
+  void Count(BuildCounter c, long long n) { counts[c] += n; }
+};
+
+static std::vector<BYTE> RawData(IHasRawData *cb) {
+  std::vector<BYTE> r(cb->GetDataLength());
+  cb->GetRawData(r.data());
+  return r;
+}
+
+// the members of b.dll in library order, add is imported twice
+static std::vector<ICoffBuilder *> MakeMembers(IImpSectionBuilder *isf) {
+  ICoffFactory *cf = isf->GetCoffFactory();
+  std::vector<ICoffBuilder *> r;
+  for (int i = 0; i < 6; ++i)
+    r.push_back(cf->CreateCoffBuilder());
+
+  isf->BuildImportDescriptor("b.dll", r[0]);
+  isf->BuildNullDescriptor(r[1]);
+  isf->BuildImportByNameThunk("b.dll", "__imp__add@8", "_add@8", "add", r[2]);
+  isf->BuildImportByNameThunk("b.dll", "__imp__sub@8", "_sub@8", "sub", r[3]);
+  isf->BuildImportByOrdinalThunk("b.dll", "__imp__add@8", "_add@8", 7, r[4]);
+  isf->BuildNullThunk("b.dll", r[5]);
+  return r;
+}
+
 int main() {
   IImpSectionBuilder *isf = GetX86ImpSectionBuilder();
   ICoffFactory *cf = isf->GetCoffFactory();
@@ -49,6 +92,9 @@ int main() {
   isf->BuildNullDescriptor(nuldesc);
   nuldesc->PushRelocs();
 
+  CTestListener listener;
+  SetBuildListener(&listener);
+
   ILibraryBuilder *lib = CreateLibraryBuilder();
   lib->AddObject("a.dll", desc);
   lib->AddObject("a.dll", nuldesc);
@@ -59,6 +105,49 @@ int main() {
   lib->FillOffsets();
 
   SaveRawData(TEXT("as.lib"), lib);
+  SetBuildListener(0);
+
+  // the library builder reports its phase and counters
+  if (listener.open != 0 || listener.phases[BP_FILLOFFSETS] != 1 ||
+      listener.counts[BC_MEMBERS] != 5 ||
+      listener.counts[BC_BYTES] != lib->GetDataLength())
+    return 1;
+
+  // shards give the library of the members added one by one, a name defined
+  // twice belongs to the first member either way
+  {
+    std::vector<ICoffBuilder *> a = MakeMembers(isf), b = MakeMembers(isf);
+
+    ILibraryBuilder *one = CreateLibraryBuilder();
+    for (size_t i = 0; i < a.size(); ++i)
+      one->AddObject("b.dll", a[i]);
+    one->FillOffsets();
+
+    ILibraryBuilder *merged = CreateLibraryBuilder();
+    ILibraryBuilder *shards[2] = {CreateLibraryBuilder(),
+                                  CreateLibraryBuilder()};
+    merged->AddObject("b.dll", b[0]);
+    merged->AddObject("b.dll", b[1]);
+    shards[0]->AddObject("b.dll", b[2]);
+    shards[0]->AddObject("b.dll", b[3]);
+    shards[1]->AddObject("b.dll", b[4]);
+    shards[1]->AddObject("b.dll", b[5]);
+    shards[1]->BuildIndex();
+    merged->AppendLibraries(shards, 2);
+    merged->FillOffsets();
+
+    bool same = RawData(one) == RawData(merged);
+    for (size_t i = 0; i < a.size(); ++i) {
+      a[i]->Dispose();
+      b[i]->Dispose();
+    }
+    one->Dispose();
+    merged->Dispose();
+    shards[0]->Dispose();
+    shards[1]->Dispose();
+    if (!same)
+      return 1;
+  }
 
   return 0;
 }
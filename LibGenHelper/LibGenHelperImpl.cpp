@@ -7,6 +7,12 @@
 #include "ImpFactory.h"
 #include "ImpInterfaces.h"
 
+#include "WorkPool.h"
+#include "coffHooks.h"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
 #include <string>
 #include <vector>
 
@@ -41,19 +47,149 @@ class CImportLibraryBuilder : public IImportLibraryBuilder {
 
   std::vector<ICoffBuilder *> m_todispose;
 
+  // sharding: the imports are recorded and built by Build
+  enum ImportKind { IK_NAME, IK_ORDINAL, IK_NAME_WITH_HINT };
+  struct Import {
+    ImportKind kind;
+    std::string impName;
+    std::string funcName;
+    bool hasFunc; // no stub without it
+    std::string importName;
+    int ordinal;
+    std::string dllName; // empty: m_dllName
+  };
+  std::vector<Import> m_imports;
+
+  // the other dlls imported from, in the order of their first import
+  std::vector<std::string> m_foreignDlls;
+  CWorkPool *m_pool;
+  int m_shardSize;
+
   ICoffBuilder *CreateObject() {
     ICoffBuilder *r = m_secBuilder->GetCoffFactory()->CreateCoffBuilder();
     m_todispose.push_back(r);
     return r;
   }
 
+  static Import MakeImport(ImportKind kind, LPCSTR szImpName,
+                           LPCSTR szFuncName, LPCSTR szImportName,
+                           int nOrdinal, LPCSTR szDllName = 0) {
+    Import imp;
+    imp.kind = kind;
+    imp.impName = szImpName;
+    imp.hasFunc = szFuncName != 0;
+    if (imp.hasFunc)
+      imp.funcName = szFuncName;
+    if (szImportName != 0)
+      imp.importName = szImportName;
+    imp.ordinal = nOrdinal;
+    if (szDllName != 0)
+      imp.dllName = szDllName;
+    return imp;
+  }
+
+  void Record(ImportKind kind, LPCSTR szImpName, LPCSTR szFuncName,
+              LPCSTR szImportName, int nOrdinal) {
+    m_imports.push_back(
+        MakeImport(kind, szImpName, szFuncName, szImportName, nOrdinal));
+  }
+
+  // the dll of an import and the name of its member
+  LPCSTR GetDllName(const Import &imp) const {
+    return imp.dllName.empty() ? m_dllName.c_str() : imp.dllName.c_str();
+  }
+
+  LPCSTR GetMemberName(const Import &imp) const {
+    return imp.dllName.empty() ? m_memName.c_str() : imp.dllName.c_str();
+  }
+
+  void BuildImport(const Import &imp, ICoffBuilder *member) {
+    LPCSTR func = imp.hasFunc ? imp.funcName.c_str() : 0;
+    LPCSTR dll = GetDllName(imp);
+    switch (imp.kind) {
+    case IK_NAME:
+      m_secBuilder->BuildImportByNameThunk(dll, imp.impName.c_str(), func,
+                                           imp.importName.c_str(), member);
+      break;
+    case IK_ORDINAL:
+      m_secBuilder->BuildImportByOrdinalThunk(dll, imp.impName.c_str(), func,
+                                              imp.ordinal, member);
+      break;
+    case IK_NAME_WITH_HINT:
+      m_secBuilder->BuildImportThunk(dll, imp.impName.c_str(), func,
+                                     imp.importName.c_str(), imp.ordinal,
+                                     member);
+      break;
+    }
+  }
+
+  // case-insensitive, like the loader: kernel32.dll is KERNEL32.DLL
+  static bool SameDll(const std::string &a, LPCSTR b) {
+    size_t i = 0;
+    for (; i < a.size() && b[i]; ++i) {
+      if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+        return false;
+    }
+    return i == a.size() && !b[i];
+  }
+
+  // shard s takes the imports [s * size, (s + 1) * size): its members and
+  // its symbol index are built on the pool, then the shards are appended in
+  // order, so the members stay in call order
+  void BuildShards() {
+    size_t nImports = m_imports.size(), size = m_shardSize;
+    size_t nShards = (nImports + size - 1) / size;
+    std::vector<ILibraryBuilder *> shards(nShards, (ILibraryBuilder *)0);
+    std::vector<std::vector<ICoffBuilder *>> members(nShards);
+    ICoffFactory *factory = m_secBuilder->GetCoffFactory();
+
+    std::exception_ptr error;
+    try {
+      CTaskGroup group(*m_pool);
+      for (size_t s = 0; s < nShards; ++s) {
+        group.Run([this, s, size, nImports, factory, &shards, &members]() {
+          SORA_TRACE_SCOPE_ARG("shard", "shard", (long long)s);
+          SORA_TRACE_COUNTER("pool queue", m_pool->GetQueuedCount());
+          shards[s] = CreateLibraryBuilder();
+          size_t end = std::min(nImports, (s + 1) * size);
+          for (size_t i = s * size; i < end; ++i) {
+            CPhaseScope phase(BP_ADDIMPORT);
+            ICoffBuilder *member = factory->CreateCoffBuilder();
+            members[s].push_back(member);
+            BuildImport(m_imports[i], member);
+            shards[s]->AddObject(GetMemberName(m_imports[i]), member);
+          }
+          shards[s]->BuildIndex();
+        });
+        SORA_TRACE_COUNTER("pool queue", m_pool->GetQueuedCount());
+      }
+      group.Wait();
+
+      m_libBuilder->AppendLibraries(shards.data(), (int)nShards);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    for (size_t s = 0; s < nShards; ++s) {
+      m_todispose.insert(m_todispose.end(), members[s].begin(),
+                         members[s].end());
+      if (shards[s] != 0)
+        shards[s]->Dispose();
+    }
+    m_imports.clear();
+    if (error)
+      std::rethrow_exception(error);
+  }
+
 public:
-  CImportLibraryBuilder(LPCSTR szDllName, LPCSTR szMemName) {
+  CImportLibraryBuilder(LPCSTR szDllName, LPCSTR szMemName)
+      : m_pool(0), m_shardSize(0) {
     m_dllName = szDllName;
     m_memName = szMemName;
     m_libBuilder = CreateLibraryBuilder();
     m_secBuilder = ArchTraits<Arch>::GetImpSectionBuilder();
 
+    CPhaseScope phase(BP_DESCRIPTOR);
     ICoffBuilder *impdesc = CreateObject();
     m_secBuilder->BuildImportDescriptor(szDllName, impdesc);
     m_libBuilder->AddObject(szMemName, impdesc);
@@ -74,6 +210,11 @@ public:
 
   void AddImportFunctionByName(LPCSTR szImpName, LPCSTR szFuncName,
                                LPCSTR szDllExpName) {
+    if (m_pool != 0) {
+      Record(IK_NAME, szImpName, szFuncName, szDllExpName, 0);
+      return;
+    }
+    CPhaseScope phase(BP_ADDIMPORT);
     ICoffBuilder *impMember = CreateObject();
     m_secBuilder->BuildImportByNameThunk(m_dllName.c_str(), szImpName,
                                          szFuncName, szDllExpName, impMember);
@@ -82,6 +223,11 @@ public:
 
   void AddImportFunctionByOrdinal(LPCSTR szImpName, LPCSTR szFuncName,
                                   int nOrdinal) {
+    if (m_pool != 0) {
+      Record(IK_ORDINAL, szImpName, szFuncName, 0, nOrdinal);
+      return;
+    }
+    CPhaseScope phase(BP_ADDIMPORT);
     ICoffBuilder *impMember = CreateObject();
     m_secBuilder->BuildImportByOrdinalThunk(m_dllName.c_str(), szImpName,
                                             szFuncName, nOrdinal, impMember);
@@ -90,21 +236,88 @@ public:
 
   void AddImportFunctionByNameWithHint(LPCSTR szImpName, LPCSTR szFuncName,
                                        LPCSTR szImportName, int nOrdinal) {
+    if (m_pool != 0) {
+      Record(IK_NAME_WITH_HINT, szImpName, szFuncName, szImportName, nOrdinal);
+      return;
+    }
+    CPhaseScope phase(BP_ADDIMPORT);
     ICoffBuilder *impMember = CreateObject();
     m_secBuilder->BuildImportThunk(m_dllName.c_str(), szImpName, szFuncName,
                                    szImportName, nOrdinal, impMember);
     m_libBuilder->AddObject(m_memName.c_str(), impMember);
   }
 
+  void SetSharding(CWorkPool *pool, int nShardSize) {
+    m_pool = nShardSize > 0 ? pool : 0;
+    m_shardSize = nShardSize;
+  }
+
+  void AddImportFunctionFromDll(LPCSTR szDllName, LPCSTR szImpName,
+                                LPCSTR szFuncName, LPCSTR szImportName,
+                                int nOrdinal) {
+    ImportKind kind = szImportName != 0 ? IK_NAME : IK_ORDINAL;
+    if (SameDll(m_dllName, szDllName)) {
+      if (kind == IK_NAME)
+        AddImportFunctionByName(szImpName, szFuncName, szImportName);
+      else
+        AddImportFunctionByOrdinal(szImpName, szFuncName, nOrdinal);
+      return;
+    }
+
+    // one descriptor per dll however its forwarders spell it, named the way
+    // the first one does
+    size_t i = 0;
+    while (i < m_foreignDlls.size() && !SameDll(m_foreignDlls[i], szDllName))
+      ++i;
+    if (i == m_foreignDlls.size())
+      m_foreignDlls.push_back(szDllName);
+    szDllName = m_foreignDlls[i].c_str();
+
+    Import imp = MakeImport(kind, szImpName, szFuncName, szImportName,
+                            nOrdinal, szDllName);
+    if (m_pool != 0) {
+      m_imports.push_back(imp);
+      return;
+    }
+
+    CPhaseScope phase(BP_ADDIMPORT);
+    ICoffBuilder *impMember = CreateObject();
+    BuildImport(imp, impMember);
+    m_libBuilder->AddObject(GetMemberName(imp), impMember);
+  }
+
   void Build() {
-    ICoffBuilder *nullThunk = CreateObject();
-    m_secBuilder->BuildNullThunk(m_dllName.c_str(), nullThunk);
-    m_libBuilder->AddObject(m_memName.c_str(), nullThunk);
+    SORA_TRACE_SCOPE_ARG("import library", "dll", m_dllName);
+    CPhaseScope phase(BP_BUILD);
+    if (!m_imports.empty())
+      BuildShards();
+
+    {
+      CPhaseScope descriptor(BP_DESCRIPTOR);
+      ICoffBuilder *nullThunk = CreateObject();
+      m_secBuilder->BuildNullThunk(m_dllName.c_str(), nullThunk);
+      m_libBuilder->AddObject(m_memName.c_str(), nullThunk);
+
+      // the null import descriptor is shared, the rest each dll has
+      for (size_t i = 0; i < m_foreignDlls.size(); ++i) {
+        LPCSTR dll = m_foreignDlls[i].c_str();
+        ICoffBuilder *impdesc = CreateObject();
+        m_secBuilder->BuildImportDescriptor(dll, impdesc);
+        m_libBuilder->AddObject(dll, impdesc);
+
+        ICoffBuilder *thunk = CreateObject();
+        m_secBuilder->BuildNullThunk(dll, thunk);
+        m_libBuilder->AddObject(dll, thunk);
+      }
+    }
 
     m_libBuilder->FillOffsets();
   }
 
-  void GetRawData(PBYTE buf) { m_libBuilder->GetRawData(buf); }
+  void GetRawData(PBYTE buf) {
+    CPhaseScope phase(BP_RAWDATA);
+    m_libBuilder->GetRawData(buf);
+  }
 
   int GetDataLength() { return m_libBuilder->GetDataLength(); }
 };
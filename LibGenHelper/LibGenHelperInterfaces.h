@@ -4,6 +4,8 @@
 #include "coffInterfaces.h"
 
 namespace Sora {
+class CWorkPool;
+
 class IImportLibraryBuilder : public IHasRawData, public IDispose {
 public:
   // szImpName: __imp__Sleep@8
@@ -22,6 +24,20 @@ public:
                                                LPCSTR szFuncName,
                                                LPCSTR szImportName,
                                                int nOrdinal) = 0;
+
+  // call before adding imports. with a pool, the Add methods only record the
+  // imports; Build makes the members of nShardSize consecutive imports and
+  // their symbol indexes in parallel and merges them in call order, the
+  // library is the same byte for byte. pool 0: build every import as it is
+  // added, the default
+  virtual void SetSharding(CWorkPool *pool, int nShardSize) = 0;
+
+  // import from another dll, the one the export is forwarded to. the library
+  // gets an import descriptor and a null thunk for that dll too, members
+  // named after it. szImportName null: import by nOrdinal
+  virtual void AddImportFunctionFromDll(LPCSTR szDllName, LPCSTR szImpName,
+                                        LPCSTR szFuncName, LPCSTR szImportName,
+                                        int nOrdinal) = 0;
 };
 }; // namespace Sora
 
@@ -0,0 +1,99 @@
+#include "LibGenHelperFactory.h"
+#include "LibGenHelperInterfaces.h"
+
+#include "WorkPool.h"
+
+#include <stdio.h>
+#include <vector>
+
+using namespace Sora;
+
+static int failures = 0;
+
+static void Check(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+// n imports of every kind, with and without stub, some names twice
+static std::vector<BYTE> Build(IImportLibraryBuilder *b, int n,
+                               CWorkPool *pool, int nShardSize) {
+  b->SetSharding(pool, nShardSize);
+
+  char imp[64], func[64], name[64];
+  for (int i = 0; i < n; ++i) {
+    int k = i % 7 == 3 ? i - 3 : i; // imported again under the same names
+    sprintf(imp, "__imp__Func%d@4", k);
+    sprintf(func, "_Func%d@4", k);
+    sprintf(name, "Func%d", k);
+    LPCSTR stub = i % 5 == 0 ? 0 : func;
+
+    if (i % 3 == 0)
+      b->AddImportFunctionByName(imp, stub, name);
+    else if (i % 3 == 1)
+      b->AddImportFunctionByOrdinal(imp, stub, i + 1);
+    else
+      b->AddImportFunctionByNameWithHint(imp, stub, name, i + 1);
+  }
+  b->Build();
+
+  std::vector<BYTE> r(b->GetDataLength());
+  b->GetRawData(r.data());
+  b->Dispose();
+  return r;
+}
+
+// imports forwarded to the dlls, one after the other
+static std::vector<BYTE> BuildForwarded(const std::vector<LPCSTR> &dlls) {
+  IImportLibraryBuilder *b = CreateX64ImpLibBuilder("a.dll", "a.dll");
+  char imp[64], func[64], name[64];
+  for (size_t i = 0; i < dlls.size(); ++i) {
+    sprintf(imp, "__imp_Func%zu", i);
+    sprintf(func, "Func%zu", i);
+    sprintf(name, "Func%zu", i);
+    b->AddImportFunctionFromDll(dlls[i], imp, func, name, 0);
+  }
+  b->Build();
+
+  std::vector<BYTE> r(b->GetDataLength());
+  b->GetRawData(r.data());
+  b->Dispose();
+  return r;
+}
+
+int main() {
+  CWorkPool pool(4);
+  const int n = 1000;
+
+  // sharded builds are the same byte for byte, whatever the shard size
+  std::vector<BYTE> x86 = Build(CreateX86ImpLibBuilder("a.dll", "a.dll"), n,
+                                0, 0);
+  std::vector<BYTE> x64 = Build(CreateX64ImpLibBuilder("a.dll", "a.dll"), n,
+                                0, 0);
+  int sizes[] = {1, 7, 256, n, 2 * n};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    Check(Build(CreateX86ImpLibBuilder("a.dll", "a.dll"), n, &pool,
+                sizes[i]) == x86,
+          "x86 shards");
+    Check(Build(CreateX64ImpLibBuilder("a.dll", "a.dll"), n, &pool,
+                sizes[i]) == x64,
+          "x64 shards");
+  }
+
+  // a shard size of 0 turns sharding off
+  Check(Build(CreateX86ImpLibBuilder("a.dll", "a.dll"), n, &pool, 0) == x86,
+        "no shards");
+
+  // the dll names of forwarders are case-insensitive: one descriptor and
+  // null thunk for NTDLL.dll and ntdll.dll, named like the first forwarder
+  Check(BuildForwarded({"NTDLL.dll", "ntdll.dll", "Ntdll.DLL"}) ==
+            BuildForwarded({"NTDLL.dll", "NTDLL.dll", "NTDLL.dll"}),
+        "forwarder dll case");
+  Check(BuildForwarded({"NTDLL.dll", "ntdll.dll"}) !=
+            BuildForwarded({"NTDLL.dll", "other.dll"}),
+        "forwarder dlls");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+#include "BinaryManifest.h"
+#include "Manifest.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+namespace Sora {
+static const std::string_view ImpPrefix("__imp_");
+
+void ParseBinaryManifest(const BYTE *data, size_t len, CManifest &m,
+                         const char *fileName) {
+  std::string error = std::string(fileName) + ": bad binary manifest";
+
+  BinaryManifestHeader h;
+  if (len < sizeof(h))
+    throw std::runtime_error(error);
+  memcpy(&h, data, sizeof(h));
+
+  if (memcmp(h.magic, BinaryManifestMagic, 4) != 0 ||
+      h.version != BinaryManifestVersion || (h.arch != 32 && h.arch != 64))
+    throw std::runtime_error(error);
+
+  // the pool must end with a NUL, then every offset into it is a string
+  const char *pool = (const char *)data + h.stringsOffset;
+  uint32_t poolSize = h.stringsSize;
+  if (h.symbolsOffset % 4 != 0 ||
+      h.symbolsOffset + (uint64_t)h.symbolCount * sizeof(BinarySymbol) > len ||
+      poolSize == 0 || h.stringsOffset + (uint64_t)poolSize > len ||
+      pool[poolSize - 1] != 0 || h.dllName >= poolSize)
+    throw std::runtime_error(error);
+
+  m.dllName = pool + h.dllName;
+  m.arch = h.arch;
+
+  const BinarySymbol *s = (const BinarySymbol *)(data + h.symbolsOffset);
+  const BinarySymbol *send = s + h.symbolCount;
+
+  size_t first = m.symbols.size();
+  m.symbols.resize(first + h.symbolCount);
+  ExportSymbol *e = &m.symbols[first];
+
+  for (; s != send; ++s, ++e) {
+    if (s->pubname >= poolSize || s->thunk >= poolSize ||
+        s->name >= poolSize || s->cconv >= poolSize || s->forward >= poolSize)
+      throw std::runtime_error(error);
+
+    e->pubname = pool + s->pubname;
+    if (s->flags & BSF_THUNK_IN_PUBNAME) {
+      if (e->pubname.size() < ImpPrefix.size())
+        throw std::runtime_error(error);
+      e->thunk = e->pubname.substr(ImpPrefix.size());
+    } else {
+      e->thunk = pool + s->thunk;
+    }
+    e->name = s->flags & BSF_NAME_IS_THUNK ? e->thunk
+                                           : std::string_view(pool + s->name);
+    e->cconv = pool + s->cconv;
+    e->forward = pool + s->forward;
+    if (s->flags & BSF_TARGET_AFTER_FORWARD) {
+      uint32_t target = s->forward + (uint32_t)e->forward.size() + 1;
+      if (s->forward == 0 || target >= poolSize)
+        throw std::runtime_error(error);
+      e->target = pool + target;
+    }
+    e->ord = s->ord;
+    e->argBytes = s->argBytes;
+    e->flags = s->flags & (ESF_DERIVED | ESF_NONAME | ESF_DATA);
+  }
+
+  // the derived names follow the decoration rules, not the file
+  DecorateSymbols(m);
+}
+
+void LoadBinaryManifest(const char *path, CManifest &m) {
+  std::shared_ptr<CMappedFile> file = std::make_shared<CMappedFile>();
+  if (!file->Open(path))
+    throw std::runtime_error(std::string("Fail to open input file ") + path);
+
+  // the strings point into the mapped pool
+  m.Hold(file);
+  ParseBinaryManifest(file->GetData(), file->GetSize(), m, path);
+}
+
+namespace {
+class CStringPool {
+public:
+  explicit CStringPool(std::vector<BYTE> &out) : m_out(out), m_base(0) {}
+
+  void Begin() {
+    m_base = m_out.size();
+    m_out.push_back(0); // ""
+  }
+
+  uint32_t Add(std::string_view s) {
+    if (s.empty())
+      return 0;
+
+    size_t off = m_out.size() - m_base;
+    if (off + s.size() + 1 > UINT32_MAX)
+      throw std::runtime_error("binary manifest: string pool over 4 GB");
+    m_out.insert(m_out.end(), s.begin(), s.end());
+    m_out.push_back(0);
+    return (uint32_t)off;
+  }
+
+  // for the few strings repeated by every symbol
+  uint32_t AddShared(std::string_view s) {
+    std::map<std::string_view, uint32_t>::iterator i = m_shared.find(s);
+    if (i != m_shared.end())
+      return i->second;
+    uint32_t off = Add(s);
+    m_shared[s] = off;
+    return off;
+  }
+
+  size_t Size() const { return m_out.size() - m_base; }
+
+private:
+  std::vector<BYTE> &m_out;
+  size_t m_base;
+  std::map<std::string_view, uint32_t> m_shared;
+};
+} // namespace
+
+void WriteBinaryManifest(const CManifest &m, std::vector<BYTE> &out) {
+  BinaryManifestHeader h;
+  memcpy(h.magic, BinaryManifestMagic, 4);
+  h.version = BinaryManifestVersion;
+  h.arch = m.arch;
+  h.symbolCount = (uint32_t)m.symbols.size();
+  h.symbolsOffset = sizeof(h);
+  h.stringsOffset =
+      (uint32_t)(h.symbolsOffset + m.symbols.size() * sizeof(BinarySymbol));
+
+  out.clear();
+  out.resize(h.stringsOffset);
+
+  CStringPool pool(out);
+  pool.Begin();
+  h.dllName = pool.Add(m.dllName);
+
+  for (size_t i = 0; i < m.symbols.size(); ++i) {
+    const ExportSymbol &e = m.symbols[i];
+    BinarySymbol s;
+    memset(&s, 0, sizeof(s));
+
+    // __imp_thunk is stored once, thunk and usually name point into it
+    s.pubname = pool.Add(e.pubname);
+    if (!e.thunk.empty() && e.pubname.size() > ImpPrefix.size() &&
+        e.pubname.compare(0, ImpPrefix.size(), ImpPrefix) == 0 &&
+        e.pubname.substr(ImpPrefix.size()) == e.thunk)
+      s.flags |= BSF_THUNK_IN_PUBNAME;
+    else
+      s.thunk = pool.Add(e.thunk);
+
+    if (!e.name.empty() && e.name == e.thunk)
+      s.flags |= BSF_NAME_IS_THUNK;
+    else
+      s.name = pool.Add(e.name);
+
+    s.cconv = pool.AddShared(e.cconv);
+    s.forward = pool.Add(e.forward);
+    if (s.forward != 0 && !e.target.empty()) {
+      pool.Add(e.target);
+      s.flags |= BSF_TARGET_AFTER_FORWARD;
+    }
+    s.ord = e.ord;
+    s.argBytes = (int16_t)e.argBytes;
+    s.flags |= e.flags & (ESF_DERIVED | ESF_NONAME | ESF_DATA);
+
+    // the pool grows behind the records, out moves
+    memcpy(&out[h.symbolsOffset + i * sizeof(s)], &s, sizeof(s));
+  }
+
+  h.stringsSize = (uint32_t)pool.Size();
+  memcpy(&out[0], &h, sizeof(h));
+}
+}; // namespace Sora
@@ -0,0 +1,73 @@
+#ifndef BINARYMANIFEST_H
+#define BINARYMANIFEST_H
+
+#include <cstdint>
+
+// binary manifest, a memory-mappable form of CManifest:
+//
+//   header
+//   symbolCount records, at symbolsOffset
+//   string pool of NUL-terminated strings, at stringsOffset
+//
+// everything is little-endian. strings are byte offsets into the pool, the
+// pool starts with an empty string so 0 is "". the last byte of the pool is
+// a NUL, any offset inside it is a valid string.
+
+namespace Sora {
+static const char BinaryManifestMagic[4] = {'S', 'B', 'M', 'F'};
+static const uint32_t BinaryManifestVersion = 1;
+
+struct BinaryManifestHeader {
+  char magic[4]; // BinaryManifestMagic
+  uint32_t version;
+  uint32_t arch; // 32 or 64
+  uint32_t dllName;
+  uint32_t symbolCount;
+  uint32_t symbolsOffset; // file offset, 4-aligned
+  uint32_t stringsOffset; // file offset
+  uint32_t stringsSize;
+};
+
+enum BinarySymbolFlags {
+  BSF_DERIVED = 1, // ESF_DERIVED, thunk and pubname decorated for arch
+  BSF_NONAME = 2, // ESF_NONAME
+  BSF_DATA = 4,   // ESF_DATA
+  // thunk is pubname without its __imp_ prefix, the thunk field is unused
+  BSF_THUNK_IN_PUBNAME = 0x100,
+  // name is the same as thunk, the name field is unused
+  BSF_NAME_IS_THUNK = 0x200,
+  // the target follows the forward string in the pool
+  BSF_TARGET_AFTER_FORWARD = 0x400
+};
+
+struct BinarySymbol {
+  uint32_t pubname;
+  uint32_t thunk;
+  uint32_t name;
+  uint32_t cconv;
+  uint32_t forward;
+  int32_t ord;
+  int16_t argBytes;
+  uint16_t flags; // BinarySymbolFlags
+};
+
+// a stream of binary manifests, dumpsyms /STREAM /BINARY to mkimplib
+// --stream: frames of this header, the path of the dll (no NUL) and the
+// binary manifest, each padded with zeros to 4 bytes so every manifest is
+// 4-aligned in the stream
+static const char BinaryStreamMagic[4] = {'S', 'B', 'M', 'S'};
+
+struct BinaryStreamFrame {
+  char magic[4];         // BinaryStreamMagic
+  uint32_t fileSize;     // the path, relative to the directory dumped
+  uint32_t manifestSize; // the binary manifest
+};
+
+inline uint32_t BinaryStreamPadding(uint32_t size) { return (4 - size % 4) % 4; }
+
+static_assert(sizeof(BinaryManifestHeader) == 32, "packed header");
+static_assert(sizeof(BinarySymbol) == 28, "packed record");
+static_assert(sizeof(BinaryStreamFrame) == 12, "packed frame");
+}; // namespace Sora
+
+#endif
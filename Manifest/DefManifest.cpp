@@ -0,0 +1,271 @@
+#include "Manifest.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace Sora {
+namespace {
+struct DefToken {
+  char *str;
+  int len;
+  int equals; // 1 for "=", 2 for "==", 0 for a word
+};
+
+// the text is modified in place: every token used by the manifest gets
+// NUL-terminated where it ends, so the symbols can point into the text.
+class CDefParser {
+  CManifest &m_manifest;
+  const char *m_fileName;
+  int m_line;
+  bool m_inExports;
+  std::vector<DefToken> m_tokens;
+
+  [[noreturn]] void Fail(const std::string &msg) {
+    throw std::runtime_error(std::string(m_fileName) + ":" +
+                             std::to_string(m_line) + ": " + msg);
+  }
+
+  static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+  }
+
+  static bool IsDigits(const char *p, int len) {
+    if (len <= 0)
+      return false;
+    for (int i = 0; i < len; ++i) {
+      if (p[i] < '0' || p[i] > '9')
+        return false;
+    }
+    return true;
+  }
+
+  static int ToInt(const char *p, int len) {
+    int r = 0;
+    for (int i = 0; i < len; ++i)
+      r = r * 10 + (p[i] - '0');
+    return r;
+  }
+
+  static bool Is(const DefToken &t, const char *keyword) {
+    return t.equals == 0 && (int)strlen(keyword) == t.len &&
+           memcmp(t.str, keyword, t.len) == 0;
+  }
+
+  static std::string_view Terminate(const DefToken &t) {
+    t.str[t.len] = 0;
+    return std::string_view(t.str, t.len);
+  }
+
+  // split [p, end) into tokens, stops at a comment
+  void Tokenize(char *p, char *end) {
+    m_tokens.clear();
+    while (p < end) {
+      if (IsSpace(*p)) {
+        ++p;
+        continue;
+      }
+      if (*p == ';')
+        break;
+
+      DefToken t;
+      if (*p == '=') {
+        t.str = p;
+        t.equals = (p + 1 < end && p[1] == '=') ? 2 : 1;
+        t.len = t.equals;
+      } else if (*p == '"') {
+        char *close = (char *)memchr(p + 1, '"', end - p - 1);
+        if (close == 0)
+          Fail("missing closing quote");
+        t.str = p + 1;
+        t.len = close - p - 1;
+        t.equals = 0;
+        p = close + 1;
+        m_tokens.push_back(t);
+        continue;
+      } else {
+        char *q = p;
+        while (q < end && !IsSpace(*q) && *q != '=' && *q != ';' && *q != '"')
+          ++q;
+        t.str = p;
+        t.len = q - p;
+        t.equals = 0;
+      }
+
+      p += t.len;
+      m_tokens.push_back(t);
+    }
+  }
+
+  void ParseLibrary(size_t first, const char *ext) {
+    if (first >= m_tokens.size() || m_tokens[first].equals)
+      return; // name is optional
+
+    std::string_view name = Terminate(m_tokens[first]);
+    if (name.find('.') == std::string_view::npos)
+      m_manifest.dllName = m_manifest.Store(name, ext);
+    else
+      m_manifest.dllName = name;
+  }
+
+  // split the decoration off an entry name: Sleep@4, @Fast@8, Vec@@16
+  static void Undecorate(std::string_view entry, ExportSymbol &e) {
+    e.cconv = "CDECL";
+    e.argBytes = -1;
+    e.name = entry;
+
+    if (entry.empty() || entry[0] == '?') {
+      e.cconv = std::string_view();
+      return;
+    }
+
+    size_t at = entry.rfind('@');
+    if (at == std::string_view::npos || at == 0 ||
+        !IsDigits(entry.data() + at + 1, entry.size() - at - 1))
+      return;
+
+    e.argBytes = ToInt(entry.data() + at + 1, entry.size() - at - 1);
+    if (entry[0] == '@') {
+      e.cconv = "FASTCALL";
+      e.name = entry.substr(1, at - 1);
+    } else if (entry[at - 1] == '@') {
+      e.cconv = "VECTORCALL";
+      e.name = entry.substr(0, at - 1);
+    } else {
+      e.cconv = "STDCALL";
+      e.name = entry.substr(0, at);
+    }
+
+    // the decoration is rebuilt for the target, the name is cut in place
+    const_cast<char *>(e.name.data())[e.name.size()] = 0;
+  }
+
+  void ParseExport(size_t i) {
+    ExportSymbol e;
+    e.ord = 0;
+    e.flags = ESF_DERIVED;
+
+    if (m_tokens[i].equals)
+      Fail("export name expected");
+    DefToken entry = m_tokens[i++];
+
+    // entryname=internalname: the internal name only matters to the dll
+    if (i < m_tokens.size() && m_tokens[i].equals) {
+      if (++i >= m_tokens.size() || m_tokens[i].equals)
+        Fail("internal name expected after '='");
+      ++i;
+    }
+
+    bool isPrivate = false;
+    for (; i < m_tokens.size(); ++i) {
+      const DefToken &t = m_tokens[i];
+      if (t.equals == 0 && t.str[0] == '@') {
+        // @ord or @ ord
+        const char *num = t.str + 1;
+        int numLen = t.len - 1;
+        if (numLen == 0 && i + 1 < m_tokens.size()) {
+          ++i;
+          num = m_tokens[i].str;
+          numLen = m_tokens[i].len;
+        }
+        // the import object stores a WORD
+        if (!IsDigits(num, numLen) || numLen > 5)
+          Fail("bad ordinal");
+        e.ord = ToInt(num, numLen);
+        if (e.ord < 1 || e.ord > 0xFFFF)
+          Fail("bad ordinal");
+      } else if (Is(t, "NONAME")) {
+        e.flags |= ESF_NONAME;
+      } else if (Is(t, "DATA") || Is(t, "CONSTANT")) {
+        e.flags |= ESF_DATA;
+      } else if (Is(t, "PRIVATE")) {
+        isPrivate = true;
+      } else {
+        Fail("unexpected '" + std::string(t.str, t.len) + "'");
+      }
+    }
+
+    if ((e.flags & ESF_NONAME) && e.ord == 0)
+      Fail("NONAME without ordinal");
+
+    // private exports are left out of the import library
+    if (isPrivate)
+      return;
+
+    Undecorate(Terminate(entry), e);
+    m_manifest.symbols.push_back(e);
+  }
+
+public:
+  CDefParser(CManifest &m, const char *fileName)
+      : m_manifest(m), m_fileName(fileName), m_line(0), m_inExports(false) {}
+
+  void Parse(char *text, size_t len) {
+    char *p = text, *end = text + len;
+
+    // utf-8 bom
+    if (len >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+      p += 3;
+
+    while (p < end) {
+      ++m_line;
+      char *eol = (char *)memchr(p, '\n', end - p);
+      if (eol == 0)
+        eol = end;
+
+      Tokenize(p, eol);
+      p = eol + 1;
+
+      if (m_tokens.empty())
+        continue;
+
+      const DefToken &t = m_tokens[0];
+      if (Is(t, "LIBRARY")) {
+        m_inExports = false;
+        ParseLibrary(1, ".dll");
+      } else if (Is(t, "NAME")) {
+        m_inExports = false;
+        ParseLibrary(1, ".exe");
+      } else if (Is(t, "EXPORTS")) {
+        m_inExports = true;
+        if (m_tokens.size() > 1)
+          ParseExport(1);
+      } else if (Is(t, "DESCRIPTION") || Is(t, "HEAPSIZE") ||
+                 Is(t, "STACKSIZE") || Is(t, "SECTIONS") || Is(t, "STUB") ||
+                 Is(t, "VERSION") || Is(t, "IMPORTS")) {
+        m_inExports = false;
+      } else if (m_inExports) {
+        ParseExport(0);
+      }
+      // lines of other sections are ignored
+    }
+  }
+};
+} // namespace
+
+void ParseDefManifest(char *text, size_t len, int arch, CManifest &m,
+                      const char *fileName) {
+  m.arch = arch;
+
+  CDefParser parser(m, fileName);
+  parser.Parse(text, len);
+
+  if (m.dllName.empty()) {
+    // no LIBRARY statement: named after the .def file
+    std::string_view base(fileName);
+    size_t slash = base.find_last_of("/\\");
+    if (slash != std::string_view::npos)
+      base = base.substr(slash + 1);
+    base = base.substr(0, base.rfind('.'));
+    m.dllName = m.Store(base, ".dll");
+  }
+
+  DecorateSymbols(m);
+}
+
+void LoadDefManifest(const char *path, int arch, CManifest &m) {
+  size_t len;
+  char *text = ReadWholeFile(path, m, &len);
+  ParseDefManifest(text, len, arch, m, path);
+}
+}; // namespace Sora
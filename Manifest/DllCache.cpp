@@ -0,0 +1,118 @@
+#include "DllCache.h"
+#include "MappedFile.h"
+#include "Sha256.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace Sora {
+// bump when the manifests parsed from the same dll change
+static const char *CacheFormat = "dumpsyms-cache 1";
+
+// the dll name LoadDllManifest gives, the entry may come from a copy
+static std::string FileName(const std::string &path) {
+  size_t slash = path.find_last_of("/\\:");
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// unique among the threads and, very likely, the processes writing next to
+// each other
+static std::string TempPath(const std::string &path) {
+  static std::atomic<unsigned> counter(0);
+  size_t id =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+      (size_t)std::chrono::steady_clock::now().time_since_epoch().count();
+  return path + ".tmp" + std::to_string(id) + "." + std::to_string(++counter);
+}
+
+CDllCache::CDllCache(const std::string &dir, bool hashContent)
+    : m_dir(dir), m_hashContent(hashContent), m_hits(0), m_misses(0) {}
+
+std::string CDllCache::EntryPath(const std::string &key) const {
+  return (fs::path(m_dir) / key.substr(0, 2) / (key + ".bmf")).string();
+}
+
+void CDllCache::Load(const std::string &path, const PeHeader &h,
+                     CManifest &m) {
+  // the content is hashed from the mapping a miss parses
+  std::shared_ptr<CMappedFile> file;
+  uint64_t size;
+  if (m_hashContent) {
+    file = std::make_shared<CMappedFile>();
+    if (!file->Open(path.c_str()))
+      throw std::runtime_error("Fail to open input file " + path);
+    size = file->GetSize();
+  } else {
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    if (ec)
+      throw std::runtime_error("Fail to open input file " + path);
+  }
+
+  char fields[128];
+  snprintf(fields, sizeof(fields), "%u %u %u %u %u %u %llu",
+           (unsigned)h.machine, (unsigned)h.timeDateStamp,
+           (unsigned)h.checkSum, (unsigned)h.sizeOfImage,
+           (unsigned)h.exportRva, (unsigned)h.exportSize,
+           (unsigned long long)size);
+  CSha256 hash;
+  hash.Update(CacheFormat, strlen(CacheFormat) + 1);
+  hash.Update(fields, strlen(fields) + 1);
+  if (file)
+    hash.Update(file->GetData(), file->GetSize());
+  std::string key = hash.HexDigest();
+
+  try {
+    CManifest cached;
+    LoadBinaryManifest(EntryPath(key).c_str(), cached);
+    cached.dllName = cached.Store(FileName(path));
+    m = std::move(cached);
+    ++m_hits;
+    return;
+  } catch (std::exception &) {
+    // missing or bad, parsed again
+  }
+
+  ++m_misses;
+  if (file) {
+    m.Hold(file);
+    ParseDllManifest(file->GetData(), file->GetSize(), m, path.c_str());
+  } else {
+    LoadDllManifest(path.c_str(), m);
+  }
+  Store(key, m);
+}
+
+void CDllCache::Store(const std::string &key, const CManifest &m) {
+  std::vector<BYTE> data;
+  WriteBinaryManifest(m, data);
+
+  std::string entry = EntryPath(key);
+  std::string tmp = TempPath(entry);
+  std::error_code ec;
+  fs::create_directories(fs::path(entry).parent_path(), ec);
+  {
+    std::ofstream f(tmp, std::ios::binary);
+    f.write((const char *)data.data(), data.size());
+    f.close();
+    if (!f) {
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  fs::rename(tmp, entry, ec);
+  if (ec)
+    fs::remove(tmp, ec);
+}
+}; // namespace Sora
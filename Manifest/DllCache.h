@@ -0,0 +1,50 @@
+#ifndef DLLCACHE_H
+#define DLLCACHE_H
+
+#include "Manifest.h"
+
+#include <atomic>
+#include <string>
+
+namespace Sora {
+// persistent store of the exports of PE images, so that a dll that didn't
+// change since the last run isn't parsed again. an entry is the binary
+// manifest of the dll:
+// <dir>/<first two hex digits of the key>/<key>.bmf
+//
+// the key is the hash of the machine, TimeDateStamp, CheckSum, SizeOfImage
+// and export directory of the headers and of the file size, a lookup reads
+// the headers only. dlls with the same stamp, checksum and sizes (a
+// reproducible build that fixes the stamp, images without a stamp) aren't
+// told apart: with hashContent the whole file is hashed into the key as well.
+//
+// several threads and processes may share the directory: entries are
+// written to a temporary file and renamed into place. the cache is best
+// effort, a bad entry is a miss, failures to store are ignored.
+class CDllCache {
+public:
+  CDllCache(const std::string &dir, bool hashContent);
+  CDllCache(const CDllCache &) = delete;
+  CDllCache &operator=(const CDllCache &) = delete;
+
+  // the exports of the dll at path, h its headers as ReadPeHeader read them:
+  // from the cache on a hit, parsed and stored on a miss. the dll name is
+  // the file name, like LoadDllManifest.
+  // throws like LoadDllManifest if the dll can't be parsed
+  void Load(const std::string &path, const PeHeader &h, CManifest &m);
+
+  size_t GetHits() const { return m_hits; }
+  size_t GetMisses() const { return m_misses; }
+
+private:
+  std::string m_dir;
+  bool m_hashContent;
+  std::atomic<size_t> m_hits;
+  std::atomic<size_t> m_misses;
+
+  std::string EntryPath(const std::string &key) const;
+  void Store(const std::string &key, const CManifest &m);
+};
+}; // namespace Sora
+
+#endif
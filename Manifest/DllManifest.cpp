@@ -0,0 +1,283 @@
+#include "Manifest.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace Sora {
+namespace {
+// the image is little-endian and the fields aren't necessarily aligned
+inline WORD Read16(const BYTE *p) {
+  WORD r;
+  memcpy(&r, p, sizeof(r));
+  return r;
+}
+
+inline DWORD Read32(const BYTE *p) {
+  DWORD r;
+  memcpy(&r, p, sizeof(r));
+  return r;
+}
+
+// the architecture of the machines CoffGen writes import libraries for, 0
+// for the others: a PE32+ image may as well be ARM64
+inline int MachineArch(WORD machine) {
+  switch (machine) {
+  case 0x14C: // i386
+    return 32;
+  case 0x8664: // amd64
+    return 64;
+  }
+  return 0;
+}
+
+struct Section {
+  DWORD va;
+  DWORD size;
+  DWORD offset;
+
+  bool operator<(const Section &rhs) const { return va < rhs.va; }
+};
+
+class CPeImage {
+public:
+  CPeImage(const BYTE *image, size_t len, const char *fileName)
+      : m_image(image), m_len(len), m_fileName(fileName) {}
+
+  void Parse(CManifest &m);
+
+private:
+  const BYTE *m_image;
+  size_t m_len;
+  const char *m_fileName;
+  std::vector<Section> m_sections; // sorted by va
+
+  [[noreturn]] void Fail(const char *msg) const {
+    throw std::runtime_error(std::string(m_fileName) + ": " + msg);
+  }
+
+  // the file data of count bytes at rva, 0 if they aren't in the file
+  const BYTE *Translate(DWORD rva, size_t count) const;
+
+  // the NUL-terminated string at rva
+  std::string_view String(DWORD rva) const;
+};
+
+const BYTE *CPeImage::Translate(DWORD rva, size_t count) const {
+  std::vector<Section>::const_iterator i = std::upper_bound(
+      m_sections.begin(), m_sections.end(), Section{rva, 0, 0});
+  if (i == m_sections.begin())
+    return 0;
+  --i;
+
+  size_t delta = rva - i->va;
+  if (delta + count > i->size)
+    return 0;
+
+  size_t offset = i->offset + delta;
+  if (offset + count > m_len)
+    return 0;
+  return m_image + offset;
+}
+
+std::string_view CPeImage::String(DWORD rva) const {
+  const BYTE *p = Translate(rva, 1);
+  if (p == 0)
+    Fail("Unreadable or invalid PE image");
+
+  const void *end = memchr(p, 0, m_image + m_len - p);
+  if (end == 0)
+    Fail("Unreadable or invalid PE image");
+  return std::string_view((const char *)p, (const BYTE *)end - p);
+}
+
+void CPeImage::Parse(CManifest &m) {
+  if (m_len < 0x40 || Read16(m_image) != 0x5A4D) // MZ
+    Fail("Unreadable or invalid PE image");
+
+  // COFF file header, then the optional header
+  size_t pe = Read32(m_image + 0x3C);
+  if (pe + 24 > m_len || Read32(m_image + pe) != 0x4550) // PE\0\0
+    Fail("Unreadable or invalid PE image");
+
+  WORD machine = Read16(m_image + pe + 4);
+  WORD numSections = Read16(m_image + pe + 6);
+  WORD optSize = Read16(m_image + pe + 20);
+  size_t opt = pe + 24;
+  if (opt + optSize > m_len || optSize < 2)
+    Fail("Unreadable or invalid PE image");
+
+  WORD magic = Read16(m_image + opt);
+  if (magic != 0x10B && magic != 0x20B)
+    Fail("Unreadable or invalid PE image");
+  bool pe32plus = magic == 0x20B;
+
+  m.arch = MachineArch(machine);
+  if (m.arch == 0) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "Unsupported machine 0x%x, not i386 or amd64",
+             (unsigned)machine);
+    Fail(msg);
+  }
+
+  // the export table is the first data directory
+  size_t dirs = pe32plus ? 112 : 96;
+  if (optSize < dirs + 8 || Read32(m_image + opt + dirs - 4) == 0)
+    Fail("No export found");
+  DWORD exportRva = Read32(m_image + opt + dirs);
+  DWORD exportSize = Read32(m_image + opt + dirs + 4);
+  if (exportRva == 0 || exportSize == 0)
+    Fail("No export found");
+
+  // sorted once, every RVA is then a binary search
+  size_t sec = opt + optSize;
+  if (sec + (size_t)numSections * 40 > m_len)
+    Fail("Unreadable or invalid PE image");
+
+  m_sections.reserve(numSections);
+  for (WORD i = 0; i < numSections; ++i) {
+    const BYTE *s = m_image + sec + i * 40;
+    Section section;
+    section.va = Read32(s + 12);
+    section.size = std::max(Read32(s + 8), Read32(s + 16));
+    section.offset = Read32(s + 20);
+    m_sections.push_back(section);
+  }
+  std::sort(m_sections.begin(), m_sections.end());
+
+  const BYTE *dir = Translate(exportRva, 40);
+  if (dir == 0)
+    Fail("Unreadable or invalid PE image");
+
+  DWORD base = Read32(dir + 16);
+  DWORD numFunctions = Read32(dir + 20);
+  DWORD numNames = Read32(dir + 24);
+  if (numFunctions == 0 || numNames == 0)
+    Fail("No export found");
+
+  // the three tables are arrays, each is checked once and walked in bulk
+  const BYTE *functions =
+      Translate(Read32(dir + 28), (size_t)numFunctions * 4);
+  const BYTE *names = Translate(Read32(dir + 32), (size_t)numNames * 4);
+  const BYTE *ordinals = Translate(Read32(dir + 36), (size_t)numNames * 2);
+  if (functions == 0 || names == 0 || ordinals == 0)
+    Fail("Unreadable or invalid PE image");
+
+  if (m.dllName.empty()) {
+    if (*m_fileName) {
+      const char *file = m_fileName;
+      for (const char *p = m_fileName; *p; ++p) {
+        if (*p == '/' || *p == '\\' || *p == ':')
+          file = p + 1;
+      }
+      m.dllName = m.Store(file);
+    } else {
+      m.dllName = String(Read32(dir + 12));
+    }
+  }
+
+  // named exports only, like dumpsyms
+  m.symbols.reserve(m.symbols.size() + numNames);
+  for (DWORD i = 0; i < numNames; ++i) {
+    WORD index = Read16(ordinals + i * 2);
+    if (index >= numFunctions)
+      Fail("Unreadable or invalid PE image");
+
+    ExportSymbol e;
+    e.cconv = "STDCALL";
+    e.name = String(Read32(names + i * 4));
+    e.thunk = e.name;
+    e.pubname = m.Store("__imp_", e.name);
+    e.ord = base + index;
+    e.argBytes = -1;
+    e.flags = 0;
+
+    // an address inside the export table is the "DLL.Name" it forwards to
+    DWORD rva = Read32(functions + index * 4);
+    if (rva - exportRva < exportSize)
+      e.forward = String(rva);
+
+    m.symbols.push_back(e);
+  }
+}
+} // namespace
+
+void ParseDllManifest(const BYTE *image, size_t len, CManifest &m,
+                      const char *fileName) {
+  CPeImage(image, len, fileName).Parse(m);
+}
+
+bool ParsePeHeader(const BYTE *data, size_t len, PeHeader &h) {
+  if (len < 0x40 || Read16(data) != 0x5A4D) // MZ
+    return false;
+
+  size_t pe = Read32(data + 0x3C);
+  if (pe + 24 > len || Read32(data + pe) != 0x4550) // PE\0\0
+    return false;
+
+  WORD optSize = Read16(data + pe + 20);
+  size_t opt = pe + 24;
+  if (opt + optSize > len || optSize < 68)
+    return false;
+
+  WORD magic = Read16(data + opt);
+  if (magic != 0x10B && magic != 0x20B)
+    return false;
+  bool pe32plus = magic == 0x20B;
+
+  h.machine = Read16(data + pe + 4);
+  h.timeDateStamp = Read32(data + pe + 8);
+  h.sizeOfImage = Read32(data + opt + 56);
+  h.checkSum = Read32(data + opt + 64);
+  h.arch = MachineArch(h.machine);
+
+  size_t dirs = pe32plus ? 112 : 96;
+  if (optSize >= dirs + 8 && Read32(data + opt + dirs - 4) != 0) {
+    h.exportRva = Read32(data + opt + dirs);
+    h.exportSize = Read32(data + opt + dirs + 4);
+  } else {
+    h.exportRva = 0;
+    h.exportSize = 0;
+  }
+  if (h.exportRva == 0)
+    h.exportSize = 0;
+  return true;
+}
+
+bool ReadPeHeader(const char *path, PeHeader &h) {
+  FILE *f = fopen(path, "rb");
+  if (f == 0)
+    return false;
+
+  BYTE buf[PeHeaderReadSize];
+  size_t got = fread(buf, 1, sizeof(buf), f);
+  bool ok = ParsePeHeader(buf, got, h);
+
+  // a long DOS stub: the PE headers are read at their offset, with a copy of
+  // the DOS header in front so the offsets stay the same
+  if (!ok && got == sizeof(buf) && Read16(buf) == 0x5A4D) {
+    DWORD pe = Read32(buf + 0x3C);
+    if (pe >= 0x40 && fseek(f, pe, SEEK_SET) == 0) {
+      size_t more = fread(buf + 0x40, 1, sizeof(buf) - 0x40, f);
+      DWORD shifted = 0x40;
+      memcpy(buf + 0x3C, &shifted, 4);
+      ok = ParsePeHeader(buf, 0x40 + more, h);
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+void LoadDllManifest(const char *path, CManifest &m) {
+  std::shared_ptr<CMappedFile> file = std::make_shared<CMappedFile>();
+  if (!file->Open(path))
+    throw std::runtime_error(std::string("Fail to open input file ") + path);
+
+  // the names point into the mapped image
+  m.Hold(file);
+  ParseDllManifest(file->GetData(), file->GetSize(), m, path);
+}
+}; // namespace Sora
@@ -0,0 +1,184 @@
+#include "ExportCache.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace Sora {
+// longer chains don't occur, the loader gives up much earlier
+static const int MaxHops = 32;
+
+struct CExportCache::Entry {
+  std::once_flag once;
+  bool ok;
+  CManifest m;
+  std::unordered_map<std::string_view, const ExportSymbol *> byName;
+  std::unordered_map<int, const ExportSymbol *> byOrdinal;
+};
+
+// the dll names of a directory in lowercase, listed once
+struct CExportCache::Directory {
+  std::once_flag once;
+  std::unordered_map<std::string, std::string> files;
+};
+
+static std::string Lower(std::string_view s) {
+  std::string r(s);
+  for (size_t i = 0; i < r.size(); ++i)
+    r[i] = (char)tolower((unsigned char)r[i]);
+  return r;
+}
+
+CExportCache::CExportCache(const std::vector<std::string> &dirs,
+                           CDllCache *store)
+    : m_dirs(dirs), m_store(store), m_parsed(0) {}
+
+std::shared_ptr<CExportCache::Entry>
+CExportCache::GetEntry(const std::string &path) {
+  std::error_code ec;
+  std::string key = fs::absolute(path, ec).lexically_normal().string();
+
+  std::shared_ptr<Entry> entry;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::shared_ptr<Entry> &slot = m_entries[key];
+    if (!slot)
+      slot = std::make_shared<Entry>();
+    entry = slot;
+  }
+
+  // parsed outside the lock, other dlls are parsed meanwhile
+  std::call_once(entry->once, [&]() {
+    entry->ok = false;
+    PeHeader h;
+    if (!ReadPeHeader(path.c_str(), h) || h.exportSize == 0)
+      return;
+    try {
+      if (m_store != 0)
+        m_store->Load(path, h, entry->m);
+      else
+        LoadDllManifest(path.c_str(), entry->m);
+    } catch (std::exception &) {
+      return;
+    }
+    ++m_parsed;
+
+    const std::vector<ExportSymbol> &symbols = entry->m.symbols;
+    entry->byName.reserve(symbols.size());
+    entry->byOrdinal.reserve(symbols.size());
+    for (size_t i = 0; i < symbols.size(); ++i) {
+      entry->byName.emplace(symbols[i].name, &symbols[i]);
+      entry->byOrdinal.emplace(symbols[i].ord, &symbols[i]);
+    }
+    entry->ok = true;
+  });
+  return entry;
+}
+
+const CManifest *CExportCache::Load(const std::string &path) {
+  std::shared_ptr<Entry> entry = GetEntry(path);
+  return entry->ok ? &entry->m : 0;
+}
+
+std::string CExportCache::FindInDirectory(const std::string &dir,
+                                          const std::string &file) {
+  std::shared_ptr<Directory> d;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::shared_ptr<Directory> &slot = m_directories[dir];
+    if (!slot)
+      slot = std::make_shared<Directory>();
+    d = slot;
+  }
+
+  std::call_once(d->once, [&]() {
+    std::error_code ec, fileEc;
+    fs::directory_iterator i(dir.empty() ? "." : dir, ec), iend;
+    for (; !ec && i != iend; i.increment(ec)) {
+      if (i->is_regular_file(fileEc))
+        d->files.emplace(Lower(i->path().filename().string()),
+                         i->path().string());
+    }
+  });
+
+  std::unordered_map<std::string, std::string>::const_iterator i =
+      d->files.find(file);
+  return i == d->files.end() ? std::string() : i->second;
+}
+
+std::string CExportCache::FindDll(std::string_view module,
+                                  const std::string &fromPath) {
+  std::string file = Lower(module) + ".dll";
+  std::string path =
+      FindInDirectory(fs::path(fromPath).parent_path().string(), file);
+  for (size_t i = 0; i < m_dirs.size() && path.empty(); ++i)
+    path = FindInDirectory(m_dirs[i], file);
+  return path;
+}
+
+ForwarderTarget CExportCache::Resolve(std::string_view forward,
+                                      const std::string &path) {
+  ForwarderTarget r;
+  r.target = forward;
+  r.hops = 0;
+  r.found = false;
+
+  std::set<std::string> seen;
+  seen.insert(Lower(forward));
+  std::string from = path;
+  for (;;) {
+    std::string_view module, name;
+    if (!SplitForwarder(r.target, module, name))
+      return r;
+
+    std::string dll = FindDll(module, from);
+    if (dll.empty())
+      return r;
+    std::shared_ptr<Entry> entry = GetEntry(dll);
+    if (!entry->ok)
+      return r;
+
+    const ExportSymbol *e = 0;
+    if (name[0] == '#') {
+      std::unordered_map<int, const ExportSymbol *>::const_iterator i =
+          entry->byOrdinal.find(atoi(std::string(name.substr(1)).c_str()));
+      e = i == entry->byOrdinal.end() ? 0 : i->second;
+    } else {
+      std::unordered_map<std::string_view,
+                         const ExportSymbol *>::const_iterator i =
+          entry->byName.find(name);
+      e = i == entry->byName.end() ? 0 : i->second;
+    }
+    if (e == 0)
+      return r;
+
+    if (e->forward.empty()) {
+      r.found = true;
+      return r;
+    }
+    if (r.hops >= MaxHops || !seen.insert(Lower(e->forward)).second)
+      return r;
+
+    r.target = e->forward;
+    ++r.hops;
+    from = dll;
+  }
+}
+
+size_t CExportCache::ResolveManifest(CManifest &m, const std::string &path) {
+  size_t found = 0;
+  std::vector<ExportSymbol>::iterator i, iend;
+  for (i = m.symbols.begin(), iend = m.symbols.end(); i != iend; ++i) {
+    if (i->forward.empty())
+      continue;
+    ForwarderTarget t = Resolve(i->forward, path);
+    i->target = t.target == i->forward ? i->forward : m.Store(t.target);
+    if (t.found)
+      ++found;
+  }
+  return found;
+}
+}; // namespace Sora
@@ -0,0 +1,71 @@
+#ifndef EXPORTCACHE_H
+#define EXPORTCACHE_H
+
+#include "DllCache.h"
+#include "Manifest.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Sora {
+// the end of a forwarder chain
+struct ForwarderTarget {
+  std::string target; // the last forwarder string of the chain, NTDLL.RtlFoo
+  int hops;           // forwarders followed after the first one
+  bool found;         // target is an export of a dll found, not forwarded
+};
+
+// the export tables of a set of dlls, each parsed at most once and shared by
+// all threads, to follow forwarder chains across them. a dll forwarded to is
+// looked for next to the forwarding dll, then in the search directories, by
+// its name in any case. a chain ends at an export that isn't forwarded, at a
+// dll or an export that can't be found (an API set, an export by ordinal
+// only) and before a forwarder seen before.
+// with a store, the dlls are loaded through it instead of parsed every run
+class CExportCache {
+public:
+  explicit CExportCache(
+      const std::vector<std::string> &dirs = std::vector<std::string>(),
+      CDllCache *store = 0);
+  CExportCache(const CExportCache &) = delete;
+  CExportCache &operator=(const CExportCache &) = delete;
+
+  // the exports of the dll at path, parsed on the first call
+  // return: 0 if it isn't a PE image with exports
+  const CManifest *Load(const std::string &path);
+
+  // follows forward, a forwarder string of the dll at path, to its end
+  ForwarderTarget Resolve(std::string_view forward, const std::string &path);
+
+  // sets the target of every forwarded symbol of m, the exports of the dll at
+  // path
+  // return: the number of chains ending at an export found
+  size_t ResolveManifest(CManifest &m, const std::string &path);
+
+  // the dlls parsed, or loaded from the store, so far
+  size_t GetParsedCount() const { return m_parsed; }
+
+private:
+  struct Entry;
+  struct Directory;
+
+  std::vector<std::string> m_dirs;
+  CDllCache *m_store;
+  std::mutex m_lock;
+  std::unordered_map<std::string, std::shared_ptr<Entry>> m_entries;
+  std::unordered_map<std::string, std::shared_ptr<Directory>> m_directories;
+  std::atomic<size_t> m_parsed;
+
+  std::shared_ptr<Entry> GetEntry(const std::string &path);
+  // the path of module.dll in dir, "" if it isn't there
+  std::string FindInDirectory(const std::string &dir, const std::string &file);
+  std::string FindDll(std::string_view module, const std::string &fromPath);
+};
+}; // namespace Sora
+
+#endif
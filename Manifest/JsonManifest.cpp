@@ -0,0 +1,198 @@
+#include "Manifest.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using json = nlohmann::json;
+
+namespace Sora {
+// the views point into the strings of the document held by the manifest
+static std::string_view View(const json &v) {
+  const std::string &s = v.get_ref<const std::string &>();
+  return std::string_view(s.data(), s.size());
+}
+
+void ParseJsonManifest(std::string_view text, CManifest &m) {
+  std::shared_ptr<json> doc =
+      std::make_shared<json>(json::parse(text.begin(), text.end()));
+  m.Hold(doc);
+
+  const json &j = *doc;
+  m.dllName = View(j.at("dllname"));
+  m.arch = j.at("arch");
+
+  const json &symbols = j.at("symbols");
+  m.symbols.reserve(m.symbols.size() + symbols.size());
+
+  for (const json &symbol : symbols) {
+    ExportSymbol e;
+    json::const_iterator cconv = symbol.find("cconv");
+    if (cconv != symbol.end())
+      e.cconv = View(*cconv);
+    e.name = View(symbol.at("name"));
+    e.ord = symbol.at("ord");
+    e.thunk = View(symbol.at("thunk"));
+    e.pubname = View(symbol.at("pubname"));
+    json::const_iterator forward = symbol.find("forward");
+    if (forward != symbol.end())
+      e.forward = View(*forward);
+    json::const_iterator target = symbol.find("target");
+    if (target != symbol.end())
+      e.target = View(*target);
+    e.argBytes = -1;
+    e.flags = 0;
+    m.symbols.push_back(e);
+  }
+}
+
+// the length of the UTF-8 sequence at s[i] and its code point, 0 if invalid
+static size_t DecodeUtf8(std::string_view s, size_t i, unsigned *cp) {
+  unsigned char c = s[i];
+  size_t n = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC2 ? 2 : 0;
+  if (n == 0 || c >= 0xF5 || i + n > s.size())
+    return 0;
+
+  unsigned v = c & (0x7F >> n);
+  for (size_t k = 1; k < n; ++k) {
+    unsigned char cc = s[i + k];
+    if ((cc & 0xC0) != 0x80)
+      return 0;
+    v = (v << 6) | (cc & 0x3F);
+  }
+  // overlong, surrogate or out of range
+  if ((n == 3 && v < 0x800) || (n == 4 && (v < 0x10000 || v > 0x10FFFF)) ||
+      (v >= 0xD800 && v <= 0xDFFF))
+    return 0;
+  *cp = v;
+  return n;
+}
+
+// escaped like Python's json.dump, ensure_ascii: the output of dumpsyms.py
+void AppendJsonString(std::string &out, std::string_view s) {
+  char esc[16];
+  out += '"';
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      continue;
+    case '\\':
+      out += "\\\\";
+      continue;
+    case '\n':
+      out += "\\n";
+      continue;
+    case '\r':
+      out += "\\r";
+      continue;
+    case '\t':
+      out += "\\t";
+      continue;
+    case '\b':
+      out += "\\b";
+      continue;
+    case '\f':
+      out += "\\f";
+      continue;
+    }
+
+    if (c >= 0x20 && c < 0x7F) {
+      out += c;
+      continue;
+    }
+
+    // invalid UTF-8 is written byte by byte
+    unsigned cp = c;
+    size_t n = c >= 0x80 ? DecodeUtf8(s, i, &cp) : 1;
+    if (n == 0)
+      n = 1;
+    i += n - 1;
+
+    if (cp >= 0x10000) {
+      cp -= 0x10000;
+      snprintf(esc, sizeof(esc), "\\u%04x\\u%04x", 0xD800 + (cp >> 10),
+               0xDC00 + (cp & 0x3FF));
+    } else {
+      snprintf(esc, sizeof(esc), "\\u%04x", cp);
+    }
+    out += esc;
+  }
+  out += '"';
+}
+
+bool ParseJsonStreamFile(std::string_view line, std::string &file) {
+  static const std::string_view prefix("{\"file\": \"");
+  if (line.substr(0, prefix.size()) != prefix)
+    return false;
+
+  // the end of the string, the escapes are left to the parser
+  size_t end = prefix.size();
+  while (end < line.size() && line[end] != '"')
+    end += line[end] == '\\' ? 2 : 1;
+  if (end >= line.size())
+    return false;
+
+  std::string_view literal = line.substr(prefix.size() - 1,
+                                         end - prefix.size() + 2);
+  try {
+    file = json::parse(literal.begin(), literal.end()).get<std::string>();
+  } catch (json::exception &) {
+    return false;
+  }
+  return true;
+}
+
+void WriteJsonManifest(const CManifest &m, std::string &out) {
+  out += "{\n  \"dllname\": ";
+  AppendJsonString(out, m.dllName);
+  out += ",\n  \"arch\": " + std::to_string(m.arch);
+  out += ",\n  \"symbols\": [";
+
+  for (size_t i = 0; i < m.symbols.size(); ++i) {
+    const ExportSymbol &e = m.symbols[i];
+    out += i ? ",\n    {\n      \"cconv\": " : "\n    {\n      \"cconv\": ";
+    AppendJsonString(out, e.cconv);
+    out += ",\n      \"name\": ";
+    AppendJsonString(out, e.flags & ESF_NONAME ? std::string_view() : e.name);
+    out += ",\n      \"ord\": " + std::to_string(e.ord);
+    out += ",\n      \"thunk\": ";
+    AppendJsonString(out, e.thunk);
+    out += ",\n      \"pubname\": ";
+    AppendJsonString(out, e.pubname);
+    if (!e.forward.empty()) {
+      out += ",\n      \"forward\": ";
+      AppendJsonString(out, e.forward);
+    }
+    if (!e.target.empty()) {
+      out += ",\n      \"target\": ";
+      AppendJsonString(out, e.target);
+    }
+    out += "\n    }";
+  }
+
+  out += m.symbols.empty() ? "]\n}" : "\n  ]\n}";
+}
+
+void LoadJsonManifest(const char *path, CManifest &m) {
+  // the document copies the strings, no need to keep the text
+  std::ifstream f(path, std::ios::binary);
+  if (!f.is_open())
+    throw std::runtime_error(std::string("Fail to open input file ") + path);
+
+  f.seekg(0, std::ios::end);
+  std::string text((size_t)f.tellg(), '\0');
+  f.seekg(0, std::ios::beg);
+  f.read(&text[0], text.size());
+
+  try {
+    ParseJsonManifest(text, m);
+  } catch (json::exception &e) {
+    throw std::runtime_error(std::string(path) + ": " + e.what());
+  }
+}
+}; // namespace Sora
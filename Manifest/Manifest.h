@@ -0,0 +1,180 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "LibGenHelperInterfaces.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Sora {
+enum ExportSymbolFlags {
+  // thunk and pubname are derived from name, cconv and argBytes by the
+  // decoration rules of the manifest's architecture, see DecorateSymbols
+  ESF_DERIVED = 1,
+  // import by ordinal even though a name is known (.def NONAME)
+  ESF_NONAME = 2,
+  // data export, no call stub is generated (.def DATA)
+  ESF_DATA = 4,
+  // a function imported through its pointer only, no call stub is generated
+  // (CSymbolFilter SR_NOSTUB)
+  ESF_NOSTUB = 8,
+  // imported from the dll of target, the end of its forwarder chain, instead
+  // of the manifest's dll (mkimplib --import-final)
+  ESF_TARGET = 16
+};
+
+// every string view of a manifest points to a NUL-terminated string owned by
+// the manifest, so data() can be handed to the builders as is.
+struct ExportSymbol {
+  std::string_view cconv;   // STDCALL, CDECL, FASTCALL... informational
+  std::string_view name;    // name exported from the dll, empty: by ordinal
+  std::string_view thunk;   // _Sleep@4, empty: no stub
+  std::string_view pubname; // __imp__Sleep@4
+  std::string_view forward; // NTDLL.RtlAllocateHeap if forwarded, or empty
+  std::string_view target;  // the end of the forwarder chain, if resolved
+  int ord;
+  int argBytes; // the @nn of stdcall/fastcall names, -1 if unknown
+  int flags;    // ExportSymbolFlags
+};
+
+class CManifest {
+public:
+  std::string_view dllName;
+  int arch; // 32 or 64
+  std::vector<ExportSymbol> symbols;
+
+  CManifest();
+  CManifest(CManifest &&) = default;
+  CManifest &operator=(CManifest &&) = default;
+
+  // memory living as long as the manifest, for strings the views refer to
+  char *Allocate(size_t len);
+
+  // copy prefix + s into the manifest, NUL-terminated
+  std::string_view Store(std::string_view s);
+  std::string_view Store(std::string_view prefix, std::string_view s);
+
+  // keep an object alive as long as the manifest, e.g. a parsed document
+  void Hold(std::shared_ptr<const void> owner);
+
+private:
+  std::vector<std::unique_ptr<char[]>> m_chunks;
+  char *m_cur;
+  size_t m_left;
+  std::vector<std::shared_ptr<const void>> m_owners;
+};
+
+// fill thunk and pubname of the ESF_DERIVED symbols for m.arch:
+// x86: cdecl _name, stdcall _name@nn, fastcall @name@nn, vectorcall name@@nn
+// x64: name
+// C++ names (starting with '?') are never decorated. pubname is __imp_ + thunk.
+void DecorateSymbols(CManifest &m);
+
+// m for another architecture: the ESF_DERIVED symbols are decorated for arch,
+// everything else is shared with m, which must outlive target
+void RetargetManifest(const CManifest &m, int arch, CManifest &target);
+
+// the short name of an architecture, x86 or x64, 0 if unknown
+const char *ArchitectureName(int arch);
+
+// a forwarder string, NTDLL.RtlAllocateHeap or NTDLL.#12: the module is the
+// dll name without .dll, up to the last dot
+// return: false if it has no module or no export
+bool SplitForwarder(std::string_view forward, std::string_view &module,
+                    std::string_view &name);
+
+// JSON manifest as written by dumpsyms
+void ParseJsonManifest(std::string_view text, CManifest &m);
+void LoadJsonManifest(const char *path, CManifest &m);
+// in the layout of dumpsyms, forward and target are written when known
+void WriteJsonManifest(const CManifest &m, std::string &out);
+// s as a JSON string, escaped like dumpsyms.py does: ASCII only
+void AppendJsonString(std::string &out, std::string_view s);
+// the "file" of a line of dumpsyms /COMBINED or /STREAM, which comes first,
+// without parsing the rest of the line
+// return: false if the line doesn't start with it
+bool ParseJsonStreamFile(std::string_view line, std::string &file);
+
+// .def file: LIBRARY, EXPORTS name[=internal] [@ord] [NONAME] [DATA]
+// [PRIVATE]. the text is parsed in place, the symbols point into it.
+// arch: the architecture to decorate names for, 32 or 64
+// fileName: for error messages, and the dll name if there is no LIBRARY
+void ParseDefManifest(char *text, size_t len, int arch, CManifest &m,
+                      const char *fileName = "");
+void LoadDefManifest(const char *path, int arch, CManifest &m);
+
+// export table of a PE image (dll, exe). named exports only, with the
+// conventions of dumpsyms: thunk is the name, pubname __imp_ + name. the
+// names point into the image, it must live as long as the manifest.
+// fileName: for error messages and the dll name, if empty the dll name comes
+// from the export directory.
+// throws std::runtime_error for a machine other than i386 and amd64, those
+// CoffGen writes import libraries for
+void ParseDllManifest(const BYTE *image, size_t len, CManifest &m,
+                      const char *fileName = "");
+// the file is mapped into memory and held by the manifest
+void LoadDllManifest(const char *path, CManifest &m);
+
+// the fields of the headers of a PE image, enough to tell an image with
+// exports from anything else without reading the rest of the file
+struct PeHeader {
+  WORD machine;
+  DWORD timeDateStamp;
+  DWORD checkSum;
+  DWORD sizeOfImage;
+  DWORD exportRva;
+  DWORD exportSize; // 0: no exports
+  int arch;         // 32 or 64, like ParseDllManifest. 0: another machine
+};
+
+// the headers are in the first page of any image a linker writes
+const size_t PeHeaderReadSize = 4096;
+
+// data: the start of the file
+// return: false if it isn't a PE image
+bool ParsePeHeader(const BYTE *data, size_t len, PeHeader &h);
+// reads the start of the file only, once more if the headers are further
+// return: false if it isn't a PE image or can't be read
+bool ReadPeHeader(const char *path, PeHeader &h);
+
+// binary manifest, see BinaryManifest.h. the strings point into the data, it
+// must live as long as the manifest.
+void ParseBinaryManifest(const BYTE *data, size_t len, CManifest &m,
+                         const char *fileName = "");
+// the file is mapped into memory and held by the manifest
+void LoadBinaryManifest(const char *path, CManifest &m);
+void WriteBinaryManifest(const CManifest &m, std::vector<BYTE> &out);
+
+// .def by the file extension, PE images and binary manifests by their
+// signature, JSON otherwise.
+// arch applies to the formats without architecture information (.def), 0
+// means x86.
+void LoadManifest(const char *path, int arch, CManifest &m);
+
+// a manifest in memory, the format chosen by the content like LoadManifest:
+// PE image, binary manifest, JSON if it starts with '{', .def otherwise.
+// the text is parsed in place and must live as long as the manifest.
+void ParseManifest(char *text, size_t len, int arch, CManifest &m,
+                   const char *fileName = "");
+
+// the builder for the manifest's dll and architecture
+IImportLibraryBuilder *CreateImpLibBuilder(const CManifest &m);
+
+// add every symbol of the manifest to the builder, the ESF_TARGET symbols
+// from the dll of their target
+void AddImports(const CManifest &m, IImportLibraryBuilder *builder);
+
+class CSha256;
+
+// hash everything of the manifest that ends up in the library, in a canonical
+// form: the same export set read from JSON, .def or the dll hashes the same
+void HashManifest(const CManifest &m, CSha256 &hash);
+
+// read a whole file into memory owned by the manifest, NUL-terminated
+char *ReadWholeFile(const char *path, CManifest &m, size_t *len);
+}; // namespace Sora
+
+#endif
@@ -0,0 +1,268 @@
+#include "Manifest.h"
+
+#include "BinaryManifest.h"
+#include "LibGenHelperFactory.h"
+#include "Sha256.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace Sora {
+// strings are carved out of chunks of this size, bigger blocks get their own
+static const size_t ChunkSize = 64 * 1024;
+
+CManifest::CManifest() : arch(32), m_cur(0), m_left(0) {}
+
+char *CManifest::Allocate(size_t len) {
+  if (len > ChunkSize / 4) {
+    m_chunks.emplace_back(new char[len]);
+    return m_chunks.back().get();
+  }
+
+  if (m_left < len) {
+    m_chunks.emplace_back(new char[ChunkSize]);
+    m_cur = m_chunks.back().get();
+    m_left = ChunkSize;
+  }
+
+  char *r = m_cur;
+  m_cur += len;
+  m_left -= len;
+  return r;
+}
+
+std::string_view CManifest::Store(std::string_view s) { return Store("", s); }
+
+std::string_view CManifest::Store(std::string_view prefix, std::string_view s) {
+  size_t len = prefix.size() + s.size();
+  char *p = Allocate(len + 1);
+  std::copy(prefix.begin(), prefix.end(), p);
+  std::copy(s.begin(), s.end(), p + prefix.size());
+  p[len] = 0;
+  return std::string_view(p, len);
+}
+
+void CManifest::Hold(std::shared_ptr<const void> owner) {
+  m_owners.push_back(std::move(owner));
+}
+
+void DecorateSymbols(CManifest &m) {
+  std::string tmp;
+
+  std::vector<ExportSymbol>::iterator i, iend;
+  for (i = m.symbols.begin(), iend = m.symbols.end(); i != iend; ++i) {
+    if (!(i->flags & ESF_DERIVED))
+      continue;
+
+    if (m.arch == 64 || i->name.empty() || i->name[0] == '?') {
+      i->thunk = i->name;
+    } else {
+      tmp.clear();
+      if (i->cconv == "FASTCALL")
+        tmp += '@';
+      else if (i->cconv != "VECTORCALL")
+        tmp += '_';
+      tmp += i->name;
+      if (i->argBytes >= 0 && i->cconv != "CDECL") {
+        tmp += i->cconv == "VECTORCALL" ? "@@" : "@";
+        tmp += std::to_string(i->argBytes);
+      }
+      i->thunk = m.Store(tmp);
+    }
+
+    i->pubname = m.Store("__imp_", i->thunk);
+    if (i->flags & (ESF_DATA | ESF_NOSTUB))
+      i->thunk = std::string_view();
+  }
+}
+
+void RetargetManifest(const CManifest &m, int arch, CManifest &target) {
+  target.dllName = m.dllName;
+  target.arch = arch;
+  target.symbols = m.symbols;
+  if (arch != m.arch)
+    DecorateSymbols(target);
+}
+
+const char *ArchitectureName(int arch) {
+  switch (arch) {
+  case 32:
+    return "x86";
+  case 64:
+    return "x64";
+  }
+  return 0;
+}
+
+bool SplitForwarder(std::string_view forward, std::string_view &module,
+                    std::string_view &name) {
+  size_t dot = forward.rfind('.');
+  if (dot == std::string_view::npos || dot == 0 || dot + 1 == forward.size())
+    return false;
+  module = forward.substr(0, dot);
+  name = forward.substr(dot + 1);
+  return true;
+}
+
+// little-endian length + bytes, so that no two manifests hash the same text
+static void HashField(CSha256 &hash, std::string_view s) {
+  unsigned char len[4] = {(unsigned char)s.size(),
+                          (unsigned char)(s.size() >> 8),
+                          (unsigned char)(s.size() >> 16),
+                          (unsigned char)(s.size() >> 24)};
+  hash.Update(len, 4);
+  hash.Update(s.data(), s.size());
+}
+
+static void HashField(CSha256 &hash, int v) {
+  unsigned char bytes[4] = {(unsigned char)v, (unsigned char)(v >> 8),
+                            (unsigned char)(v >> 16),
+                            (unsigned char)(v >> 24)};
+  hash.Update(bytes, 4);
+}
+
+void HashManifest(const CManifest &m, CSha256 &hash) {
+  HashField(hash, m.dllName);
+  HashField(hash, m.arch);
+  HashField(hash, (int)m.symbols.size());
+
+  // the fields AddImports uses: cconv, argBytes and forward don't matter,
+  // target only for the symbols imported from it
+  std::vector<ExportSymbol>::const_iterator i, iend;
+  for (i = m.symbols.begin(), iend = m.symbols.end(); i != iend; ++i) {
+    bool byName = !i->name.empty() && !(i->flags & ESF_NONAME);
+    HashField(hash, byName ? i->name : std::string_view());
+    HashField(hash, i->thunk);
+    HashField(hash, i->pubname);
+    HashField(hash, byName ? 0 : i->ord);
+    if (i->flags & ESF_TARGET)
+      HashField(hash, i->target);
+  }
+}
+
+char *ReadWholeFile(const char *path, CManifest &m, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == 0)
+    throw std::runtime_error(std::string("Fail to open input file ") + path);
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  char *buf = m.Allocate(size + 1);
+  size_t got = size > 0 ? fread(buf, 1, size, f) : 0;
+  fclose(f);
+
+  if (size < 0 || got != (size_t)size)
+    throw std::runtime_error(std::string("Fail to read input file ") + path);
+
+  buf[size] = 0;
+  *len = size;
+  return buf;
+}
+
+static bool HasExtension(const char *path, const char *ext) {
+  size_t pl = strlen(path), el = strlen(ext);
+  if (pl < el)
+    return false;
+
+  const char *p = path + pl - el;
+  for (size_t i = 0; i < el; ++i) {
+    if (tolower((unsigned char)p[i]) != ext[i])
+      return false;
+  }
+  return true;
+}
+
+// dlls and exes start with MZ, binary manifests with their magic, JSON
+// can't start with either
+static void ReadSignature(const char *path, char sig[4]) {
+  FILE *f = fopen(path, "rb");
+  if (f == 0)
+    throw std::runtime_error(std::string("Fail to open input file ") + path);
+
+  size_t got = fread(sig, 1, 4, f);
+  fclose(f);
+  memset(sig + got, 0, 4 - got);
+}
+
+void LoadManifest(const char *path, int arch, CManifest &m) {
+  if (HasExtension(path, ".def")) {
+    LoadDefManifest(path, arch == 0 ? 32 : arch, m);
+    return;
+  }
+
+  char sig[4];
+  ReadSignature(path, sig);
+  if (sig[0] == 'M' && sig[1] == 'Z')
+    LoadDllManifest(path, m);
+  else if (memcmp(sig, BinaryManifestMagic, 4) == 0)
+    LoadBinaryManifest(path, m);
+  else
+    LoadJsonManifest(path, m);
+}
+
+void ParseManifest(char *text, size_t len, int arch, CManifest &m,
+                   const char *fileName) {
+  if (len >= 2 && text[0] == 'M' && text[1] == 'Z') {
+    ParseDllManifest((const BYTE *)text, len, m, fileName);
+  } else if (len >= 4 && memcmp(text, BinaryManifestMagic, 4) == 0) {
+    ParseBinaryManifest((const BYTE *)text, len, m, fileName);
+  } else {
+    size_t i = 0;
+    while (i < len && isspace((unsigned char)text[i]))
+      ++i;
+    if (i < len && text[i] == '{')
+      ParseJsonManifest(std::string_view(text, len), m);
+    else
+      ParseDefManifest(text, len, arch == 0 ? 32 : arch, m, fileName);
+  }
+}
+
+IImportLibraryBuilder *CreateImpLibBuilder(const CManifest &m) {
+  LPCSTR dllName = m.dllName.data();
+  if (m.arch == 64)
+    return CreateX64ImpLibBuilder(dllName, dllName);
+  else
+    return CreateX86ImpLibBuilder(dllName, dllName);
+}
+
+// imports the symbol from the dll of its target: NTDLL.RtlFoo by name,
+// NTDLL.#12 by ordinal
+static void AddTargetImport(const ExportSymbol &e, LPCSTR thunk,
+                            IImportLibraryBuilder *builder) {
+  std::string_view module, name;
+  if (!SplitForwarder(e.target, module, name))
+    throw std::runtime_error("Bad forwarder target " + std::string(e.target));
+
+  std::string dll = std::string(module) + ".dll";
+  if (name[0] == '#') {
+    builder->AddImportFunctionFromDll(dll.c_str(), e.pubname.data(), thunk, 0,
+                                      atoi(name.data() + 1));
+  } else {
+    std::string import(name);
+    builder->AddImportFunctionFromDll(dll.c_str(), e.pubname.data(), thunk,
+                                      import.c_str(), 0);
+  }
+}
+
+void AddImports(const CManifest &m, IImportLibraryBuilder *builder) {
+  std::vector<ExportSymbol>::const_iterator i, iend;
+  for (i = m.symbols.begin(), iend = m.symbols.end(); i != iend; ++i) {
+    LPCSTR thunk = i->thunk.empty() ? 0 : i->thunk.data();
+
+    if ((i->flags & ESF_TARGET) && !i->target.empty())
+      AddTargetImport(*i, thunk, builder);
+    else if (!i->name.empty() && !(i->flags & ESF_NONAME))
+      builder->AddImportFunctionByName(i->pubname.data(), thunk,
+                                       i->name.data());
+    else
+      builder->AddImportFunctionByOrdinal(i->pubname.data(), thunk, i->ord);
+  }
+}
+}; // namespace Sora
@@ -0,0 +1,100 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Sora {
+#ifdef _WIN32
+
+bool CMappedFile::Open(const char *path) {
+  Close();
+
+  HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(hFile, &size)) {
+    CloseHandle(hFile);
+    return false;
+  }
+
+  if (size.QuadPart == 0) {
+    // empty files can't be mapped
+    CloseHandle(hFile);
+    return true;
+  }
+
+  HANDLE hMap = CreateFileMappingA(hFile, 0, PAGE_READONLY, 0, 0, 0);
+  CloseHandle(hFile);
+  if (hMap == 0)
+    return false;
+
+  m_data = (const unsigned char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+  if (m_data == 0) {
+    CloseHandle(hMap);
+    return false;
+  }
+
+  m_handle = hMap;
+  m_size = (size_t)size.QuadPart;
+  return true;
+}
+
+void CMappedFile::Close() {
+  if (m_data != 0)
+    UnmapViewOfFile(m_data);
+  if (m_handle != 0)
+    CloseHandle((HANDLE)m_handle);
+  m_data = 0;
+  m_size = 0;
+  m_handle = 0;
+}
+
+#else
+
+bool CMappedFile::Open(const char *path) {
+  Close();
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  if (st.st_size == 0) {
+    // empty files can't be mapped
+    close(fd);
+    return true;
+  }
+
+  void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return false;
+
+  m_data = (const unsigned char *)p;
+  m_size = st.st_size;
+  return true;
+}
+
+void CMappedFile::Close() {
+  if (m_data != 0)
+    munmap((void *)m_data, m_size);
+  m_data = 0;
+  m_size = 0;
+}
+
+#endif
+}; // namespace Sora
@@ -0,0 +1,30 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+namespace Sora {
+// a whole file mapped read-only into memory
+class CMappedFile {
+public:
+  CMappedFile() : m_data(0), m_size(0), m_handle(0) {}
+  ~CMappedFile() { Close(); }
+
+  // return: false if the file can't be opened or mapped
+  bool Open(const char *path);
+  void Close();
+
+  const unsigned char *GetData() const { return m_data; }
+  size_t GetSize() const { return m_size; }
+
+private:
+  const unsigned char *m_data;
+  size_t m_size;
+  void *m_handle; // the mapping object on Windows
+
+  CMappedFile(const CMappedFile &);
+  CMappedFile &operator=(const CMappedFile &);
+};
+}; // namespace Sora
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Sora {
+// FIPS 180-4 SHA-256
+class CSha256 {
+public:
+  enum { DigestSize = 32 };
+
+  CSha256();
+
+  void Update(const void *data, size_t len);
+  void Final(unsigned char digest[DigestSize]);
+
+  // the digest as 64 lowercase hex digits, the object is finished
+  std::string HexDigest();
+
+private:
+  uint32_t m_state[8];
+  uint64_t m_length; // bytes
+  unsigned char m_block[64];
+  size_t m_used;
+
+  void Transform(const unsigned char *block);
+};
+}; // namespace Sora
+
+#endif
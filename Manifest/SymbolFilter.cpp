@@ -0,0 +1,155 @@
+#include "SymbolFilter.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace Sora {
+static const std::string_view RegexPrefix = "re:";
+
+static bool GlobMatch(std::string_view p, std::string_view s) {
+  // the last * is retried one character further on a mismatch
+  size_t pi = 0, si = 0, star = std::string_view::npos, mark = 0;
+  while (si < s.size()) {
+    if (pi < p.size() && (p[pi] == '?' || p[pi] == s[si])) {
+      ++pi;
+      ++si;
+    } else if (pi < p.size() && p[pi] == '*') {
+      star = pi++;
+      mark = si;
+    } else if (star != std::string_view::npos) {
+      pi = star + 1;
+      si = ++mark;
+    } else {
+      return false;
+    }
+  }
+  while (pi < p.size() && p[pi] == '*')
+    ++pi;
+  return pi == p.size();
+}
+
+void CNameMatcher::Add(std::string_view pattern) {
+  if (pattern.substr(0, RegexPrefix.size()) == RegexPrefix) {
+    std::string re(pattern.substr(RegexPrefix.size()));
+    try {
+      std::regex check(re);
+    } catch (const std::regex_error &) {
+      throw std::runtime_error("Bad regular expression " + re);
+    }
+
+    if (!m_regexText.empty())
+      m_regexText += '|';
+    m_regexText += "(?:" + re + ")";
+    m_regex.reset(new std::regex(m_regexText, std::regex::ECMAScript |
+                                                  std::regex::optimize));
+    return;
+  }
+
+  size_t wild = pattern.find_first_of("*?");
+  if (wild == std::string_view::npos) {
+    AddName(pattern);
+    return;
+  }
+
+  size_t last = pattern.find_last_of("*?");
+  Glob g = {std::string(pattern), wild, pattern.size() - last - 1};
+  m_globs.push_back(g);
+}
+
+void CNameMatcher::AddName(std::string_view name) {
+  if (m_exact.find(name) != m_exact.end())
+    return;
+  m_names.emplace_back(name);
+  m_exact.insert(m_names.back());
+}
+
+bool CNameMatcher::Empty() const {
+  return m_exact.empty() && m_globs.empty() && !m_regex;
+}
+
+bool CNameMatcher::Matches(std::string_view name) const {
+  if (!m_exact.empty() && m_exact.find(name) != m_exact.end())
+    return true;
+
+  std::vector<Glob>::const_iterator i, iend;
+  for (i = m_globs.begin(), iend = m_globs.end(); i != iend; ++i) {
+    size_t n = i->pattern.size();
+    if (name.size() >= i->prefix + i->suffix &&
+        name.compare(0, i->prefix, i->pattern, 0, i->prefix) == 0 &&
+        name.compare(name.size() - i->suffix, i->suffix, i->pattern,
+                     n - i->suffix, i->suffix) == 0 &&
+        GlobMatch(i->pattern, name))
+      return true;
+  }
+
+  return m_regex && std::regex_match(name.begin(), name.end(), *m_regex);
+}
+
+void CSymbolFilter::Add(SymbolRule rule, std::string_view pattern) {
+  switch (rule) {
+  case SR_INCLUDE:
+    m_include.Add(pattern);
+    break;
+  case SR_EXCLUDE:
+    m_exclude.Add(pattern);
+    break;
+  case SR_NOSTUB:
+    m_noStub.Add(pattern);
+    break;
+  }
+}
+
+void CSymbolFilter::AddAllowList(std::string_view text) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    if (end == std::string_view::npos)
+      end = text.size();
+    std::string_view line = text.substr(pos, end - pos);
+    pos = end + 1;
+
+    size_t b = line.find_first_not_of(" \t\r");
+    if (b == std::string_view::npos || line[b] == '#')
+      continue;
+    size_t e = line.find_last_not_of(" \t\r");
+    m_include.AddName(line.substr(b, e - b + 1));
+  }
+}
+
+void CSymbolFilter::LoadAllowList(const char *path) {
+  CManifest scratch;
+  size_t len;
+  char *text = ReadWholeFile(path, scratch, &len);
+  AddAllowList(std::string_view(text, len));
+}
+
+bool CSymbolFilter::Empty() const {
+  return m_include.Empty() && m_exclude.Empty() && m_noStub.Empty();
+}
+
+void CSymbolFilter::Apply(CManifest &m) const {
+  bool include = !m_include.Empty();
+  bool exclude = !m_exclude.Empty();
+  bool noStub = !m_noStub.Empty();
+
+  std::vector<ExportSymbol>::iterator i, out = m.symbols.begin();
+  for (i = m.symbols.begin(); i != m.symbols.end(); ++i) {
+    std::string_view name = i->name;
+    if (name.empty())
+      name = i->thunk.empty() ? i->pubname : i->thunk;
+
+    if (include && !m_include.Matches(name))
+      continue;
+    if (exclude && m_exclude.Matches(name))
+      continue;
+    if (noStub && m_noStub.Matches(name)) {
+      i->flags |= ESF_NOSTUB;
+      i->thunk = std::string_view();
+    }
+    if (out != i)
+      *out = *i;
+    ++out;
+  }
+  m.symbols.erase(out, m.symbols.end());
+}
+}; // namespace Sora
@@ -0,0 +1,81 @@
+#ifndef SYMBOLFILTER_H
+#define SYMBOLFILTER_H
+
+#include "Manifest.h"
+
+#include <deque>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace Sora {
+// a set of name patterns compiled for matching many names:
+// - names without wildcards are looked up in a hash set
+// - globs (* any run, ? one character) are tried after a compare of their
+//   literal prefix and suffix
+// - regexes, "re:" + ECMAScript, are joined into one alternation
+// patterns match the whole name
+class CNameMatcher {
+public:
+  CNameMatcher() = default;
+  CNameMatcher(const CNameMatcher &) = delete;
+  CNameMatcher &operator=(const CNameMatcher &) = delete;
+
+  // throws std::runtime_error for a bad regex
+  void Add(std::string_view pattern);
+  // a name taken literally, even with * or ?
+  void AddName(std::string_view name);
+
+  bool Empty() const;
+  bool Matches(std::string_view name) const;
+
+private:
+  struct Glob {
+    std::string pattern;
+    size_t prefix; // the characters before the first wildcard
+    size_t suffix; // the characters after the last wildcard
+  };
+
+  std::deque<std::string> m_names; // the strings of m_exact
+  std::unordered_set<std::string_view> m_exact;
+  std::vector<Glob> m_globs;
+  std::string m_regexText;
+  std::unique_ptr<std::regex> m_regex;
+};
+
+enum SymbolRule {
+  SR_INCLUDE, // keep the matching symbols, all others are dropped
+  SR_EXCLUDE, // drop the matching symbols
+  SR_NOSTUB   // keep the import pointer of the matching symbols, no stub
+};
+
+// selects the symbols of a manifest before the library is built. with include
+// rules or an allow list only the symbols matching one of them are kept, then
+// the excluded ones are dropped. a symbol is matched by the name exported from
+// the dll, by its thunk or pubname if it is exported by ordinal only.
+class CSymbolFilter {
+public:
+  void Add(SymbolRule rule, std::string_view pattern);
+
+  // names one per line, blank lines and lines starting with # ignored: the
+  // symbols to keep, taken literally
+  void AddAllowList(std::string_view text);
+  void LoadAllowList(const char *path);
+
+  bool Empty() const;
+
+  // one pass over the symbols, the order is kept. stubs are suppressed with
+  // ESF_NOSTUB, so they stay suppressed when the manifest is retargeted
+  void Apply(CManifest &m) const;
+
+private:
+  CNameMatcher m_include;
+  CNameMatcher m_exclude;
+  CNameMatcher m_noStub;
+};
+}; // namespace Sora
+
+#endif
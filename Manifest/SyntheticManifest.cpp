@@ -0,0 +1,197 @@
+#include "SyntheticManifest.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Sora {
+// splitmix64: the same numbers on every platform, unlike the distributions
+// of <random>
+class CSyntheticRandom {
+  uint64_t m_state;
+
+public:
+  explicit CSyntheticRandom(uint64_t seed) : m_state(seed) {}
+
+  uint64_t Next() {
+    uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // [0, 1)
+  double Unit() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  // [0, n)
+  int Below(int n) { return (int)(Unit() * n); }
+};
+
+static const char letters[] =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+static const char base36[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static void CheckSpec(const SyntheticSpec &spec) {
+  if (spec.arch != 32 && spec.arch != 64)
+    throw std::runtime_error("Bad architecture, use 32 or 64!");
+  if (spec.minNameLength < 1 || spec.maxNameLength < spec.minNameLength)
+    throw std::runtime_error("Bad name length range!");
+  if (!(spec.ordinalOnly >= 0 && spec.ordinalOnly <= 1) ||
+      !(spec.stdcall >= 0 && spec.stdcall <= 1))
+    throw std::runtime_error("Bad fraction, use 0 to 1!");
+  if (spec.dllCount < 1)
+    throw std::runtime_error("Bad dll count!");
+}
+
+static int NameLength(const SyntheticSpec &spec, CSyntheticRandom &r) {
+  int range = spec.maxNameLength - spec.minNameLength;
+  double u;
+  switch (spec.nameLength) {
+  case NLD_NORMAL:
+    // Irwin-Hall: the mean of 4 uniforms
+    u = (r.Unit() + r.Unit() + r.Unit() + r.Unit()) / 4;
+    return spec.minNameLength + (int)(u * range + 0.5);
+  case NLD_SKEWED:
+    u = r.Unit();
+    return spec.minNameLength + (int)(u * u * u * u * (range + 1));
+  default:
+    return spec.minNameLength + r.Below(range + 1);
+  }
+}
+
+// the dll name without its extension, for the forwarders
+static std::string DllStem(const std::string &dllName) {
+  size_t dot = dllName.rfind('.');
+  return dot == std::string::npos ? dllName : dllName.substr(0, dot);
+}
+
+void GenerateSyntheticSymbols(const SyntheticSpec &spec, size_t first,
+                              size_t count, CManifest &m) {
+  CheckSpec(spec);
+  std::string stem = DllStem(spec.dllName), name, forward;
+  m.arch = spec.arch;
+  m.symbols.reserve(m.symbols.size() + count);
+
+  for (size_t index = first; index < first + count; ++index) {
+    CSyntheticRandom r(spec.seed ^ (index * 0xD1B54A32D192ED03ull));
+    r.Next();
+
+    // drawn before the name: the name options don't change the rest
+    ExportSymbol e;
+    bool stdcall = r.Unit() < spec.stdcall;
+    e.cconv = stdcall ? "STDCALL" : "CDECL";
+    e.argBytes = stdcall ? 4 * r.Below(9) : -1;
+    // past the 65535 ordinals of an export table they wrap
+    e.ord = (int)(index % 65535) + 1;
+    e.flags = ESF_DERIVED;
+    if (r.Unit() < spec.ordinalOnly)
+      e.flags |= ESF_NONAME;
+
+    // letters, then '_' and the index: the only '_' keeps the names unique
+    char digits[16];
+    int nDigits = 0;
+    size_t n = index;
+    do {
+      digits[nDigits++] = base36[n % 36];
+      n /= 36;
+    } while (n != 0);
+
+    int nLetters = std::max(1, NameLength(spec, r) - 1 - nDigits);
+    name.clear();
+    name += letters[26 + r.Below(26)];
+    for (int i = 1; i < nLetters; ++i)
+      name += letters[r.Below(52)];
+    name += '_';
+    while (nDigits > 0)
+      name += digits[--nDigits];
+
+    e.name = m.Store(name);
+
+    int dll = (int)(index % spec.dllCount);
+    if (dll != 0) {
+      forward = stem + std::to_string(dll) + ".";
+      forward += e.flags & ESF_NONAME ? "#" + std::to_string(e.ord) : name;
+      e.forward = m.Store(forward);
+    }
+    m.symbols.push_back(e);
+  }
+  DecorateSymbols(m);
+}
+
+void GenerateSyntheticManifest(const SyntheticSpec &spec, CManifest &m) {
+  m.dllName = m.Store(spec.dllName);
+  GenerateSyntheticSymbols(spec, 0, spec.count, m);
+}
+
+static void AppendJsonSymbol(const ExportSymbol &e, bool first,
+                             std::string &out) {
+  out += first ? "\n    {\n      \"cconv\": " : ",\n    {\n      \"cconv\": ";
+  AppendJsonString(out, e.cconv);
+  out += ",\n      \"name\": ";
+  AppendJsonString(out, e.flags & ESF_NONAME ? std::string_view() : e.name);
+  out += ",\n      \"ord\": " + std::to_string(e.ord);
+  out += ",\n      \"thunk\": ";
+  AppendJsonString(out, e.thunk);
+  out += ",\n      \"pubname\": ";
+  AppendJsonString(out, e.pubname);
+  if (!e.forward.empty()) {
+    out += ",\n      \"forward\": ";
+    AppendJsonString(out, e.forward);
+  }
+  out += "\n    }";
+}
+
+// the entry is decorated like the .def parser undecorates it: Name@nn
+static void AppendDefSymbol(const ExportSymbol &e, std::string &out) {
+  out += "  ";
+  out += e.name;
+  if (e.argBytes >= 0)
+    out += "@" + std::to_string(e.argBytes);
+  if (!e.forward.empty()) {
+    out += "=";
+    out += e.forward;
+  }
+  out += " @" + std::to_string(e.ord);
+  if (e.flags & ESF_NONAME)
+    out += " NONAME";
+  out += "\n";
+}
+
+void WriteSyntheticManifest(
+    const SyntheticSpec &spec, bool def, std::string &out,
+    const std::function<void(const std::string &)> &flush) {
+  CheckSpec(spec);
+  const size_t chunk = 65536, flushSize = 1 << 20;
+
+  if (def) {
+    out += "LIBRARY " + spec.dllName + "\nEXPORTS\n";
+  } else {
+    out += "{\n  \"dllname\": ";
+    AppendJsonString(out, spec.dllName);
+    out += ",\n  \"arch\": " + std::to_string(spec.arch);
+    out += ",\n  \"symbols\": [";
+  }
+
+  for (size_t first = 0; first < spec.count; first += chunk) {
+    CManifest m;
+    GenerateSyntheticSymbols(spec, first, std::min(chunk, spec.count - first),
+                             m);
+    for (size_t i = 0; i < m.symbols.size(); ++i) {
+      if (def)
+        AppendDefSymbol(m.symbols[i], out);
+      else
+        AppendJsonSymbol(m.symbols[i], first + i == 0, out);
+      if (flush && out.size() > flushSize) {
+        flush(out);
+        out.clear();
+      }
+    }
+  }
+
+  if (!def)
+    out += spec.count == 0 ? "]\n}\n" : "\n  ]\n}\n";
+  if (flush) {
+    flush(out);
+    out.clear();
+  }
+}
+}; // namespace Sora
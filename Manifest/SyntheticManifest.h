@@ -0,0 +1,59 @@
+#ifndef SYNTHETICMANIFEST_H
+#define SYNTHETICMANIFEST_H
+
+#include "Manifest.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace Sora {
+enum NameLengthDistribution {
+  NLD_UNIFORM, // every length of [min, max] as likely
+  NLD_NORMAL,  // around the middle of [min, max], rarely near the ends
+  NLD_SKEWED   // mostly near min, a long tail up to max, like C++ names
+};
+
+// an export set made up from a seed, for tests and benchmarks at any scale.
+// every symbol depends on the seed and its index only: the same spec gives
+// the same set on every platform, and any range of it can be made alone
+struct SyntheticSpec {
+  size_t count = 1000;
+  int arch = 64;
+  std::string dllName = "synthetic.dll";
+  uint64_t seed = 1;
+  // of the exported names, without decoration. a name is random letters, '_'
+  // and its index in base 36, so it is never shorter than the index plus 2
+  int minNameLength = 8;
+  int maxNameLength = 32;
+  NameLengthDistribution nameLength = NLD_UNIFORM;
+  // the share of the exports by ordinal only (NONAME), and of stdcall ones
+  // (Name@nn, decorated on x86), from 0 to 1
+  double ordinalOnly = 0;
+  double stdcall = 0;
+  // umbrella: the exports are spread over this many dlls in turn, those of
+  // the dlls after the first forwarded to synthetic1.Name, synthetic2.#5 ...
+  // (mkimplib --import-final imports them from there)
+  int dllCount = 1;
+};
+
+// symbols [first, first + count) of the set appended to m, m.arch set to
+// the spec's and its ESF_DERIVED symbols decorated for it
+// throws std::runtime_error for a bad spec
+void GenerateSyntheticSymbols(const SyntheticSpec &spec, size_t first,
+                              size_t count, CManifest &m);
+
+// the whole set
+void GenerateSyntheticManifest(const SyntheticSpec &spec, CManifest &m);
+
+// the set as JSON in the layout of WriteJsonManifest, or as a .def, made and
+// appended to out a chunk at a time. flush, if given, is handed out whenever
+// it grows past 1 MB and at the end, then out is cleared: a set of millions
+// of exports goes through little memory
+void WriteSyntheticManifest(
+    const SyntheticSpec &spec, bool def, std::string &out,
+    const std::function<void(const std::string &)> &flush = nullptr);
+}; // namespace Sora
+
+#endif
@@ -0,0 +1,237 @@
+// parse time of the manifest formats on the same export set
+//
+// usage: bench_manifest [--json <file>] [symbol count ...]
+//
+// parse: text in memory -> CManifest
+// feed: parse + AddImports, everything a format is responsible for
+// the binary manifest is written from the parsed JSON
+// filter: CSymbolFilter::Apply on the parsed manifest, for a few kinds of rules
+//
+// with --json every time is also written to the file as a JSON line:
+// {"bench": "manifest", "case": "parse_json", "n": 1000, "ms": 0.1, "ns_per_item": 100.0}
+
+#include "Manifest.h"
+#include "SymbolFilter.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace Sora;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+static FILE *jsonOut = 0;
+
+static void Record(const char *name, int n, double ms) {
+  if (jsonOut)
+    fprintf(jsonOut,
+            "{\"bench\": \"manifest\", \"case\": \"%s\", \"n\": %d, "
+            "\"ms\": %.3f, \"ns_per_item\": %.1f}\n",
+            name, n, ms, ms * 1e6 / n);
+}
+
+// n exports of an x64 dll, a quarter stdcall, a tenth by ordinal only
+static void MakeExportSet(int n, std::string &def, std::string &json) {
+  def = "LIBRARY bench.dll\nEXPORTS\n";
+  json = "{\n  \"dllname\": \"bench.dll\",\n  \"arch\": 64,\n  \"symbols\": [";
+
+  // line: the JSON entry holds the name three times
+  char name[32], line[256];
+  for (int i = 0; i < n; ++i) {
+    snprintf(name, sizeof(name), "BenchFunction%07dEx", i);
+    bool stdcall = i % 4 == 0;
+    bool noname = i % 10 == 0;
+    int ord = i + 1;
+
+    if (stdcall)
+      snprintf(line, sizeof(line), "  %s@%d @%d%s\n", name, (i % 8) * 4, ord,
+               noname ? " NONAME" : "");
+    else
+      snprintf(line, sizeof(line), "  %s @%d%s\n", name, ord,
+               noname ? " NONAME" : "");
+    def += line;
+
+    snprintf(line, sizeof(line),
+             "%s\n    {\n      \"cconv\": \"%s\",\n      \"name\": \"%s\",\n"
+             "      \"ord\": %d,\n      \"thunk\": \"%s\",\n"
+             "      \"pubname\": \"__imp_%s\"\n    }",
+             i ? "," : "", stdcall ? "STDCALL" : "CDECL", noname ? "" : name,
+             ord, name, name);
+    json += line;
+  }
+  json += "\n  ]\n}\n";
+}
+
+static std::vector<BYTE> Build(const CManifest &m) {
+  IImportLibraryBuilder *b = CreateImpLibBuilder(m);
+  AddImports(m, b);
+  b->Build();
+  std::vector<BYTE> r(b->GetDataLength());
+  b->GetRawData(r.data());
+  b->Dispose();
+  return r;
+}
+
+static std::string MakeBinary(const std::string &json) {
+  CManifest m;
+  ParseJsonManifest(json, m);
+  std::vector<BYTE> data;
+  WriteBinaryManifest(m, data);
+  return std::string(data.begin(), data.end());
+}
+
+enum Format { Def, Json, Binary };
+
+static void Parse(const std::string &text, Format format, CManifest &m,
+                  std::vector<char> &copy) {
+  if (format == Def)
+    ParseDefManifest(copy.data(), text.size(), 64, m, "bench.def");
+  else if (format == Json)
+    ParseJsonManifest(text, m);
+  else
+    ParseBinaryManifest((const BYTE *)text.data(), text.size(), m);
+}
+
+// all the formats must describe the same library
+static bool SameLibrary(int n) {
+  std::string def, json;
+  MakeExportSet(n, def, json);
+  std::string bin = MakeBinary(json);
+
+  std::vector<char> copy(def.begin(), def.end());
+  copy.push_back(0);
+
+  CManifest defManifest, jsonManifest, binManifest;
+  Parse(def, Def, defManifest, copy);
+  Parse(json, Json, jsonManifest, copy);
+  Parse(bin, Binary, binManifest, copy);
+
+  std::vector<BYTE> lib = Build(defManifest);
+  return lib == Build(jsonManifest) && lib == Build(binManifest);
+}
+
+// time of parse and parse + feed, in ms
+static void Run(const std::string &text, Format format, double *parse,
+                double *feed) {
+  // the .def parser works in place, the copy is not timed
+  std::vector<char> copy(text.begin(), text.end());
+  copy.push_back(0);
+
+  Clock::time_point start = Clock::now();
+  CManifest m;
+  Parse(text, format, m, copy);
+  *parse = MsSince(start);
+
+  IImportLibraryBuilder *b = CreateImpLibBuilder(m);
+  AddImports(m, b);
+  *feed = MsSince(start);
+  b->Dispose();
+}
+
+// time of Apply in ms, the kept symbols in *kept
+static double RunFilter(const std::string &bin, const CSymbolFilter &f,
+                        size_t *kept) {
+  CManifest m;
+  ParseBinaryManifest((const BYTE *)bin.data(), bin.size(), m);
+
+  Clock::time_point start = Clock::now();
+  f.Apply(m);
+  double ms = MsSince(start);
+  *kept = m.symbols.size();
+  return ms;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<int> counts;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      jsonOut = fopen(argv[++i], "w");
+      if (jsonOut == 0) {
+        printf("Fail to create %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else {
+      counts.push_back(atoi(argv[i]));
+    }
+  }
+  if (counts.empty()) {
+    counts.push_back(10000);
+    counts.push_back(100000);
+    counts.push_back(1000000);
+  }
+
+  if (!SameLibrary(1000)) {
+    printf("def, json and binary libraries differ\n");
+    return 1;
+  }
+
+  printf("%10s %6s %12s %10s %10s\n", "symbols", "format", "text bytes",
+         "parse ms", "feed ms");
+
+  for (size_t c = 0; c < counts.size(); ++c) {
+    std::string def, json;
+    MakeExportSet(counts[c], def, json);
+
+    std::string bin = MakeBinary(json);
+
+    double parse, feed;
+    Run(def, Def, &parse, &feed);
+    printf("%10d %6s %12zu %10.2f %10.2f\n", counts[c], "def", def.size(),
+           parse, feed);
+    Record("parse_def", counts[c], parse);
+    Record("feed_def", counts[c], feed);
+
+    Run(json, Json, &parse, &feed);
+    printf("%10d %6s %12zu %10.2f %10.2f\n", counts[c], "json", json.size(),
+           parse, feed);
+    Record("parse_json", counts[c], parse);
+    Record("feed_json", counts[c], feed);
+
+    Run(bin, Binary, &parse, &feed);
+    printf("%10d %6s %12zu %10.2f %10.2f\n", counts[c], "binary", bin.size(),
+           parse, feed);
+    Record("parse_binary", counts[c], parse);
+    Record("feed_binary", counts[c], feed);
+
+    // an allow list of every 100th name, globs, a regex
+    std::string names;
+    char name[64];
+    for (int i = 0; i < counts[c]; i += 100) {
+      snprintf(name, sizeof(name), "BenchFunction%07dEx\n", i + 1);
+      names += name;
+    }
+    CSymbolFilter allow, globs, regex;
+    allow.AddAllowList(names);
+    globs.Add(SR_EXCLUDE, "BenchFunction*5Ex");
+    globs.Add(SR_EXCLUDE, "BenchFunction0000*");
+    globs.Add(SR_NOSTUB, "*7Ex");
+    regex.Add(SR_INCLUDE, "re:BenchFunction\\d+[02468]Ex");
+
+    size_t kept;
+    double ms = RunFilter(bin, allow, &kept);
+    Record("filter_allow", counts[c], ms);
+    printf("%10d %6s %12zu %10.2f   allow list, %zu kept\n", counts[c],
+           "filter", names.size(), ms, kept);
+    ms = RunFilter(bin, globs, &kept);
+    Record("filter_globs", counts[c], ms);
+    printf("%10d %6s %12s %10.2f   3 globs, %zu kept\n", counts[c], "filter",
+           "", ms, kept);
+    ms = RunFilter(bin, regex, &kept);
+    Record("filter_regex", counts[c], ms);
+    printf("%10d %6s %12s %10.2f   regex, %zu kept\n", counts[c], "filter",
+           "", ms, kept);
+  }
+
+  if (jsonOut)
+    fclose(jsonOut);
+  return 0;
+}
@@ -0,0 +1,781 @@
+#include "BinaryManifest.h"
+#include "DllCache.h"
+#include "ExportCache.h"
+#include "Manifest.h"
+#include "Sha256.h"
+#include "SymbolFilter.h"
+#include "SyntheticManifest.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace Sora;
+
+static int failures = 0;
+
+static void Check(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+static const ExportSymbol *Find(const CManifest &m, const char *thunk) {
+  for (size_t i = 0; i < m.symbols.size(); ++i) {
+    if (m.symbols[i].thunk == thunk || m.symbols[i].pubname == thunk)
+      return &m.symbols[i];
+  }
+  return 0;
+}
+
+static std::string Sha256(const char *text) {
+  CSha256 hash;
+  hash.Update(text, strlen(text));
+  return hash.HexDigest();
+}
+
+static std::string HashOf(const CManifest &m) {
+  CSha256 hash;
+  HashManifest(m, hash);
+  return hash.HexDigest();
+}
+
+static std::vector<BYTE> Build(const CManifest &m) {
+  IImportLibraryBuilder *b = CreateImpLibBuilder(m);
+  AddImports(m, b);
+  b->Build();
+  std::vector<BYTE> r(b->GetDataLength());
+  b->GetRawData(r.data());
+  b->Dispose();
+  return r;
+}
+
+static const char defText[] = "; kernel32 subset\n"
+                              "LIBRARY kernel32\n"
+                              "EXPORTS\n"
+                              "  Sleep@4\n"
+                              "  @FastAdd@8 @3\n"
+                              "  ExitProcess@4=_ExitProcess@4 @ 2\n"
+                              "  Hidden @7 NONAME\n"
+                              "  SomeData DATA\n"
+                              "  Internal PRIVATE\n"
+                              "  ?Func@@YAXXZ\n";
+
+static const char jsonText[] = R"({
+  "dllname": "kernel32.dll", "arch": 64,
+  "symbols": [
+    {"cconv": "STDCALL", "name": "Sleep", "ord": 0,
+     "thunk": "Sleep", "pubname": "__imp_Sleep"},
+    {"cconv": "FASTCALL", "name": "FastAdd", "ord": 3,
+     "thunk": "FastAdd", "pubname": "__imp_FastAdd"},
+    {"cconv": "STDCALL", "name": "ExitProcess", "ord": 2,
+     "thunk": "ExitProcess", "pubname": "__imp_ExitProcess"},
+    {"cconv": "CDECL", "name": "", "ord": 7,
+     "thunk": "Hidden", "pubname": "__imp_Hidden"},
+    {"cconv": "CDECL", "name": "SomeData", "ord": 0,
+     "thunk": "", "pubname": "__imp_SomeData"},
+    {"name": "?Func@@YAXXZ", "ord": 0,
+     "thunk": "?Func@@YAXXZ", "pubname": "__imp_?Func@@YAXXZ"}
+  ]
+})";
+
+static void Put16(std::vector<BYTE> &b, size_t at, WORD v) {
+  memcpy(&b[at], &v, sizeof(v));
+}
+
+static void Put32(std::vector<BYTE> &b, size_t at, DWORD v) {
+  memcpy(&b[at], &v, sizeof(v));
+}
+
+// an x64 dll with one section holding the export table: Alpha, Beta
+// forwarded to NTDLL.RtlBeta and a third function exported by ordinal only
+static std::vector<BYTE> MakeDll() {
+  std::vector<BYTE> b(0x400);
+  Put16(b, 0, 0x5A4D);
+  Put32(b, 0x3C, 0x40);
+
+  Put32(b, 0x40, 0x4550);
+  Put16(b, 0x44, 0x8664); // Machine
+  Put16(b, 0x46, 1);      // NumberOfSections
+  Put16(b, 0x54, 240);    // SizeOfOptionalHeader
+
+  size_t opt = 0x58;
+  Put16(b, opt, 0x20B);
+  Put32(b, opt + 108, 16);     // NumberOfRvaAndSizes
+  Put32(b, opt + 112, 0x1000); // export table
+  Put32(b, opt + 116, 0x100);
+
+  size_t sec = opt + 240;
+  memcpy(&b[sec], ".edata", 6);
+  Put32(b, sec + 8, 0x200);  // VirtualSize
+  Put32(b, sec + 12, 0x1000); // VirtualAddress
+  Put32(b, sec + 16, 0x200); // SizeOfRawData
+  Put32(b, sec + 20, 0x200); // PointerToRawData
+
+  // rva 0x1000 is at 0x200 in the file
+  size_t dir = 0x200;
+  Put32(b, dir + 12, 0x1080); // Name
+  Put32(b, dir + 16, 5);      // Base
+  Put32(b, dir + 20, 3);      // NumberOfFunctions
+  Put32(b, dir + 24, 2);      // NumberOfNames
+  Put32(b, dir + 28, 0x1040); // AddressOfFunctions
+  Put32(b, dir + 32, 0x1050); // AddressOfNames
+  Put32(b, dir + 36, 0x1058); // AddressOfNameOrdinals
+
+  Put32(b, 0x240, 0x3000);
+  Put32(b, 0x244, 0x10A0); // forwarder
+  Put32(b, 0x248, 0x3010);
+  Put32(b, 0x250, 0x1090);
+  Put32(b, 0x254, 0x1098);
+  Put16(b, 0x258, 0);
+  Put16(b, 0x25A, 1);
+  strcpy((char *)&b[0x280], "inner.dll");
+  strcpy((char *)&b[0x290], "Alpha");
+  strcpy((char *)&b[0x298], "Beta");
+  strcpy((char *)&b[0x2A0], "NTDLL.RtlBeta");
+  return b;
+}
+
+// an x86 dll exporting the names in order from ordinal 1, an export with a
+// second string is forwarded there
+typedef std::vector<std::pair<std::string, std::string>> ExportList;
+
+static void WriteDll(const std::filesystem::path &path,
+                     const ExportList &exports) {
+  DWORD n = (DWORD)exports.size();
+  std::vector<BYTE> b(0x200);
+  Put16(b, 0, 0x5A4D);
+  Put32(b, 0x3C, 0x40);
+  Put32(b, 0x40, 0x4550);
+  Put16(b, 0x44, 0x14C);
+  Put16(b, 0x46, 1);
+  Put16(b, 0x54, 224);
+  size_t opt = 0x58;
+  Put16(b, opt, 0x10B);
+  Put32(b, opt + 92, 16);
+
+  // directory, functions, names, ordinals, strings at rva 0x1000
+  DWORD functions = 40, names = functions + 4 * n, ordinals = names + 4 * n,
+        strings = ordinals + 2 * n;
+  std::vector<BYTE> e(strings);
+  Put32(e, 16, 1);
+  Put32(e, 20, n);
+  Put32(e, 24, n);
+  Put32(e, 28, 0x1000 + functions);
+  Put32(e, 32, 0x1000 + names);
+  Put32(e, 36, 0x1000 + ordinals);
+  for (DWORD i = 0; i < n; ++i) {
+    const std::string &name = exports[i].first, &to = exports[i].second;
+    Put32(e, names + 4 * i, 0x1000 + (DWORD)e.size());
+    e.insert(e.end(), name.c_str(), name.c_str() + name.size() + 1);
+    Put16(e, ordinals + 2 * i, (WORD)i);
+    if (to.empty()) {
+      Put32(e, functions + 4 * i, 0x3000);
+    } else {
+      Put32(e, functions + 4 * i, 0x1000 + (DWORD)e.size());
+      e.insert(e.end(), to.c_str(), to.c_str() + to.size() + 1);
+    }
+  }
+  Put32(b, opt + 96, 0x1000);
+  Put32(b, opt + 100, (DWORD)e.size());
+
+  size_t sec = opt + 224;
+  Put32(b, sec + 8, (DWORD)e.size());
+  Put32(b, sec + 12, 0x1000);
+  Put32(b, sec + 16, (DWORD)e.size());
+  Put32(b, sec + 20, 0x200);
+  b.insert(b.end(), e.begin(), e.end());
+  std::ofstream(path, std::ios::binary).write((const char *)b.data(), b.size());
+}
+
+static bool Contains(const std::vector<BYTE> &data, const std::string &s) {
+  return std::search(data.begin(), data.end(), s.begin(), s.end()) !=
+         data.end();
+}
+
+static const char dllJson[] = R"({
+  "dllname": "test.dll", "arch": 64,
+  "symbols": [
+    {"cconv": "STDCALL", "name": "Alpha", "ord": 5,
+     "thunk": "Alpha", "pubname": "__imp_Alpha"},
+    {"cconv": "STDCALL", "name": "Beta", "ord": 6,
+     "thunk": "Beta", "pubname": "__imp_Beta"}
+  ]
+})";
+
+int main() {
+  // x86 decoration
+  {
+    std::vector<char> text(defText, defText + sizeof(defText));
+    CManifest m;
+    ParseDefManifest(text.data(), text.size() - 1, 32, m, "k32.def");
+
+    Check(m.dllName == "kernel32.dll", "dll name");
+    Check(m.symbols.size() == 6, "private export left out");
+
+    const ExportSymbol *e = Find(m, "_Sleep@4");
+    Check(e && e->name == "Sleep" && e->pubname == "__imp__Sleep@4" &&
+              e->name.data()[e->name.size()] == 0,
+          "stdcall");
+    e = Find(m, "@FastAdd@8");
+    Check(e && e->name == "FastAdd" && e->ord == 3, "fastcall");
+    e = Find(m, "_ExitProcess@4");
+    Check(e && e->ord == 2, "internal name, spaced ordinal");
+    e = Find(m, "_Hidden");
+    Check(e && (e->flags & ESF_NONAME) && e->ord == 7, "noname");
+    e = Find(m, "__imp__SomeData");
+    Check(e && e->thunk.empty(), "data");
+    e = Find(m, "?Func@@YAXXZ");
+    Check(e && e->pubname == "__imp_?Func@@YAXXZ", "c++ name");
+  }
+
+  // ordinals out of the WORD range of the import objects
+  {
+    const char *bad[] = {"Foo @70000", "Foo @65536 NONAME", "Foo @0",
+                         "Foo @-1", "Foo @99999999999"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+      std::string def = std::string("EXPORTS\n") + bad[i] + "\n";
+      std::string msg;
+      try {
+        CManifest m;
+        ParseDefManifest(&def[0], def.size(), 32, m, "o.def");
+      } catch (std::exception &e) {
+        msg = e.what();
+      }
+      Check(msg == "o.def:2: bad ordinal", bad[i]);
+    }
+
+    char max[] = "EXPORTS\nFoo @65535 NONAME\n";
+    CManifest m;
+    ParseDefManifest(max, sizeof(max) - 1, 32, m, "o.def");
+    Check(m.symbols.size() == 1 && m.symbols[0].ord == 65535,
+          "highest ordinal");
+  }
+
+  // on x64 the .def and the equivalent JSON give the same library
+  {
+    std::vector<char> text(defText, defText + sizeof(defText));
+    CManifest def;
+    ParseDefManifest(text.data(), text.size() - 1, 64, def, "k32.def");
+
+    CManifest json;
+    ParseJsonManifest(jsonText, json);
+
+    Check(Build(def) == Build(json), "def and json libraries differ");
+    Check(HashOf(def) == HashOf(json), "def and json hash differently");
+  }
+
+  // one parse, decorated for each target like a parse for that target
+  {
+    std::vector<char> text32(defText, defText + sizeof(defText));
+    std::vector<char> text64 = text32;
+    CManifest def32, def64;
+    ParseDefManifest(text32.data(), text32.size() - 1, 32, def32, "k32.def");
+    ParseDefManifest(text64.data(), text64.size() - 1, 64, def64, "k32.def");
+
+    CManifest to64, to32;
+    RetargetManifest(def32, 64, to64);
+    RetargetManifest(to64, 32, to32);
+    Check(Build(to64) == Build(def64), "x86 retargeted to x64");
+    Check(Build(to32) == Build(def32), "x64 retargeted to x86");
+  }
+
+  // binary and JSON writers keep everything the library is made of
+  {
+    std::vector<char> text(defText, defText + sizeof(defText));
+    CManifest def;
+    ParseDefManifest(text.data(), text.size() - 1, 32, def, "k32.def");
+
+    std::vector<BYTE> data;
+    WriteBinaryManifest(def, data);
+    CManifest bin;
+    ParseBinaryManifest(data.data(), data.size(), bin, "k32.bmf");
+    Check(HashOf(bin) == HashOf(def) && Build(bin) == Build(def),
+          "binary manifest round trip");
+
+    // the .def names are decorated again for another target
+    CManifest def64, bin64;
+    RetargetManifest(def, 64, def64);
+    RetargetManifest(bin, 64, bin64);
+    Check(Build(bin64) == Build(def64), "binary manifest retargeted");
+
+    const ExportSymbol *e = Find(bin, "_Sleep@4");
+    Check(e && e->name == "Sleep" && e->pubname == "__imp__Sleep@4" &&
+              e->argBytes == 4 && e->cconv == "STDCALL" &&
+              e->thunk.data()[e->thunk.size()] == 0,
+          "binary manifest symbol");
+
+    std::string json;
+    WriteJsonManifest(bin, json);
+    CManifest back;
+    ParseJsonManifest(json, back);
+    Check(HashOf(back) == HashOf(def), "json round trip");
+
+    // escaped like json.dump of dumpsyms.py does it, ASCII only
+    CManifest odd;
+    odd.dllName = "odd.dll";
+    ExportSymbol s = {};
+    s.name = "Quote\"Tab\tCaf\xC3\xA9\xF0\x9F\x98\x80";
+    s.thunk = s.name;
+    s.pubname = "__imp_x";
+    odd.symbols.push_back(s);
+    std::string oddJson;
+    WriteJsonManifest(odd, oddJson);
+    CManifest oddBack;
+    ParseJsonManifest(oddJson, oddBack);
+    Check(oddJson.find("\"Quote\\\"Tab\\tCaf\\u00e9\\ud83d\\ude00\"") !=
+                  std::string::npos &&
+              oddBack.symbols.size() == 1 &&
+              oddBack.symbols[0].name == s.name,
+          "json escapes");
+
+    // the file of a stream line, read before the line is parsed
+    std::string line = "{\"file\": ";
+    AppendJsonString(line, "sub/q\"\\Caf\xC3\xA9.dll");
+    line += ", " + oddJson.substr(1);
+    std::string file;
+    CManifest streamed;
+    ParseJsonManifest(line, streamed);
+    Check(ParseJsonStreamFile(line, file) &&
+              file == "sub/q\"\\Caf\xC3\xA9.dll" &&
+              streamed.symbols.size() == 1,
+          "stream line");
+    Check(!ParseJsonStreamFile(oddJson, file) &&
+              !ParseJsonStreamFile("{\"file\": \"a\\", file),
+          "stream line without file");
+
+    data[0] = 'X';
+    std::string msg;
+    try {
+      CManifest bad;
+      ParseBinaryManifest(data.data(), data.size(), bad, "bad.bmf");
+    } catch (std::exception &e) {
+      msg = e.what();
+    }
+    Check(msg.find("bad.bmf: ") == 0, "bad binary manifest");
+
+    // an architecture the builder doesn't know
+    data[0] = 'S';
+    BinaryManifestHeader h;
+    memcpy(&h, data.data(), sizeof(h));
+    h.arch = 16;
+    memcpy(data.data(), &h, sizeof(h));
+    msg.clear();
+    try {
+      CManifest bad;
+      ParseBinaryManifest(data.data(), data.size(), bad, "arch.bmf");
+    } catch (std::exception &e) {
+      msg = e.what();
+    }
+    Check(msg.find("arch.bmf: ") == 0, "binary manifest architecture");
+  }
+
+  // in memory, every format recognized by its content
+  {
+    std::vector<char> text(defText, defText + sizeof(defText));
+    CManifest def;
+    ParseManifest(text.data(), text.size() - 1, 64, def, "k32");
+
+    std::vector<char> json(jsonText, jsonText + sizeof(jsonText) - 1);
+    json.insert(json.begin(), '\n');
+    CManifest fromJson;
+    ParseManifest(json.data(), json.size(), 0, fromJson);
+
+    std::vector<BYTE> data;
+    WriteBinaryManifest(def, data);
+    CManifest bin;
+    ParseManifest((char *)data.data(), data.size(), 0, bin);
+
+    std::vector<BYTE> dll = MakeDll();
+    CManifest image;
+    ParseManifest((char *)dll.data(), dll.size(), 0, image);
+
+    Check(HashOf(def) == HashOf(fromJson) && HashOf(def) == HashOf(bin),
+          "manifest format by content");
+    Check(image.dllName == "inner.dll" && image.symbols.size() == 2,
+          "dll by content");
+  }
+
+  // FIPS 180-4 examples
+  Check(Sha256("abc") == "ba7816bf8f01cfea414140de5dae2223"
+                         "b00361a396177a9cb410ff61f20015ad",
+        "sha256 one block");
+  Check(Sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+            "248d6a61d20638b8e5c026930c3e6039"
+            "a33ce45964ff2167f6ecedd419db06c1",
+        "sha256 two blocks");
+
+  // errors carry the position
+  {
+    char bad[] = "EXPORTS\nFoo @x\n";
+    CManifest m;
+    std::string msg;
+    try {
+      ParseDefManifest(bad, strlen(bad), 32, m, "bad.def");
+    } catch (std::exception &e) {
+      msg = e.what();
+    }
+    Check(msg.find("bad.def:2:") == 0, "error position");
+  }
+
+  // export table of a dll, the same library as from its dumpsyms JSON
+  {
+    std::vector<BYTE> dll = MakeDll();
+    CManifest m;
+    ParseDllManifest(dll.data(), dll.size(), m, "dir/test.dll");
+
+    Check(m.dllName == "test.dll" && m.arch == 64, "dll name and arch");
+    Check(m.symbols.size() == 2, "named exports only");
+
+    const ExportSymbol *e = Find(m, "Beta");
+    Check(e && e->ord == 6 && e->pubname == "__imp_Beta" &&
+              e->forward == "NTDLL.RtlBeta",
+          "forwarded export");
+    e = Find(m, "Alpha");
+    Check(e && e->ord == 5 && e->forward.empty(), "exported function");
+
+    CManifest json;
+    ParseJsonManifest(dllJson, json);
+    Check(Build(m) == Build(json), "dll and json libraries differ");
+
+    std::vector<BYTE> data;
+    WriteBinaryManifest(m, data);
+    CManifest bin;
+    ParseBinaryManifest(data.data(), data.size(), bin);
+    e = Find(bin, "Beta");
+    Check(e && e->forward == "NTDLL.RtlBeta", "forward in binary manifest");
+
+    CManifest unnamed;
+    ParseDllManifest(dll.data(), dll.size(), unnamed);
+    Check(unnamed.dllName == "inner.dll", "dll name from the export table");
+
+    std::string msg;
+    try {
+      CManifest cut;
+      ParseDllManifest(dll.data(), 0x260, cut, "cut.dll");
+    } catch (std::exception &e) {
+      msg = e.what();
+    }
+    Check(msg.find("cut.dll: ") == 0, "truncated image");
+
+    // the headers alone
+    PeHeader h;
+    Check(ParsePeHeader(dll.data(), 0x200, h) && h.machine == 0x8664 &&
+              h.arch == 64 && h.exportRva == 0x1000 && h.exportSize == 0x100,
+          "pe header");
+    Check(!ParsePeHeader(dll.data(), 0x80, h), "truncated pe header");
+    Put32(dll, 0x58 + 116, 0);
+    Check(ParsePeHeader(dll.data(), dll.size(), h) && h.exportSize == 0,
+          "pe header without exports");
+    const BYTE text[] = "MZ is not enough";
+    Check(!ParsePeHeader(text, sizeof(text), h), "not a pe image");
+
+    // PE32+ is not enough for x64: an ARM64 dll has no import library here
+    std::vector<BYTE> arm64 = MakeDll();
+    Put16(arm64, 0x44, 0xAA64);
+    Check(ParsePeHeader(arm64.data(), arm64.size(), h) && h.arch == 0,
+          "arm64 pe header");
+    msg.clear();
+    try {
+      CManifest a;
+      ParseDllManifest(arm64.data(), arm64.size(), a, "arm64.dll");
+    } catch (std::exception &e) {
+      msg = e.what();
+    }
+    Check(msg == "arm64.dll: Unsupported machine 0xaa64, not i386 or amd64",
+          "arm64 dll");
+  }
+
+  // name patterns
+  {
+    CNameMatcher g;
+    g.Add("Rtl*");
+    g.Add("a*b*c");
+    g.Add("Get?");
+    g.AddName("Odd*Name");
+    Check(g.Matches("RtlAllocateHeap") && g.Matches("Rtl") &&
+              !g.Matches("XRtl"),
+          "glob prefix");
+    Check(g.Matches("abc") && g.Matches("aXbYc") && g.Matches("abbcbc") &&
+              !g.Matches("acb") && !g.Matches("abcd"),
+          "glob stars");
+    Check(g.Matches("GetX") && !g.Matches("Get") && !g.Matches("GetXY"),
+          "glob question mark");
+    Check(g.Matches("Odd*Name") && !g.Matches("OddName"), "literal name");
+
+    CNameMatcher r;
+    r.Add("re:Nt[A-Z]\\w+");
+    r.Add("re:.*W");
+    Check(r.Matches("NtClose") && r.Matches("CreateFileW") &&
+              !r.Matches("NtcClose") && !r.Matches("CreateFileWEx"),
+          "regexes match whole names");
+
+    std::string msg;
+    try {
+      r.Add("re:(");
+    } catch (std::exception &e) {
+      msg = e.what();
+    }
+    Check(msg.find("Bad regular expression") == 0, "bad regex");
+  }
+
+  // symbol filter
+  {
+    std::vector<char> text(defText, defText + sizeof(defText));
+    CManifest m;
+    ParseDefManifest(text.data(), text.size() - 1, 32, m, "kernel32.def");
+
+    CManifest all;
+    RetargetManifest(m, 32, all);
+
+    CSymbolFilter f;
+    f.Add(SR_EXCLUDE, "*Add");
+    f.Add(SR_NOSTUB, "Exit*");
+    f.Apply(m);
+    Check(m.symbols.size() == 5 && Find(m, "@FastAdd@8") == 0, "exclude");
+    const ExportSymbol *e = Find(m, "__imp__ExitProcess@4");
+    Check(e && e->thunk.empty() && (e->flags & ESF_NOSTUB), "no stub");
+
+    CManifest to64;
+    RetargetManifest(m, 64, to64);
+    e = Find(to64, "__imp_ExitProcess");
+    Check(e && e->thunk.empty(), "no stub when retargeted");
+    Check(Find(to64, "Sleep") != 0, "stubs of the others when retargeted");
+
+    CSymbolFilter allow;
+    allow.AddAllowList("# used by the app\nHidden\n\n  Sleep \r\n");
+    allow.Apply(all);
+    Check(all.symbols.size() == 2 && all.symbols[0].name == "Sleep" &&
+              all.symbols[1].name == "Hidden",
+          "allow list keeps the order");
+
+    CManifest json;
+    ParseJsonManifest(jsonText, json);
+    CSymbolFilter byOrdinal;
+    byOrdinal.Add(SR_INCLUDE, "re:Hid.*");
+    byOrdinal.Add(SR_INCLUDE, "Some*");
+    byOrdinal.Apply(json);
+    Check(json.symbols.size() == 2 && json.symbols[0].ord == 7,
+          "ordinal only exports match their thunk");
+  }
+
+  // forwarder chains across dlls: a -> b -> c in a search directory, by
+  // ordinal, a cycle and a dll that isn't there. the dll names are matched
+  // in any case
+  {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "test_manifest_forwarders";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "more");
+    WriteDll(dir / "a.dll", {{"Bar", "B.#2"},
+                             {"Foo", "B.Foo"},
+                             {"Gone", "D.Gone"},
+                             {"Loop", "B.Loop"},
+                             {"Own", ""}});
+    WriteDll(dir / "B.DLL",
+             {{"Baz", ""}, {"Baz2", ""}, {"Foo", "c.Foo2"}, {"Loop", "A.Loop"}});
+    WriteDll(dir / "more" / "c.dll", {{"Foo2", ""}});
+    std::string a = (dir / "a.dll").string();
+
+    CExportCache cache({(dir / "more").string()});
+    ForwarderTarget t = cache.Resolve("B.Foo", a);
+    Check(t.found && t.target == "c.Foo2" && t.hops == 1, "forwarder chain");
+    t = cache.Resolve("B.#2", a);
+    Check(t.found && t.target == "B.#2" && t.hops == 0, "forward by ordinal");
+    t = cache.Resolve("B.Loop", a);
+    Check(!t.found && t.target == "A.Loop" && t.hops == 1, "forwarder cycle");
+    t = cache.Resolve("D.Gone", a);
+    Check(!t.found && t.target == "D.Gone", "dll not found");
+
+    // every dll parsed once, whichever thread asks first
+    CManifest m[4];
+    size_t found[4];
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      LoadDllManifest(a.c_str(), m[i]);
+      threads.emplace_back(
+          [&, i]() { found[i] = cache.ResolveManifest(m[i], a); });
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+      threads[i].join();
+    Check(found[0] == 2 && found[3] == 2 && cache.GetParsedCount() == 3 &&
+              cache.Load(a) != 0 && cache.GetParsedCount() == 3,
+          "dlls parsed once");
+
+    const ExportSymbol *e = Find(m[0], "Foo");
+    Check(e && e->forward == "B.Foo" && e->target == "c.Foo2",
+          "resolved target");
+    Check(Find(m[0], "Own")->target.empty(), "no target without forwarder");
+
+    // kept by both formats, imported from by ESF_TARGET only
+    std::string json;
+    WriteJsonManifest(m[0], json);
+    CManifest fromJson;
+    ParseJsonManifest(json, fromJson);
+    std::vector<BYTE> data;
+    WriteBinaryManifest(m[0], data);
+    CManifest bin;
+    ParseBinaryManifest(data.data(), data.size(), bin);
+    e = Find(bin, "Foo");
+    Check(Find(fromJson, "Foo")->target == "c.Foo2" && e &&
+              e->target == "c.Foo2" && e->forward == "B.Foo",
+          "target round trip");
+    Check(HashOf(bin) == HashOf(m[0]), "target alone doesn't change the hash");
+
+    std::vector<BYTE> plain = Build(bin);
+    for (size_t i = 0; i < bin.symbols.size(); ++i) {
+      if (!bin.symbols[i].target.empty())
+        bin.symbols[i].flags |= ESF_TARGET;
+    }
+    std::vector<BYTE> direct = Build(bin);
+    Check(!Contains(plain, "c.dll") && Contains(direct, "c.dll") &&
+              Contains(direct, "\x7f" "c.dll_NULL_THUNK_DATA") &&
+              Contains(direct, "\x7f" "a.dll_NULL_THUNK_DATA"),
+          "import from the target dll");
+    Check(HashOf(bin) != HashOf(m[0]), "imports from targets change the hash");
+
+    fs::remove_all(dir);
+  }
+
+  // persistent dll cache: keyed on the headers and the file size, the
+  // content only with hashContent
+  {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "test_manifest_dllcache";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string a = (dir / "a.dll").string();
+    std::string copy = (dir / "copy.dll").string();
+    WriteDll(a, {{"Bar", "B.Baz"}, {"Foo", ""}});
+
+    CDllCache cache((dir / "cache").string(), false);
+    PeHeader h;
+    CManifest parsed, first, second;
+    LoadDllManifest(a.c_str(), parsed);
+    Check(ReadPeHeader(a.c_str(), h), "dll header");
+    cache.Load(a, h, first);
+    cache.Load(a, h, second);
+    Check(cache.GetHits() == 1 && cache.GetMisses() == 1, "dll cache hit");
+    Check(HashOf(second) == HashOf(parsed) && second.dllName == "a.dll" &&
+              Find(second, "Bar")->forward == "B.Baz",
+          "cached exports");
+
+    fs::copy_file(a, copy);
+    CManifest copied;
+    cache.Load(copy, h, copied);
+    Check(cache.GetHits() == 2 && copied.dllName == "copy.dll",
+          "dll name of a copy");
+
+    // the file size changes, a same size change is only seen by the hash
+    WriteDll(a, {{"Bar", "B.Baz"}, {"Foo", ""}, {"New", ""}});
+    CManifest grown;
+    Check(ReadPeHeader(a.c_str(), h), "dll header");
+    cache.Load(a, h, grown);
+    Check(cache.GetMisses() == 2 && grown.symbols.size() == 3,
+          "dll cache miss");
+
+    WriteDll(a, {{"Bar", "B.Baz"}, {"Fox", ""}, {"New", ""}});
+    CDllCache hashed((dir / "hashed").string(), true);
+    CManifest stale, fresh, again;
+    cache.Load(a, h, stale);
+    hashed.Load(a, h, fresh);
+    hashed.Load(a, h, again);
+    Check(Find(stale, "Foo") != 0 && Find(fresh, "Fox") != 0 &&
+              Find(again, "Fox") != 0 && hashed.GetHits() == 1,
+          "content hash");
+
+    // a bad entry is a miss and is replaced
+    for (fs::recursive_directory_iterator i(dir / "hashed"), iend; i != iend;
+         ++i) {
+      if (i->is_regular_file())
+        std::ofstream(i->path(), std::ios::binary) << "bad";
+    }
+    CManifest repaired;
+    hashed.Load(a, h, repaired);
+    Check(hashed.GetMisses() == 2 && Find(repaired, "Fox") != 0,
+          "bad cache entry");
+
+    // forwarder resolution loads through the store
+    WriteDll(dir / "b.dll", {{"Baz", ""}});
+    CExportCache exports(std::vector<std::string>(), &hashed);
+    CManifest m;
+    hashed.Load(a, h, m);
+    Check(exports.ResolveManifest(m, a) == 1 && hashed.GetMisses() == 3,
+          "export cache with a store");
+
+    fs::remove_all(dir);
+  }
+
+  // synthetic export sets: the same for a seed, .def and JSON the same set
+  {
+    SyntheticSpec spec;
+    spec.count = 3000;
+    spec.arch = 32;
+    spec.seed = 42;
+    spec.minNameLength = 4;
+    spec.maxNameLength = 200;
+    spec.nameLength = NLD_SKEWED;
+    spec.ordinalOnly = 0.2;
+    spec.stdcall = 0.3;
+    spec.dllCount = 3;
+
+    std::string json, def, flushed, again, reseeded;
+    WriteSyntheticManifest(spec, false, json);
+    WriteSyntheticManifest(spec, true, def);
+    WriteSyntheticManifest(spec, false, again,
+                           [&](const std::string &t) { flushed += t; });
+    spec.seed = 43;
+    WriteSyntheticManifest(spec, false, reseeded);
+    spec.seed = 42;
+    Check(again.empty() && flushed == json && reseeded != json,
+          "synthetic set reproducible");
+
+    CManifest fromJson, fromDef, generated, part;
+    ParseJsonManifest(json, fromJson);
+    std::vector<char> text(def.begin(), def.end());
+    ParseDefManifest(text.data(), text.size(), 32, fromDef, "synthetic.def");
+    GenerateSyntheticManifest(spec, generated);
+    Check(fromJson.symbols.size() == 3000 && fromDef.symbols.size() == 3000,
+          "synthetic count");
+    Check(HashOf(fromJson) == HashOf(fromDef) &&
+              HashOf(generated) == HashOf(fromJson) &&
+              Build(fromJson) == Build(fromDef),
+          "synthetic def and json the same set");
+
+    GenerateSyntheticSymbols(spec, 1000, 10, part);
+    Check(part.symbols.size() == 10 &&
+              part.symbols[3].pubname == generated.symbols[1003].pubname,
+          "synthetic range alone");
+
+    size_t noname = 0, stdcall = 0, forwarded = 0, shortest = 1000,
+           longest = 0;
+    std::unordered_set<std::string_view> names;
+    for (size_t i = 0; i < generated.symbols.size(); ++i) {
+      const ExportSymbol &e = generated.symbols[i];
+      noname += (e.flags & ESF_NONAME) != 0;
+      stdcall += e.cconv == "STDCALL" && e.thunk.find('@') != 0;
+      forwarded += !e.forward.empty();
+      shortest = std::min(shortest, e.name.size());
+      longest = std::max(longest, e.name.size());
+      names.insert(e.name);
+    }
+    Check(noname > 450 && noname < 750 && stdcall > 750 && stdcall < 1050,
+          "synthetic fractions");
+    Check(forwarded == 2000 &&
+              generated.symbols[1].forward.substr(0, 11) == "synthetic1.",
+          "synthetic forwarders");
+    Check(names.size() == 3000 && shortest >= 4 && longest <= 200 &&
+              longest > 50,
+          "synthetic names");
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace Sora {
+// a queue between the stages of a pipeline, holding at most a fixed number
+// of items: a producer blocks while it is full, a consumer while it is empty.
+// a slow stage so holds up the ones before it instead of letting the items
+// pile up, down to a pipe or a socket that stops being read.
+template <class T> class CBoundedQueue {
+public:
+  explicit CBoundedQueue(size_t capacity)
+      : m_capacity(capacity ? capacity : 1), m_closed(false) {}
+
+  // blocks while the queue is full
+  // return: false if the queue was closed, the item is dropped
+  bool Push(T item) {
+    std::unique_lock<std::mutex> l(m_lock);
+    m_notFull.wait(l,
+                   [this] { return m_closed || m_items.size() < m_capacity; });
+    if (m_closed)
+      return false;
+    m_items.push_back(std::move(item));
+    m_notEmpty.notify_one();
+    return true;
+  }
+
+  // blocks while the queue is empty and open
+  // return: false once the queue is closed and empty
+  bool Pop(T &item) {
+    std::unique_lock<std::mutex> l(m_lock);
+    m_notEmpty.wait(l, [this] { return m_closed || !m_items.empty(); });
+    if (m_items.empty())
+      return false;
+    item = std::move(m_items.front());
+    m_items.pop_front();
+    m_notFull.notify_one();
+    return true;
+  }
+
+  // the items queued now, may have changed by the time it returns
+  size_t Size() {
+    std::lock_guard<std::mutex> l(m_lock);
+    return m_items.size();
+  }
+
+  // no more items: the consumers get what is queued, then false. the
+  // producers get false, also when a consumer closes the queue to give up
+  void Close() {
+    std::lock_guard<std::mutex> l(m_lock);
+    m_closed = true;
+    m_notFull.notify_all();
+    m_notEmpty.notify_all();
+  }
+
+private:
+  size_t m_capacity;
+  bool m_closed;
+  std::deque<T> m_items;
+  std::mutex m_lock;
+  std::condition_variable m_notFull;
+  std::condition_variable m_notEmpty;
+
+  CBoundedQueue(const CBoundedQueue &);
+  CBoundedQueue &operator=(const CBoundedQueue &);
+};
+}; // namespace Sora
+
+#endif
@@ -0,0 +1,165 @@
+#include "WorkPool.h"
+
+#include <chrono>
+
+namespace Sora {
+// the pool and the worker index of the current thread
+static thread_local CWorkPool *t_pool = 0;
+static thread_local int t_index = -1;
+
+CWorkPool::CWorkPool(int nThreads) : m_queued(0), m_next(0), m_stop(false) {
+  if (nThreads <= 0)
+    nThreads = std::thread::hardware_concurrency();
+  if (nThreads <= 0)
+    nThreads = 1;
+
+  for (int i = 0; i < nThreads; ++i)
+    m_workers.emplace_back(new Worker);
+
+  for (int i = 0; i < nThreads; ++i)
+    m_threads.emplace_back(&CWorkPool::WorkerMain, this, i);
+}
+
+CWorkPool::~CWorkPool() {
+  {
+    std::lock_guard<std::mutex> l(m_sleepLock);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+
+  std::vector<std::thread>::iterator i, iend;
+  for (i = m_threads.begin(), iend = m_threads.end(); i != iend; ++i)
+    i->join();
+}
+
+int CWorkPool::GetSelfIndex() const { return t_pool == this ? t_index : -1; }
+
+void CWorkPool::Submit(Task task) {
+  int self = GetSelfIndex();
+  int target = self >= 0 ? self : (int)(m_next++ % m_workers.size());
+
+  {
+    Worker &w = *m_workers[target];
+    std::lock_guard<std::mutex> l(w.lock);
+    w.tasks.push_back(std::move(task));
+  }
+
+  {
+    // counted under the sleep lock so a worker about to sleep can't miss it
+    std::lock_guard<std::mutex> l(m_sleepLock);
+    ++m_queued;
+  }
+  m_wake.notify_one();
+}
+
+bool CWorkPool::Pop(int self, Task &task) {
+  int cnt = m_workers.size();
+
+  // own deque first, newest task: its data is still hot in cache
+  if (self >= 0) {
+    Worker &w = *m_workers[self];
+    std::lock_guard<std::mutex> l(w.lock);
+    if (!w.tasks.empty()) {
+      task = std::move(w.tasks.back());
+      w.tasks.pop_back();
+      --m_queued;
+      return true;
+    }
+  }
+
+  // steal the oldest task of another worker
+  int start = self >= 0 ? self + 1 : (int)(m_next % cnt);
+  for (int i = 0; i < cnt; ++i) {
+    int victim = (start + i) % cnt;
+    if (victim == self)
+      continue;
+
+    Worker &w = *m_workers[victim];
+    std::lock_guard<std::mutex> l(w.lock);
+    if (!w.tasks.empty()) {
+      task = std::move(w.tasks.front());
+      w.tasks.pop_front();
+      --m_queued;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool CWorkPool::TryRunOne() {
+  Task task;
+  if (!Pop(GetSelfIndex(), task))
+    return false;
+
+  task();
+  return true;
+}
+
+void CWorkPool::WorkerMain(int index) {
+  t_pool = this;
+  t_index = index;
+
+  for (;;) {
+    Task task;
+    if (Pop(index, task)) {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> l(m_sleepLock);
+    m_wake.wait(l, [this] { return m_stop || m_queued > 0; });
+    if (m_stop && m_queued <= 0)
+      break;
+  }
+}
+
+CTaskGroup::~CTaskGroup() {
+  try {
+    Wait();
+  } catch (...) {
+  }
+}
+
+void CTaskGroup::Run(CWorkPool::Task task) {
+  ++m_pending;
+
+  m_pool.Submit([this, task]() {
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard<std::mutex> l(m_lock);
+      if (!m_error)
+        m_error = std::current_exception();
+    }
+
+    // decremented under the lock: once Wait() got the lock after seeing 0,
+    // nothing touches the group anymore
+    std::lock_guard<std::mutex> l(m_lock);
+    if (--m_pending == 0)
+      m_done.notify_all();
+  });
+}
+
+void CTaskGroup::Wait() {
+  while (m_pending > 0) {
+    if (m_pool.TryRunOne())
+      continue;
+
+    // nothing to help with: sleep until the group finishes, but look for
+    // new work from time to time, our tasks may queue more of it
+    std::unique_lock<std::mutex> l(m_lock);
+    m_done.wait_for(l, std::chrono::milliseconds(1),
+                    [this] { return m_pending == 0; });
+  }
+
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> l(m_lock);
+    std::swap(error, m_error);
+  }
+
+  if (error)
+    std::rethrow_exception(error);
+}
+}; // namespace Sora
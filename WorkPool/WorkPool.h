@@ -0,0 +1,91 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Sora {
+// a fixed set of worker threads. every worker owns a task deque: it pops its
+// own tasks from the back and steals from the front of the others' deques
+// when it runs out of work.
+class CWorkPool {
+public:
+  typedef std::function<void()> Task;
+
+  // nThreads <= 0: one worker per hardware thread
+  explicit CWorkPool(int nThreads = 0);
+
+  // runs all queued tasks, then joins the workers
+  ~CWorkPool();
+
+  int GetThreadCount() const { return (int)m_threads.size(); }
+
+  // the tasks submitted and not started yet
+  int GetQueuedCount() const { return m_queued; }
+
+  // tasks submitted from a worker go to that worker's own deque.
+  // a task must not throw, use CTaskGroup if it may.
+  void Submit(Task task);
+
+  // run one queued task on the calling thread.
+  // return: false if there was nothing to run
+  bool TryRunOne();
+
+private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_sleepLock;
+  std::condition_variable m_wake;
+  std::atomic<int> m_queued;
+  std::atomic<unsigned> m_next;
+  bool m_stop;
+
+  CWorkPool(const CWorkPool &);
+  CWorkPool &operator=(const CWorkPool &);
+
+  int GetSelfIndex() const;
+  bool Pop(int self, Task &task);
+  void WorkerMain(int index);
+};
+
+// a set of tasks run on a pool which can be waited for together.
+// Wait() runs queued tasks on the calling thread instead of blocking it, so a
+// task may open a group of its own without starving the pool.
+class CTaskGroup {
+public:
+  explicit CTaskGroup(CWorkPool &pool) : m_pool(pool), m_pending(0) {}
+
+  // waits, an exception left in the group is dropped
+  ~CTaskGroup();
+
+  void Run(CWorkPool::Task task);
+
+  // the first exception thrown by a task of the group is rethrown here
+  void Wait();
+
+private:
+  CWorkPool &m_pool;
+  std::atomic<int> m_pending;
+  std::mutex m_lock;
+  std::condition_variable m_done;
+  std::exception_ptr m_error;
+
+  CTaskGroup(const CTaskGroup &);
+  CTaskGroup &operator=(const CTaskGroup &);
+};
+}; // namespace Sora
+
+#endif
@@ -0,0 +1,97 @@
+#include "BoundedQueue.h"
+#include "WorkPool.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+
+using namespace Sora;
+
+int main() {
+  CWorkPool pool(4);
+
+  // nested groups: every outer task waits for inner tasks of its own
+  std::atomic<int> sum(0);
+  {
+    CTaskGroup outer(pool);
+    for (int i = 0; i < 64; ++i) {
+      outer.Run([&pool, &sum, i]() {
+        CTaskGroup inner(pool);
+        for (int j = 0; j < 16; ++j)
+          inner.Run([&sum, i, j]() { sum += i * 16 + j; });
+        inner.Wait();
+      });
+    }
+    outer.Wait();
+  }
+
+  int expected = 1024 * 1023 / 2;
+  if (sum != expected) {
+    printf("sum %d, expected %d\n", (int)sum, expected);
+    return 1;
+  }
+
+  // exceptions reach the waiter
+  bool caught = false;
+  {
+    CTaskGroup g(pool);
+    g.Run([]() { throw std::runtime_error("task failed"); });
+    g.Run([]() {});
+    try {
+      g.Wait();
+    } catch (std::runtime_error &) {
+      caught = true;
+    }
+  }
+
+  if (!caught) {
+    printf("exception lost\n");
+    return 1;
+  }
+
+  // a bounded queue never holds more than its capacity, the producer waits
+  // for the consumer; the items come out in order
+  {
+    CBoundedQueue<int> queue(4);
+    std::atomic<int> pushed(0), most(0);
+    std::thread producer([&]() {
+      for (int i = 0; i < 1000; ++i) {
+        queue.Push(i);
+        ++pushed;
+      }
+      queue.Close();
+    });
+
+    int next = 0, item;
+    bool ordered = true;
+    while (queue.Pop(item)) {
+      ordered = ordered && item == next++;
+      int ahead = pushed - next;
+      if (ahead > most)
+        most = ahead;
+    }
+    producer.join();
+
+    // pushed is counted after Push returns, one item may be taken meanwhile
+    if (!ordered || next != 1000 || most > 5) {
+      printf("bounded queue: %d items, %d ahead of the consumer\n", next,
+             (int)most);
+      return 1;
+    }
+
+    // closed by the consumer: the producer gives up
+    CBoundedQueue<int> abandoned(1);
+    abandoned.Push(1);
+    std::thread blocked([&]() { pushed = abandoned.Push(2) ? 1 : 0; });
+    abandoned.Close();
+    blocked.join();
+    if (pushed != 0 || !abandoned.Pop(item) || item != 1 ||
+        abandoned.Pop(item)) {
+      printf("bounded queue not closed\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
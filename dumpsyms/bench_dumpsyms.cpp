@@ -0,0 +1,339 @@
+// time of dumpsyms against dumpsyms.py on synthetic DLLs of system32 sizes:
+// kernel32 has ~1.6k exports, ntdll ~2.5k, the biggest ones ~10k.
+//
+// usage: bench_dumpsyms [--dlls <n>] [exports per DLL ...]
+//
+// dumpsyms is taken from the directory of bench_dumpsyms, dumpsyms.py from
+// the source tree (or DUMPSYMS_PY), run by python3. every count gets an x64
+// and an x86 DLL, a tenth of their exports forwarded. each tool runs once
+// per DLL and mode, the JSON and binary manifests of both must be identical.
+//
+// then the directory mode: a tree of --dlls DLLs (2000 by default) of 20 to
+// 1600 exports, like a system32 where most DLLs export little, with as many
+// other files next to them, is dumped by a dumpsyms process per DLL, by the
+// directory mode on one thread, on all cores and into a combined stream. the
+// manifests of the directory mode must be those of the single DLL runs. the
+// directory mode is run once more with an empty /CACHE and twice with the
+// cache filled, with and without /HASH.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+namespace fs = std::filesystem;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+#ifdef _WIN32
+
+int main() {
+  printf("bench_dumpsyms runs the tools with posix_spawn, not supported here\n");
+  return 0;
+}
+
+#else
+
+static void Put16(std::vector<unsigned char>& b, size_t at, unsigned v) {
+  b[at] = (unsigned char)v;
+  b[at + 1] = (unsigned char)(v >> 8);
+}
+
+static void Put32(std::vector<unsigned char>& b, size_t at, unsigned v) {
+  Put16(b, at, v & 0xFFFF);
+  Put16(b, at + 2, v >> 16);
+}
+
+// a DLL with a .text section and the export table in .rdata. the names are
+// sorted like the linker sorts them, every tenth export is forwarded.
+// stamp: the TimeDateStamp, the link time
+static std::vector<unsigned char> MakeDll(const std::string& dllName, int n,
+                                          bool x64, unsigned stamp = 0) {
+  const unsigned rdataVa = 0x2000, rdataRaw = 0x400;
+  size_t optSize = x64 ? 240 : 224;
+
+  std::vector<std::string> names(n), forwards(n);
+  char buf[64];
+  for (int i = 0; i < n; ++i) {
+    snprintf(buf, sizeof(buf), "BenchExport%06dEx", i);
+    names[i] = buf;
+    if (i % 10 == 9) {
+      snprintf(buf, sizeof(buf), "NTDLL.RtlBenchTarget%06d", i);
+      forwards[i] = buf;
+    }
+  }
+
+  // the export data: directory, functions, names, ordinals, strings
+  size_t functions = 40, namePtrs = functions + 4 * n,
+         ordinals = namePtrs + 4 * n, strings = ordinals + 2 * n;
+  std::vector<unsigned char> e(strings);
+  std::string pool = dllName + '\0';
+  std::vector<unsigned> nameRva(n), fwdRva(n);
+  for (int i = 0; i < n; ++i) {
+    nameRva[i] = rdataVa + (unsigned)(strings + pool.size());
+    pool += names[i] + '\0';
+    if (!forwards[i].empty()) {
+      fwdRva[i] = rdataVa + (unsigned)(strings + pool.size());
+      pool += forwards[i] + '\0';
+    }
+  }
+  e.insert(e.end(), pool.begin(), pool.end());
+  unsigned exportSize = (unsigned)e.size();
+
+  Put32(e, 12, rdataVa + (unsigned)strings); // Name
+  Put32(e, 16, 1);                           // Base
+  Put32(e, 20, n);
+  Put32(e, 24, n);
+  Put32(e, 28, rdataVa + (unsigned)functions);
+  Put32(e, 32, rdataVa + (unsigned)namePtrs);
+  Put32(e, 36, rdataVa + (unsigned)ordinals);
+  for (int i = 0; i < n; ++i) {
+    Put32(e, functions + 4 * i, fwdRva[i] ? fwdRva[i] : 0x1000 + 16 * (i % 0xF0));
+    Put32(e, namePtrs + 4 * i, nameRva[i]);
+    Put16(e, ordinals + 2 * i, i);
+  }
+  size_t rawSize = (e.size() + 0x1FF) & ~(size_t)0x1FF;
+  e.resize(rawSize);
+
+  std::vector<unsigned char> b(rdataRaw);
+  b[0] = 'M';
+  b[1] = 'Z';
+  Put32(b, 0x3C, 0x80);
+  Put32(b, 0x80, 0x4550);
+  Put16(b, 0x84, x64 ? 0x8664 : 0x14C);
+  Put16(b, 0x86, 2);
+  Put32(b, 0x88, stamp);
+  Put16(b, 0x94, (unsigned)optSize);
+  Put16(b, 0x96, 0x2022);
+
+  size_t opt = 0x98, dirs = opt + (x64 ? 112 : 96);
+  Put16(b, opt, x64 ? 0x20B : 0x10B);
+  Put32(b, opt + 56, rdataVa + (unsigned)rawSize); // SizeOfImage
+  Put32(b, dirs - 4, 16);                          // NumberOfRvaAndSizes
+  Put32(b, dirs, rdataVa);
+  Put32(b, dirs + 4, exportSize);
+
+  size_t sec = opt + optSize;
+  memcpy(&b[sec], ".text", 5);
+  Put32(b, sec + 8, 0xF00); // dumpsyms.py takes the end of a section as in it
+  Put32(b, sec + 12, 0x1000);
+  memcpy(&b[sec + 40], ".rdata", 6);
+  Put32(b, sec + 48, (unsigned)rawSize);
+  Put32(b, sec + 52, rdataVa);
+  Put32(b, sec + 56, (unsigned)rawSize);
+  Put32(b, sec + 60, rdataRaw);
+
+  b.insert(b.end(), e.begin(), e.end());
+  return b;
+}
+
+// runs the command with its stdout on /dev/null
+// return: the time in ms
+static double Run(const std::vector<std::string>& args) {
+  std::vector<char*> argv;
+  for (size_t i = 0; i < args.size(); ++i)
+    argv.push_back((char*)args[i].c_str());
+  argv.push_back(0);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+  Clock::time_point start = Clock::now();
+  pid_t pid;
+  if (posix_spawnp(&pid, argv[0], &actions, 0, argv.data(), environ) != 0) {
+    fprintf(stderr, "Fail to run %s\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  double ms = MsSince(start);
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  return ms;
+}
+
+static std::string ReadFile(const fs::path& path) {
+  std::ifstream f(path, std::ios::binary);
+  if (!f.is_open()) {
+    printf("%s: not written\n", path.string().c_str());
+    exit(EXIT_FAILURE);
+  }
+  return std::string(std::istreambuf_iterator<char>(f),
+                     std::istreambuf_iterator<char>());
+}
+
+// a tree of DLLs and other files, sub<k>/lib<n>.dll and sub<k>/lib<n>.mui
+// return: the DLLs
+static std::vector<std::string> MakeTree(const fs::path& dir, int dlls) {
+  static const int sizes[] = {20, 20, 60, 60, 60, 150, 150, 400, 1600};
+  std::vector<std::string> r;
+  std::string text(16 * 1024, 'x');
+  for (int n = 0; n < dlls; ++n) {
+    fs::path sub = dir / ("sub" + std::to_string(n % 10));
+    fs::create_directories(sub);
+    std::string name = "lib" + std::to_string(n);
+    std::vector<unsigned char> image =
+        MakeDll(name + ".dll", sizes[n % 9], n % 2 == 0, 0x60000000 + n);
+    std::string dll = (sub / (name + ".dll")).string();
+    std::ofstream(dll, std::ios::binary)
+        .write((const char*)image.data(), image.size());
+    std::ofstream(sub / (name + ".mui"), std::ios::binary) << text;
+    r.push_back(dll);
+  }
+  return r;
+}
+
+// the manifests in out are those of the single DLL runs, <dll>.ref
+static void Compare(const fs::path& tree, const std::vector<std::string>& files,
+                    const std::string& out) {
+  for (size_t i = 0; i < files.size(); ++i) {
+    std::string rel = fs::path(files[i]).lexically_relative(tree).string();
+    if (ReadFile(files[i] + ".ref") != ReadFile(fs::path(out) / (rel + ".json"))) {
+      printf("%s: the manifests of the directory mode differ\n",
+             files[i].c_str());
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+static void BenchDirectory(const std::string& native, int dlls) {
+  fs::path tree = "tree";
+  std::vector<std::string> files = MakeTree(tree, dlls);
+  size_t total = files.size() * 2;
+
+  printf("\n%d DLLs and %d other files\n", dlls, dlls);
+  printf("%-24s %10s %10s\n", "", "total ms", "files/s");
+
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < files.size(); ++i)
+    Run({native, files[i], files[i] + ".ref", "/COMPACT"});
+  double ms = MsSince(start);
+  printf("%-24s %10.1f %10.0f\n", "process per DLL", ms, total * 1000 / ms);
+
+  std::string root = tree.string();
+  std::string out = "out";
+  ms = Run({native, root, out, "/RECURSIVE", "/COMPACT", "/JOBS:1"});
+  printf("%-24s %10.1f %10.0f\n", "directory, one thread", ms,
+         total * 1000 / ms);
+  Compare(tree, files, out);
+
+  ms = Run({native, root, out, "/RECURSIVE", "/COMPACT"});
+  printf("%-24s %10.1f %10.0f\n", "directory, all cores", ms,
+         total * 1000 / ms);
+
+  static const char* const cached[] = {"empty cache", "filled cache",
+                                       "empty cache, /HASH",
+                                       "filled cache, /HASH"};
+  for (int i = 0; i < 4; ++i) {
+    std::vector<std::string> args = {native,     root,          out,
+                                     "/RECURSIVE", "/COMPACT", "/CACHE:cache"};
+    if (i >= 2)
+      args.push_back("/HASH");
+    if (i % 2 == 0)
+      fs::remove_all("cache");
+    fs::remove_all(out);
+    ms = Run(args);
+    printf("%-24s %10.1f %10.0f\n", cached[i], ms, total * 1000 / ms);
+    Compare(tree, files, out);
+  }
+  for (size_t i = 0; i < files.size(); ++i)
+    fs::remove(files[i] + ".ref");
+
+  std::string combined = "/COMBINED:all.ndjson";
+  ms = Run({native, root, "/RECURSIVE", combined});
+  printf("%-24s %10.1f %10.0f\n", "combined stream", ms, total * 1000 / ms);
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<int> counts;
+  int dlls = 2000;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--dlls") == 0 && i + 1 < argc)
+      dlls = atoi(argv[++i]);
+    else
+      counts.push_back(atoi(argv[i]));
+  }
+  if (counts.empty())
+    counts = {1600, 2500, 10000};
+
+  std::string native =
+      (fs::absolute(argv[0]).parent_path() / "dumpsyms").string();
+  const char* env = getenv("DUMPSYMS_PY");
+  std::string script = fs::absolute(env ? env : DUMPSYMS_PY).string();
+
+  // relative paths only: dumpsyms.py takes anything starting with a slash
+  // after the DLL for a switch
+  fs::path dir = fs::temp_directory_path() / "bench_dumpsyms";
+  fs::create_directories(dir);
+  fs::current_path(dir);
+
+  printf("%8s %4s %10s %12s %12s %8s\n", "exports", "arch", "mode",
+         "python ms", "native ms", "speedup");
+  for (size_t c = 0; c < counts.size(); ++c) {
+    for (int x64 = 1; x64 >= 0; --x64) {
+      std::string name = "bench" + std::to_string(counts[c]) + ".dll";
+      std::string dll = name;
+      std::vector<unsigned char> image = MakeDll(name, counts[c], x64 != 0);
+      std::ofstream(dll, std::ios::binary)
+          .write((const char*)image.data(), image.size());
+
+      static const char* modes[] = {"/COMPACT", "comments", "/BINARY"};
+      for (int m = 0; m < 3; ++m) {
+        const char* ext = m == 2 ? ".bmf" : ".json";
+        std::string py = "py" + std::string(ext);
+        std::string nat = "native" + std::string(ext);
+
+        std::vector<std::string> pyArgs = {"python3", script, dll, py};
+        std::vector<std::string> natArgs = {native, dll, nat};
+        if (m != 1) {
+          pyArgs.push_back(modes[m]);
+          natArgs.push_back(modes[m]);
+        }
+
+        fs::remove(py);
+        fs::remove(nat);
+        double pyMs = Run(pyArgs);
+        double natMs = Run(natArgs);
+        if (ReadFile(py) != ReadFile(nat)) {
+          printf("%s: the manifests of dumpsyms.py and dumpsyms differ\n",
+                 dll.c_str());
+          return 1;
+        }
+        printf("%8d %4s %10s %12.2f %12.2f %7.1fx\n", counts[c],
+               x64 ? "x64" : "x86", modes[m], pyMs, natMs, pyMs / natMs);
+      }
+    }
+  }
+
+  if (dlls > 0)
+    BenchDirectory(native, dlls);
+
+  fs::current_path(dir.parent_path());
+  fs::remove_all(dir);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,579 @@
+/**
+ * This program extracts the exports of a dynamic-link library in JSON format,
+ * the native build of dumpsyms.py with the same command line and output.
+ * Both 32 and 64-bit DLLs are supported.
+ *
+ * Usage:
+ *   dumpsyms <dll> [output] [/COMPACT] [/BINARY]
+ *
+ * The output file name is optional, <dll>.json by default.
+ *
+ * Optional switches:
+ *   /COMPACT - don't print the comments with misc information
+ *   /BINARY  - write a binary manifest instead of JSON (see
+ *              Manifest/BinaryManifest.h), implied by a .bmf output file name
+ *   /RESOLVE[:<dir>;...]
+ *            - follow the forwarder chains across DLLs and write "forward"
+ *              and, at the end of the chain, "target" into the manifest
+ *              (see Manifest/ExportCache.h). the DLLs forwarded to are
+ *              looked for next to the forwarding DLL, then in the given
+ *              directories
+ *   /CACHE:<dir>
+ *            - keep the exports of every DLL in a persistent cache
+ *              (Manifest/DllCache.h), DUMPSYMS_CACHE in the environment by
+ *              default. a DLL whose TimeDateStamp, CheckSum, SizeOfImage and
+ *              file size are in the cache isn't parsed, the lookup reads the
+ *              headers only
+ *   /HASH    - hash the whole DLL into the cache key too, for DLLs rebuilt
+ *              with the same stamp and sizes
+ *
+ * The DLL is mapped into memory, the RVAs are translated through the section
+ * table sorted once and the name, ordinal and address tables are walked in
+ * bulk (Manifest/DllManifest.cpp), where dumpsyms.py seeks and reads the file
+ * several times per export. The JSON is written byte for byte like
+ * dumpsyms.py writes it:
+ * {
+ *   "dllname": "kernel32.dll",
+ *   "arch": 64,
+ *   "symbols": [
+ *     {
+ *       "cconv": "STDCALL",
+ *       "name": "ExitProcess",
+ *       "ord": 1,
+ *       "thunk": "ExitProcess",
+ *       "pubname": "__imp_ExitProcess"
+ *     }
+ *   ]
+ * }
+ * The comments list "<dll stem>.<name> ord.<ordinal>" per export and
+ * "  -> <target>" after a forwarded one.
+ *
+ * Directory mode:
+ *   dumpsyms <directory> [output directory] [/RECURSIVE] [/JOBS:<n>]
+ *            [/COMBINED:<file> | /STREAM] [/COMPACT] [/BINARY]
+ *
+ * dumps every PE image with exports in the directory (and below it with
+ * /RECURSIVE) on a pool of /JOBS threads, one per core by default. Only the
+ * first page of a file is read to tell a PE image with exports from anything
+ * else, the images are then mapped. Each gets <image>.json (or .bmf) next to
+ * it or at the same relative path in the output directory. /COMBINED writes
+ * all of them to one file instead (- for stdout), one JSON manifest per line
+ * in the order of the paths, with the path relative to the directory as
+ * "file":
+ * {"file": "sub/a.dll", "dllname": "a.dll", "arch": 64, "symbols": [...]}
+ * The number of files and the files per second are reported at the end.
+ * /STREAM writes the manifests to stdout as they are done, in the order the
+ * threads finish them, for mkimplib --stream to build the libraries while
+ * the directory is still being dumped: the lines of /COMBINED, or with
+ * /BINARY frames of binary manifests (Manifest/BinaryManifest.h). The
+ * manifests wait in a queue of a few per thread for the writer, when the
+ * reader of the pipe falls behind the threads wait.
+ * With /RESOLVE the directory is searched for the DLLs forwarded to as well,
+ * and all the threads share one cache of parsed export tables: every DLL is
+ * parsed once, whether it is dumped or forwarded to. With a cache the hits
+ * and misses are reported too.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "DllCache.h"
+#include "BinaryManifest.h"
+#include "BoundedQueue.h"
+#include "ExportCache.h"
+#include "Manifest.h"
+#include "WorkPool.h"
+
+namespace fs = std::filesystem;
+
+enum ExitCode {
+  ERR_OK = 0,
+  ERR_FILE_NOT_FOUND = 1,
+  ERR_OUTPUT = 2,
+  ERR_BAD_FORMAT = 3
+};
+
+static bool HasExtension(const std::string& path, const char* ext) {
+  size_t n = strlen(ext);
+  if (path.size() < n)
+    return false;
+  for (size_t i = 0; i < n; ++i) {
+    if (tolower((unsigned char)path[path.size() - n + i]) != ext[i])
+      return false;
+  }
+  return true;
+}
+
+static const char* const Switches[] = {"/COMPACT",  "/BINARY",
+                                       "/RECURSIVE", "/JOBS:",
+                                       "/COMBINED:", "/RESOLVE",
+                                       "/CACHE:",    "/HASH",
+                                       "/STREAM"};
+
+// the value of a switch, "" if it takes none, 0 if not given
+static const char* GetSwitch(int argc, char* argv[], const char* name) {
+  size_t n = strlen(name);
+  for (int i = 2; i < argc; ++i) {
+    if (strncmp(argv[i], name, n) == 0 && (name[n - 1] == ':' || !argv[i][n]))
+      return argv[i] + n;
+  }
+  return 0;
+}
+
+static bool HasSwitch(int argc, char* argv[], const char* name) {
+  return GetSwitch(argc, argv, name) != 0;
+}
+
+// /RESOLVE or /RESOLVE:<dir>;<dir>...
+// return: false if not given
+static bool GetSearchDirs(int argc, char* argv[],
+                          std::vector<std::string>& dirs) {
+  const char* resolve = GetSwitch(argc, argv, "/RESOLVE");
+  if (resolve == 0) {
+    resolve = GetSwitch(argc, argv, "/RESOLVE:");
+    if (resolve == 0)
+      return false;
+  }
+
+  std::string list = resolve;
+  size_t begin = 0;
+  while (begin < list.size()) {
+    size_t end = list.find(';', begin);
+    if (end == std::string::npos)
+      end = list.size();
+    if (end > begin)
+      dirs.push_back(list.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return true;
+}
+
+// /CACHE:<dir> or DUMPSYMS_CACHE
+// return: 0 without a cache
+static Sora::CDllCache* CreateDllCache(int argc, char* argv[]) {
+  const char* dir = GetSwitch(argc, argv, "/CACHE:");
+  if (dir == 0)
+    dir = getenv("DUMPSYMS_CACHE");
+  if (dir == 0 || *dir == 0)
+    return 0;
+  return new Sora::CDllCache(dir, HasSwitch(argc, argv, "/HASH"));
+}
+
+// an absolute output path on Linux starts with a slash too
+static bool IsSwitch(const char* arg) {
+  for (size_t i = 0; i < sizeof(Switches) / sizeof(Switches[0]); ++i) {
+    size_t n = strlen(Switches[i]);
+    if (strncmp(arg, Switches[i], n) == 0 &&
+        (Switches[i][n - 1] == ':' || !arg[n]))
+      return true;
+  }
+  return false;
+}
+
+// the comments of dumpsyms.py, in one write
+static void PrintComments(const std::string& file, const Sora::CManifest& m) {
+  std::string stem = fs::path(file).stem().string();
+  std::string out;
+  out.reserve(m.symbols.size() * 48);
+
+  std::vector<Sora::ExportSymbol>::const_iterator i, iend;
+  for (i = m.symbols.begin(), iend = m.symbols.end(); i != iend; ++i) {
+    out += stem;
+    out += '.';
+    out += i->name;
+    out += " ord." + std::to_string(i->ord) + "\n";
+    if (!i->forward.empty()) {
+      out += "  -> ";
+      out += i->forward;
+      out += '\n';
+    }
+    if (!i->target.empty() && i->target != i->forward) {
+      out += "  => ";
+      out += i->target;
+      out += '\n';
+    }
+  }
+  fwrite(out.data(), 1, out.size(), stdout);
+}
+
+// the manifest as it is written: the forwarders are comments, unless they
+// were resolved
+static void Serialize(Sora::CManifest& m, bool binary, bool resolved,
+                      std::string& out) {
+  for (size_t i = 0; i < m.symbols.size() && !resolved; ++i)
+    m.symbols[i].forward = std::string_view();
+
+  if (binary) {
+    std::vector<BYTE> data;
+    Sora::WriteBinaryManifest(m, data);
+    out.assign(data.begin(), data.end());
+  } else {
+    Sora::WriteJsonManifest(m, out);
+  }
+}
+
+static bool WriteFile(const std::string& path, const std::string& data) {
+  std::ofstream f(path, std::ios::binary);
+  f.write(data.data(), data.size());
+  f.close();
+  return !f.fail();
+}
+
+// the exports of the DLL, with the forwarders followed to their end if there
+// is a cache. the DLL is then parsed through the cache, once, whether it is
+// dumped or forwarded to. with a store (which the cache loads through too)
+// an unchanged DLL isn't parsed at all.
+// h: the headers if they were read already
+// return: the forwarders resolved to an export found
+static size_t LoadExports(const std::string& file, const Sora::PeHeader* h,
+                          Sora::CExportCache* cache, Sora::CDllCache* store,
+                          Sora::CManifest& m) {
+  const Sora::CManifest* cached = cache ? cache->Load(file) : 0;
+  if (cached == 0) {
+    // the error, or the exports without resolution
+    Sora::PeHeader header;
+    if (store != 0 && h == 0 && Sora::ReadPeHeader(file.c_str(), header))
+      h = &header;
+    if (store != 0 && h != 0)
+      store->Load(file, *h, m);
+    else
+      Sora::LoadDllManifest(file.c_str(), m);
+    return 0;
+  }
+
+  m.dllName = cached->dllName;
+  m.arch = cached->arch;
+  m.symbols = cached->symbols;
+  return cache->ResolveManifest(m, file);
+}
+
+static int DumpFile(const std::string& file, const std::string& output,
+                    bool compact, bool binary, Sora::CExportCache* cache,
+                    Sora::CDllCache* store) {
+  Sora::CManifest m;
+  try {
+    LoadExports(file, 0, cache, store, m);
+  } catch (std::exception& e) {
+    printf("Error: %s\n", e.what());
+    return fs::exists(file) ? ERR_BAD_FORMAT : ERR_FILE_NOT_FOUND;
+  }
+
+  if (!compact)
+    PrintComments(file, m);
+
+  std::string data;
+  Serialize(m, binary, cache != 0, data);
+  if (!WriteFile(output, data)) {
+    printf("Error: Error opening the output file %s\n", output.c_str());
+    return ERR_OUTPUT;
+  }
+  return ERR_OK;
+}
+
+// the JSON manifest on one line, "file" first
+static void MakeStreamLine(const std::string& file, const std::string& json,
+                           std::string& line) {
+  line = "{\"file\": ";
+  Sora::AppendJsonString(line, file);
+  line += ", ";
+
+  // no newline in the strings, they are escaped
+  for (size_t i = 1; i < json.size(); ++i) {
+    if (json[i] != '\n') {
+      line += json[i];
+      continue;
+    }
+    while (i + 1 < json.size() && json[i + 1] == ' ')
+      ++i;
+  }
+  line += '\n';
+}
+
+// a binary manifest as a frame of the /STREAM /BINARY output
+static void MakeStreamFrame(const std::string& file, const std::string& data,
+                            std::string& frame) {
+  Sora::BinaryStreamFrame h;
+  memcpy(h.magic, Sora::BinaryStreamMagic, 4);
+  h.fileSize = (uint32_t)file.size();
+  h.manifestSize = (uint32_t)data.size();
+
+  frame.assign((const char*)&h, sizeof(h));
+  frame += file;
+  frame.append(Sora::BinaryStreamPadding(h.fileSize), '\0');
+  frame += data;
+  frame.append(Sora::BinaryStreamPadding(h.manifestSize), '\0');
+}
+
+// the lines of the combined output in the order of the files, whichever
+// thread finishes first
+class COrderedWriter {
+public:
+  COrderedWriter(FILE* f, size_t count)
+      : m_file(f), m_lines(count), m_done(count), m_next(0), m_failed(false) {}
+
+  void Put(size_t index, std::string line) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_lines[index].swap(line);
+    m_done[index] = 1;
+    for (; m_next < m_done.size() && m_done[m_next]; ++m_next) {
+      std::string& l = m_lines[m_next];
+      if (fwrite(l.data(), 1, l.size(), m_file) != l.size())
+        m_failed = true;
+      std::string().swap(l);
+    }
+  }
+
+  bool Failed() const { return m_failed; }
+
+private:
+  FILE* m_file;
+  std::mutex m_lock;
+  std::vector<std::string> m_lines;
+  std::vector<char> m_done;
+  size_t m_next;
+  bool m_failed;
+};
+
+struct DirStats {
+  std::atomic<size_t> dumped;
+  std::atomic<size_t> skipped; // not a PE image or no exports
+  std::atomic<size_t> failed;
+  std::atomic<size_t> forwarders;
+  std::atomic<size_t> resolved; // to an export found
+};
+
+static int DumpDirectory(int argc, char* argv[]) {
+  fs::path dir = argv[1];
+  std::string outDir = argc > 2 && !IsSwitch(argv[2]) ? argv[2] : "";
+  bool compact = HasSwitch(argc, argv, "/COMPACT");
+  bool binary = HasSwitch(argc, argv, "/BINARY");
+  bool recursive = HasSwitch(argc, argv, "/RECURSIVE");
+  const char* jobs = GetSwitch(argc, argv, "/JOBS:");
+  const char* combined = GetSwitch(argc, argv, "/COMBINED:");
+  bool streaming = HasSwitch(argc, argv, "/STREAM");
+  const char* ext = binary ? ".bmf" : ".json";
+
+  // the directory is searched for the DLLs forwarded to too
+  std::unique_ptr<Sora::CDllCache> store(CreateDllCache(argc, argv));
+  std::vector<std::string> dirs(1, dir.string());
+  std::unique_ptr<Sora::CExportCache> cache;
+  if (GetSearchDirs(argc, argv, dirs))
+    cache.reset(new Sora::CExportCache(dirs, store.get()));
+
+  if (combined && (binary || !outDir.empty() || !*combined)) {
+    printf("Error: /COMBINED takes a file and writes JSON only\n");
+    return ERR_OUTPUT;
+  }
+
+  if (streaming && (combined || !outDir.empty())) {
+    printf("Error: /STREAM writes to stdout, no output\n");
+    return ERR_OUTPUT;
+  }
+
+  // the report and the comments can't go into a combined stdout
+  bool toStdout = streaming || (combined && strcmp(combined, "-") == 0);
+  FILE* report = toStdout ? stderr : stdout;
+  compact = compact || toStdout;
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  // a file that can't be stat'ed is left out, not the rest of the directory
+  std::vector<fs::path> files;
+  std::error_code ec, fileEc;
+  fs::directory_options options = fs::directory_options::skip_permission_denied;
+  if (recursive) {
+    fs::recursive_directory_iterator i(dir, options, ec), iend;
+    for (; !ec && i != iend; i.increment(ec)) {
+      if (i->is_regular_file(fileEc))
+        files.push_back(i->path());
+    }
+  } else {
+    fs::directory_iterator i(dir, options, ec), iend;
+    for (; !ec && i != iend; i.increment(ec)) {
+      if (i->is_regular_file(fileEc))
+        files.push_back(i->path());
+    }
+  }
+  if (ec) {
+    printf("Error: %s: %s\n", dir.string().c_str(), ec.message().c_str());
+    return ERR_FILE_NOT_FOUND;
+  }
+  std::sort(files.begin(), files.end());
+
+  FILE* stream = 0;
+  if (combined) {
+    stream = toStdout ? stdout : fopen(combined, "wb");
+    if (stream == 0) {
+      printf("Error: Error opening the output file %s\n", combined);
+      return ERR_OUTPUT;
+    }
+  }
+  COrderedWriter writer(stream, files.size());
+
+  bool streamFailed = false;
+  DirStats stats;
+  stats.dumped = 0;
+  stats.skipped = 0;
+  stats.failed = 0;
+  stats.forwarders = 0;
+  stats.resolved = 0;
+
+  {
+    Sora::CWorkPool pool(jobs ? atoi(jobs) : 0);
+
+    // /STREAM: written by a thread of its own as they come, blocking on a
+    // full pipe holds up the pool through the queue
+    Sora::CBoundedQueue<std::string> records(2 * pool.GetThreadCount());
+    std::thread streamWriter;
+    if (streaming) {
+#ifdef _WIN32
+      _setmode(_fileno(stdout), _O_BINARY);
+#endif
+      streamWriter = std::thread([&records, &streamFailed]() {
+        std::string record;
+        while (records.Pop(record)) {
+          if (!streamFailed &&
+              fwrite(record.data(), 1, record.size(), stdout) != record.size())
+            streamFailed = true;
+        }
+      });
+    }
+
+    Sora::CTaskGroup group(pool);
+    for (size_t n = 0; n < files.size(); ++n) {
+      group.Run([&, n]() {
+        std::string file = files[n].string();
+        std::string rel = files[n].lexically_relative(dir).generic_string();
+        std::string line;
+
+        Sora::PeHeader h;
+        if (!Sora::ReadPeHeader(file.c_str(), h) || h.exportSize == 0) {
+          ++stats.skipped;
+          if (stream)
+            writer.Put(n, line);
+          return;
+        }
+
+        try {
+          Sora::CManifest m;
+          stats.resolved += LoadExports(file, &h, cache.get(), store.get(), m);
+          for (size_t i = 0; i < m.symbols.size(); ++i)
+            stats.forwarders += !m.symbols[i].forward.empty();
+          if (!compact)
+            PrintComments(file, m);
+
+          std::string data;
+          Serialize(m, binary, cache != 0, data);
+          if (streaming) {
+            std::string record;
+            if (binary)
+              MakeStreamFrame(rel, data, record);
+            else
+              MakeStreamLine(rel, data, record);
+            records.Push(std::move(record));
+          } else if (stream) {
+            MakeStreamLine(rel, data, line);
+          } else {
+            fs::path out = outDir.empty() ? fs::path(file + ext)
+                                          : fs::path(outDir) / (rel + ext);
+            if (!outDir.empty())
+              fs::create_directories(out.parent_path());
+            if (!WriteFile(out.string(), data))
+              throw std::runtime_error("Error opening the output file " +
+                                       out.string());
+          }
+          ++stats.dumped;
+        } catch (std::exception& e) {
+          fprintf(report, "Error: %s\n", e.what());
+          ++stats.failed;
+        }
+        if (stream)
+          writer.Put(n, line);
+      });
+    }
+    group.Wait();
+    if (streaming) {
+      records.Close();
+      streamWriter.join();
+      streamFailed = fflush(stdout) != 0 || streamFailed;
+    }
+  }
+
+  if (stream) {
+    streamFailed = writer.Failed() || fflush(stream) != 0;
+    if (!toStdout)
+      streamFailed = fclose(stream) != 0 || streamFailed;
+  }
+
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                           start)
+                 .count();
+  fprintf(report,
+          "%zu files in %.1f ms, %.0f files/s: %zu manifests, %zu not PE or "
+          "without exports, %zu errors\n",
+          files.size(), s * 1000, s > 0 ? files.size() / s : 0.0,
+          (size_t)stats.dumped, (size_t)stats.skipped, (size_t)stats.failed);
+  if (cache)
+    fprintf(report,
+            "%zu forwarders, %zu resolved to an export, %zu DLLs parsed\n",
+            (size_t)stats.forwarders, (size_t)stats.resolved,
+            cache->GetParsedCount());
+  if (store)
+    fprintf(report, "cache: %zu hits, %zu misses\n", store->GetHits(),
+            store->GetMisses());
+
+  if (streamFailed) {
+    fprintf(report, "Error: Error writing the output file %s\n",
+            streaming ? "stdout" : combined);
+    return ERR_OUTPUT;
+  }
+  return stats.failed ? ERR_BAD_FORMAT : ERR_OK;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("USAGE: DUMPSYMBOLS file [output] [/COMPACT] [/BINARY] "
+           "[/RESOLVE[:dirs]] [/CACHE:dir] [/HASH]\n"
+           "       DUMPSYMBOLS directory [output directory] [/RECURSIVE] "
+           "[/JOBS:n] [/COMBINED:file] [/COMPACT] [/BINARY] "
+           "[/RESOLVE[:dirs]] [/CACHE:dir] [/HASH] [/STREAM]\n");
+    return 1;
+  }
+
+  std::error_code ec;
+  if (fs::is_directory(argv[1], ec))
+    return DumpDirectory(argc, argv);
+
+  std::string file = argv[1];
+  std::string output = argc > 2 && !IsSwitch(argv[2]) ? argv[2] : file + ".json";
+  bool compact = HasSwitch(argc, argv, "/COMPACT");
+  bool binary = HasSwitch(argc, argv, "/BINARY") || HasExtension(output, ".bmf");
+  if (binary && output == file + ".json")
+    output = file + ".bmf";
+
+  std::unique_ptr<Sora::CDllCache> store(CreateDllCache(argc, argv));
+  std::vector<std::string> dirs;
+  std::unique_ptr<Sora::CExportCache> cache;
+  if (GetSearchDirs(argc, argv, dirs))
+    cache.reset(new Sora::CExportCache(dirs, store.get()));
+
+  return DumpFile(file, output, compact, binary, cache.get(), store.get());
+}
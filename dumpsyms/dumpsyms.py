@@ -14,6 +14,8 @@ same name as the DLL will be generated.
 
 Optional switches:
 /COMPACT - don't include comments with misc information
+/BINARY - write a binary manifest instead of JSON (see
+          Manifest/BinaryManifest.h), implied by a .bmf output file name
 
 The output JSON structure includes:
 - dllname: The name of the DLL.
@@ -228,20 +230,68 @@ def parse_pe(filename, compact):
         print(f"Unexpected error: {e}")
         return ERR_CODES['ERR_BAD_FORMAT']
 
+BINARY_MAGIC = b'SBMF'
+BINARY_VERSION = 1
+BSF_THUNK_IN_PUBNAME = 0x100
+BSF_NAME_IS_THUNK = 0x200
+
+def write_binary(result, hOut):
+    # header, 28-byte symbol records, string pool starting with ""
+    pool = bytearray(b'\x00')
+    offsets = {}
+
+    def add(s, shared=False):
+        if not s:
+            return 0
+        if shared and s in offsets:
+            return offsets[s]
+        off = len(pool)
+        pool.extend(s.encode() + b'\x00')
+        if shared:
+            offsets[s] = off
+        return off
+
+    dll_name = add(result["dllname"])
+    records = bytearray()
+    for symbol in result["symbols"]:
+        # thunk is the name and pubname is __imp_ + thunk, stored once
+        records += struct.pack('<IIIIIihH',
+                               add(symbol["pubname"]), 0, 0,
+                               add(symbol["cconv"], True), 0, symbol["ord"],
+                               -1, BSF_THUNK_IN_PUBNAME | BSF_NAME_IS_THUNK)
+
+    symbols_offset = 32
+    strings_offset = symbols_offset + len(records)
+    hOut.write(BINARY_MAGIC + struct.pack('<IIIIIII', BINARY_VERSION,
+                                          result["arch"], dll_name,
+                                          len(result["symbols"]),
+                                          symbols_offset, strings_offset,
+                                          len(pool)))
+    hOut.write(records)
+    hOut.write(pool)
+
 def main():
     if len(sys.argv) < 2:
-        print("USAGE: DUMPSYMBOLS file [output] [/COMPACT]")
+        print("USAGE: DUMPSYMBOLS file [output] [/COMPACT] [/BINARY]")
         return 1
 
     filename = sys.argv[1]
     output_filename = sys.argv[2] if len(sys.argv) > 2 and not sys.argv[2].startswith('/') else f"{filename}.json"
     compact = '/COMPACT' in sys.argv
+    binary = '/BINARY' in sys.argv or output_filename.lower().endswith('.bmf')
+    if binary and output_filename == f"{filename}.json":
+        output_filename = f"{filename}.bmf"
 
     result = parse_pe(filename, compact)
     if isinstance(result, int):
         print(f"Error: {error_msgs[result - 1]}")
         return result
 
+    if binary:
+        with open(output_filename, 'wb') as hOut:
+            write_binary(result, hOut)
+        return 0
+
     with open(output_filename, 'w') as hOut:
         json.dump(result, hOut, indent=2)
 
@@ -0,0 +1,93 @@
+/**
+ * This program converts export manifests between the JSON and the binary
+ * format.
+ *
+ * Usage:
+ *   manifestconv [--arch 32|64] <input> <output>
+ *
+ * The input is anything mkimplib reads: JSON, binary manifest, .def or the
+ * DLL itself. The output format is chosen by its extension: .json for JSON,
+ * .bmf for the binary manifest.
+ *
+ * The binary manifest is a header, fixed-size symbol records and a string
+ * pool, see Manifest/BinaryManifest.h. mkimplib maps it and reads the
+ * records in place, there is nothing to parse.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Manifest.h"
+
+static bool HasExtension(const std::string& path, const char* ext) {
+  size_t n = strlen(ext);
+  return path.size() >= n && path.compare(path.size() - n, n, ext) == 0;
+}
+
+static void WriteFile(const std::string& path, const void* data, size_t len) {
+  std::ofstream f(path, std::ios::binary);
+  if (!f.is_open())
+    throw std::runtime_error("Fail to create file " + path);
+  f.write((const char*)data, len);
+  if (!f)
+    throw std::runtime_error("Failed to write to file " + path);
+}
+
+static void Usage() {
+  std::cout << "Convert export manifests between JSON and binary\n"
+            << "using: manifestconv [--arch 32|64] <input> <output.json|.bmf>\n"
+            << "options:\n"
+            << "  --arch 32|64  architecture of .def inputs (default 32)\n";
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    int arch = 0;
+    std::vector<const char*> args;
+
+    for (int i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], "--arch") == 0 && i + 1 < argc) {
+        arch = atoi(argv[++i]);
+        if (arch != 32 && arch != 64)
+          throw std::runtime_error(std::string("Bad architecture ") + argv[i] +
+                                   ", use 32 or 64!");
+      } else {
+        args.push_back(argv[i]);
+      }
+    }
+
+    if (args.size() != 2) {
+      Usage();
+      return EXIT_FAILURE;
+    }
+
+    std::string output = args[1];
+    bool binary = HasExtension(output, ".bmf");
+    if (!binary && !HasExtension(output, ".json"))
+      throw std::runtime_error("Unknown output format " + output +
+                               ", use .json or .bmf!");
+
+    Sora::CManifest manifest;
+    Sora::LoadManifest(args[0], arch, manifest);
+
+    if (binary) {
+      std::vector<BYTE> data;
+      Sora::WriteBinaryManifest(manifest, data);
+      WriteFile(output, data.data(), data.size());
+    } else {
+      std::string text;
+      Sora::WriteJsonManifest(manifest, text);
+      WriteFile(output, text.data(), text.size());
+    }
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
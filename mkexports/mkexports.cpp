@@ -0,0 +1,172 @@
+/**
+ * This program writes a synthetic export manifest, made up from a seed, to
+ * test and benchmark the generator at scales no real DLL reaches.
+ *
+ * Usage:
+ *   mkexports [options] <output.json|output.def>
+ *
+ * Options:
+ *   --count <n>          exports, K and M suffixes allowed (1000 by default)
+ *   --arch 32|64         architecture of the JSON manifest, the decoration of
+ *                        its names (64 by default). a .def has none.
+ *   --dll <name>         name of the DLL (synthetic.dll by default)
+ *   --seed <n>           the same seed and options give the same file
+ *   --name-length <min>[-<max>]
+ *                        length of the exported names (8-32 by default)
+ *   --name-dist uniform|normal|skewed
+ *                        how the lengths spread over the range: evenly,
+ *                        around the middle, or mostly short with a long tail
+ *   --ordinal-only <fraction>   exports by ordinal only, NONAME (0 to 1)
+ *   --stdcall <fraction>        stdcall exports, Name@nn (0 to 1)
+ *   --dlls <n>           umbrella: spread the exports over n DLLs, those of
+ *                        the others forwarded from the first one
+ *
+ * The output format is chosen by its extension. The manifest is written a
+ * chunk at a time, millions of exports take little memory. Names are random
+ * letters, '_' and the index of the export in base 36, unique by
+ * construction. Ordinals run from 1 and wrap after 65535, the most an export
+ * table holds. The forwarded exports make an umbrella library with
+ * mkimplib --import-final; the .def parser keeps no forwarders.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "SyntheticManifest.h"
+
+static bool HasExtension(const std::string& path, const char* ext) {
+  size_t n = strlen(ext);
+  return path.size() >= n && path.compare(path.size() - n, n, ext) == 0;
+}
+
+// a count with an optional K or M suffix
+static size_t ParseCount(const char* s) {
+  char* end;
+  unsigned long long n = strtoull(s, &end, 10);
+  if (end == s)
+    throw std::runtime_error(std::string("Bad count ") + s + "!");
+  if (*end == 'K' || *end == 'k') {
+    n *= 1000;
+    ++end;
+  } else if (*end == 'M' || *end == 'm') {
+    n *= 1000000;
+    ++end;
+  }
+  if (*end != 0)
+    throw std::runtime_error(std::string("Bad count ") + s + "!");
+  return (size_t)n;
+}
+
+static double ParseFraction(const char* s) {
+  char* end;
+  double f = strtod(s, &end);
+  if (end == s || *end != 0 || !(f >= 0 && f <= 1))
+    throw std::runtime_error(std::string("Bad fraction ") + s +
+                             ", use 0 to 1!");
+  return f;
+}
+
+static void Usage() {
+  std::cout << "Write a synthetic export manifest\n"
+            << "using: mkexports [options] <output.json|output.def>\n"
+            << "options:\n"
+            << "  --count <n>          exports, K/M suffixes (default 1000)\n"
+            << "  --arch 32|64         architecture of JSON output (default 64)\n"
+            << "  --dll <name>         dll name (default synthetic.dll)\n"
+            << "  --seed <n>           random seed (default 1)\n"
+            << "  --name-length <min>[-<max>]  name length (default 8-32)\n"
+            << "  --name-dist uniform|normal|skewed  length distribution\n"
+            << "  --ordinal-only <fraction>  exports by ordinal only\n"
+            << "  --stdcall <fraction>       stdcall exports, Name@nn\n"
+            << "  --dlls <n>           spread the exports over n dlls\n";
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    Sora::SyntheticSpec spec;
+    const char* output = 0;
+
+    for (int i = 1; i < argc; ++i) {
+      bool hasValue = i + 1 < argc;
+      if (strcmp(argv[i], "--count") == 0 && hasValue) {
+        spec.count = ParseCount(argv[++i]);
+      } else if (strcmp(argv[i], "--arch") == 0 && hasValue) {
+        spec.arch = atoi(argv[++i]);
+      } else if (strcmp(argv[i], "--dll") == 0 && hasValue) {
+        spec.dllName = argv[++i];
+      } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+        spec.seed = strtoull(argv[++i], 0, 0);
+      } else if (strcmp(argv[i], "--name-length") == 0 && hasValue) {
+        const char* s = argv[++i];
+        char* end;
+        spec.minNameLength = spec.maxNameLength = (int)strtol(s, &end, 10);
+        if (*end == '-')
+          spec.maxNameLength = (int)strtol(end + 1, &end, 10);
+        if (end == s || *end != 0)
+          throw std::runtime_error(std::string("Bad name length ") + s + "!");
+      } else if (strcmp(argv[i], "--name-dist") == 0 && hasValue) {
+        ++i;
+        if (strcmp(argv[i], "uniform") == 0)
+          spec.nameLength = Sora::NLD_UNIFORM;
+        else if (strcmp(argv[i], "normal") == 0)
+          spec.nameLength = Sora::NLD_NORMAL;
+        else if (strcmp(argv[i], "skewed") == 0)
+          spec.nameLength = Sora::NLD_SKEWED;
+        else
+          throw std::runtime_error(std::string("Bad distribution ") + argv[i] +
+                                   ", use uniform, normal or skewed!");
+      } else if (strcmp(argv[i], "--ordinal-only") == 0 && hasValue) {
+        spec.ordinalOnly = ParseFraction(argv[++i]);
+      } else if (strcmp(argv[i], "--stdcall") == 0 && hasValue) {
+        spec.stdcall = ParseFraction(argv[++i]);
+      } else if (strcmp(argv[i], "--dlls") == 0 && hasValue) {
+        spec.dllCount = atoi(argv[++i]);
+      } else if (output == 0 && argv[i][0] != '-') {
+        output = argv[i];
+      } else {
+        Usage();
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (output == 0) {
+      Usage();
+      return EXIT_FAILURE;
+    }
+
+    bool def = HasExtension(output, ".def");
+    if (!def && !HasExtension(output, ".json"))
+      throw std::runtime_error(std::string("Unknown output format ") + output +
+                               ", use .json or .def!");
+
+    FILE* f = fopen(output, "wb");
+    if (f == 0)
+      throw std::runtime_error(std::string("Fail to create file ") + output);
+    std::string out;
+    bool ok = true;
+    try {
+      Sora::WriteSyntheticManifest(spec, def, out,
+                                   [f, &ok](const std::string& text) {
+                                     ok &= fwrite(text.data(), 1, text.size(),
+                                                  f) == text.size();
+                                   });
+    } catch (...) {
+      fclose(f);
+      remove(output);
+      throw;
+    }
+    if (fclose(f) != 0 || !ok) {
+      remove(output);
+      throw std::runtime_error(std::string("Failed to write to file ") +
+                               output);
+    }
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
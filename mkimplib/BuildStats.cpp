@@ -0,0 +1,133 @@
+#include "BuildStats.h"
+
+#include <chrono>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// the open phases of this thread, innermost last
+struct OpenPhase {
+  Sora::BuildPhase phase;
+  Clock::time_point start;
+};
+static thread_local std::vector<OpenPhase> t_open;
+
+CBuildStats::CBuildStats() {
+  for (int i = 0; i < Sora::BP_COUNT; ++i) {
+    m_ns[i] = 0;
+    m_calls[i] = 0;
+  }
+  for (int i = 0; i < Sora::BC_COUNT; ++i)
+    m_counts[i] = 0;
+}
+
+void CBuildStats::PhaseBegin(Sora::BuildPhase phase) {
+  OpenPhase p = {phase, Clock::now()};
+  t_open.push_back(p);
+}
+
+void CBuildStats::PhaseEnd(Sora::BuildPhase phase) {
+  if (t_open.empty() || t_open.back().phase != phase)
+    return;
+
+  Clock::duration d = Clock::now() - t_open.back().start;
+  t_open.pop_back();
+  m_ns[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  m_calls[phase] += 1;
+}
+
+void CBuildStats::Count(Sora::BuildCounter counter, long long n) {
+  m_counts[counter] += n;
+}
+
+void CBuildStats::PrintTable(FILE* f, double wallMs) const {
+  bool allocs = Sora::IsAllocCounting();
+  fprintf(f, "%-12s %10s %12s", "phase", "calls", "ms");
+  if (allocs)
+    fprintf(f, " %10s %12s %14s", "allocs", "alloc KB", "peak live KB");
+  fprintf(f, "\n");
+  // the allocations outside any phase last, as other
+  for (int i = 0; i <= Sora::BP_COUNT; ++i) {
+    if (i < Sora::BP_COUNT)
+      fprintf(f, "%-12s %10lld %12.2f",
+              Sora::GetBuildPhaseName((Sora::BuildPhase)i), m_calls[i].load(),
+              m_ns[i] / 1e6);
+    else if (allocs)
+      fprintf(f, "%-12s %10s %12s", "other", "", "");
+    else
+      break;
+    if (allocs) {
+      Sora::AllocStats a = Sora::GetAllocStats((Sora::BuildPhase)i);
+      fprintf(f, " %10lld %12lld %14lld", a.count, a.bytes / 1024,
+              a.peakLive / 1024);
+    }
+    fprintf(f, "\n");
+  }
+  fprintf(f, "%-12s %10s %12.2f\n", "wall", "", wallMs);
+
+  fprintf(f, "\n");
+  for (int i = 0; i < Sora::BC_COUNT; ++i) {
+    fprintf(f, "%-12s %10lld\n",
+            Sora::GetBuildCounterName((Sora::BuildCounter)i),
+            m_counts[i].load());
+  }
+  fprintf(f, "%-12s %10zu KB\n", "peak rss", GetPeakRss() / 1024);
+}
+
+static void PrintAllocsJson(FILE* f, Sora::BuildPhase phase) {
+  Sora::AllocStats a = Sora::GetAllocStats(phase);
+  fprintf(f, ", \"allocs\": %lld, \"alloc_bytes\": %lld, "
+             "\"peak_live_bytes\": %lld",
+          a.count, a.bytes, a.peakLive);
+}
+
+void CBuildStats::PrintJson(FILE* f, double wallMs) const {
+  bool allocs = Sora::IsAllocCounting();
+  fprintf(f, "{\n  \"phases\": {");
+  for (int i = 0; i < Sora::BP_COUNT; ++i) {
+    fprintf(f, "%s\n    \"%s\": {\"calls\": %lld, \"ms\": %.3f", i ? "," : "",
+            Sora::GetBuildPhaseName((Sora::BuildPhase)i), m_calls[i].load(),
+            m_ns[i] / 1e6);
+    if (allocs)
+      PrintAllocsJson(f, (Sora::BuildPhase)i);
+    fprintf(f, "}");
+  }
+  // the allocations outside any phase
+  if (allocs) {
+    fprintf(f, ",\n    \"other\": {\"calls\": 0, \"ms\": 0");
+    PrintAllocsJson(f, Sora::BP_COUNT);
+    fprintf(f, "}");
+  }
+  fprintf(f, "\n  },\n  \"wall_ms\": %.3f,\n  \"counters\": {", wallMs);
+  for (int i = 0; i < Sora::BC_COUNT; ++i) {
+    fprintf(f, "%s\n    \"%s\": %lld", i ? "," : "",
+            Sora::GetBuildCounterName((Sora::BuildCounter)i),
+            m_counts[i].load());
+  }
+  fprintf(f, "\n  },\n  \"peak_rss_bytes\": %zu\n}\n", GetPeakRss());
+}
+
+size_t GetPeakRss() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return pmc.PeakWorkingSetSize;
+  return 0;
+#else
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0;
+#ifdef __APPLE__
+  return (size_t)ru.ru_maxrss; // bytes
+#else
+  return (size_t)ru.ru_maxrss * 1024; // kilobytes
+#endif
+#endif
+}
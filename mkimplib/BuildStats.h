@@ -0,0 +1,34 @@
+#ifndef BUILDSTATS_H
+#define BUILDSTATS_H
+
+#include <atomic>
+#include <cstdio>
+
+#include "coffHooks.h"
+
+// --stats: time of every phase on a monotonic clock and the counters, summed
+// over the threads. phases nest, build includes filloffsets. with allocation
+// counting on (coffHooks.h), the allocations of every phase as well; those
+// are counted against the innermost phase only.
+class CBuildStats : public Sora::IBuildListener {
+public:
+  CBuildStats();
+
+  void PhaseBegin(Sora::BuildPhase phase);
+  void PhaseEnd(Sora::BuildPhase phase);
+  void Count(Sora::BuildCounter counter, long long n);
+
+  // wallMs: the time of the whole run
+  void PrintTable(FILE* f, double wallMs) const;
+  void PrintJson(FILE* f, double wallMs) const;
+
+private:
+  std::atomic<long long> m_ns[Sora::BP_COUNT];
+  std::atomic<long long> m_calls[Sora::BP_COUNT];
+  std::atomic<long long> m_counts[Sora::BC_COUNT];
+};
+
+// peak resident set size of the process in bytes, 0 if unknown
+size_t GetPeakRss();
+
+#endif
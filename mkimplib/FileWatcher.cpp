@@ -0,0 +1,195 @@
+#include "FileWatcher.h"
+
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static void Split(const std::string& path, std::string& dir,
+                  std::string& name) {
+  std::error_code ec;
+  fs::path p = fs::absolute(path, ec).lexically_normal();
+  dir = p.parent_path().string();
+  name = p.filename().string();
+}
+
+#ifdef __linux__
+
+CFileWatcher::CFileWatcher() : m_fd(inotify_init1(IN_CLOEXEC)) {
+  if (m_fd < 0)
+    throw std::runtime_error("Fail to initialize inotify");
+}
+
+CFileWatcher::~CFileWatcher() { close(m_fd); }
+
+void CFileWatcher::Watch(const std::string& dir) {
+  int wd = inotify_add_watch(m_fd, dir.c_str(),
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+                                 IN_DELETE_SELF | IN_MOVE_SELF);
+  if (wd < 0)
+    throw std::runtime_error("Fail to watch directory " + dir);
+  m_dirs[wd] = dir;
+}
+
+void CFileWatcher::Add(const std::string& path) {
+  std::string dir, name;
+  Split(path, dir, name);
+
+  if (m_files.find(dir) == m_files.end())
+    Watch(dir);
+  m_files[dir][name] = path;
+}
+
+// every file of the directory, as given to Add
+static void AddAll(const std::map<std::string, std::string>& files,
+                   std::set<std::string>& changed) {
+  std::map<std::string, std::string>::const_iterator i;
+  for (i = files.begin(); i != files.end(); ++i)
+    changed.insert(i->second);
+}
+
+// watches the lost directories that exist again, their files changed
+// last: the quiet time passed, a directory still missing fails
+// return: true if some directory was watched again
+bool CFileWatcher::Rewatch(std::set<std::string>& lost,
+                           std::set<std::string>& changed, bool last) {
+  bool found = false;
+  std::set<std::string>::iterator i = lost.begin();
+  while (i != lost.end()) {
+    try {
+      Watch(*i);
+    } catch (std::runtime_error&) {
+      if (last)
+        throw std::runtime_error("Watched directory " + *i +
+                                 " was removed or renamed");
+      ++i;
+      continue;
+    }
+    AddAll(m_files[*i], changed);
+    found = true;
+    lost.erase(i++);
+  }
+  return found;
+}
+
+std::vector<std::string> CFileWatcher::Wait(int quietMs) {
+  std::set<std::string> changed;
+  std::set<std::string> lost; // directories removed or renamed
+  alignas(inotify_event) char buf[16 * 1024];
+
+  // block for the first event, then read until quiet
+  int timeout = -1;
+  for (;;) {
+    pollfd p = {m_fd, POLLIN, 0};
+    int n = poll(&p, 1, timeout);
+    if (n < 0)
+      throw std::runtime_error("Fail to wait for file changes");
+    if (n == 0) {
+      if (!Rewatch(lost, changed, true) && !changed.empty())
+        break;
+      continue;
+    }
+
+    ssize_t len = read(m_fd, buf, sizeof(buf));
+    if (len <= 0)
+      throw std::runtime_error("Fail to read file changes");
+
+    for (char* p = buf; p < buf + len;) {
+      inotify_event* e = (inotify_event*)p;
+      p += sizeof(inotify_event) + e->len;
+
+      // events were dropped, any of the files may have changed
+      if (e->mask & IN_Q_OVERFLOW) {
+        std::map<std::string, std::map<std::string, std::string>>::iterator d;
+        for (d = m_files.begin(); d != m_files.end(); ++d)
+          AddAll(d->second, changed);
+        continue;
+      }
+
+      std::map<int, std::string>::iterator dir = m_dirs.find(e->wd);
+      if (dir == m_dirs.end())
+        continue;
+
+      // the directory was removed or renamed: its path is watched again
+      // once it exists, a directory replaced by another has new files
+      if (e->mask & (IN_IGNORED | IN_MOVE_SELF)) {
+        lost.insert(dir->second);
+        m_dirs.erase(dir);
+        if (e->mask & IN_MOVE_SELF)
+          inotify_rm_watch(m_fd, e->wd);
+        continue;
+      }
+      if (e->len == 0)
+        continue;
+
+      // a file being created is reported once it is written
+      if ((e->mask & IN_CREATE) && !(e->mask & IN_ISDIR))
+        continue;
+
+      std::map<std::string, std::string>& files = m_files[dir->second];
+      std::map<std::string, std::string>::iterator f = files.find(e->name);
+      if (f != files.end())
+        changed.insert(f->second);
+    }
+
+    Rewatch(lost, changed, false);
+    if (!changed.empty() || !lost.empty())
+      timeout = quietMs;
+  }
+
+  return std::vector<std::string>(changed.begin(), changed.end());
+}
+
+#else
+
+static long long ModificationTime(const std::string& path) {
+  std::error_code ec;
+  fs::file_time_type t = fs::last_write_time(path, ec);
+  return ec ? -1 : (long long)t.time_since_epoch().count();
+}
+
+CFileWatcher::CFileWatcher() : m_fd(-1) {}
+
+CFileWatcher::~CFileWatcher() {}
+
+void CFileWatcher::Add(const std::string& path) {
+  std::string dir, name;
+  Split(path, dir, name);
+  m_files[dir][name] = path;
+  m_times[path] = ModificationTime(path);
+}
+
+std::vector<std::string> CFileWatcher::Wait(int quietMs) {
+  std::set<std::string> changed;
+  for (;;) {
+    bool more = false;
+    std::map<std::string, long long>::iterator i;
+    for (i = m_times.begin(); i != m_times.end(); ++i) {
+      long long t = ModificationTime(i->first);
+      if (t != i->second) {
+        i->second = t;
+        changed.insert(i->first);
+        more = true;
+      }
+    }
+
+    if (!changed.empty() && !more)
+      break;
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(changed.empty() ? 250 : quietMs));
+  }
+
+  return std::vector<std::string>(changed.begin(), changed.end());
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// reports files that were written, created or replaced.
+// the directories of the files are watched rather than the files, so editors
+// saving through a temporary file and a rename are seen as well.
+// inotify on Linux, polling of the modification times elsewhere. when
+// inotify drops events every file is reported, a watched directory that is
+// removed and not back after quietMs fails Wait.
+class CFileWatcher {
+public:
+  CFileWatcher();
+  ~CFileWatcher();
+
+  void Add(const std::string& path);
+
+  // block until some of the files change, then wait for quietMs without
+  // events so that a burst of writes is reported once
+  // return: the changed files, as given to Add
+  std::vector<std::string> Wait(int quietMs = 50);
+
+private:
+  // inotify
+  void Watch(const std::string& dir);
+  bool Rewatch(std::set<std::string>& lost, std::set<std::string>& changed,
+               bool last);
+
+  // directory -> file name -> path as given to Add
+  std::map<std::string, std::map<std::string, std::string>> m_files;
+  int m_fd;
+  std::map<int, std::string> m_dirs; // watch descriptor -> directory
+  std::map<std::string, long long> m_times; // polling: path -> mtime
+
+  CFileWatcher(const CFileWatcher&);
+  CFileWatcher& operator=(const CFileWatcher&);
+};
+
+#endif
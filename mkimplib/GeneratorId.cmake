@@ -0,0 +1,25 @@
+# cmake -DOUTPUT=<header> -DDIRS=<dir>|<dir>... -P GeneratorId.cmake
+#
+# writes the SHA-256 of the sources of the library generator into the header,
+# the output cache keys change with them. the header is only replaced when the
+# id changes
+string(REPLACE "|" ";" dirs "${DIRS}")
+set(sources)
+foreach(dir ${dirs})
+    file(GLOB found ${dir}/*.cpp ${dir}/*.h)
+    list(APPEND sources ${found})
+endforeach()
+list(FILTER sources EXCLUDE REGEX "/(test|bench)_[^/]*$")
+list(SORT sources)
+
+set(text "")
+foreach(source ${sources})
+    file(SHA256 ${source} hash)
+    get_filename_component(name ${source} NAME)
+    string(APPEND text "${name} ${hash}\n")
+endforeach()
+string(SHA256 id "${text}")
+
+file(WRITE ${OUTPUT}.tmp "#define IMPLIBGEN_GENERATOR_ID \"${id}\"\n")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)
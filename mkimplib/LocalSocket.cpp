@@ -0,0 +1,183 @@
+#include "LocalSocket.h"
+
+#include <cstring>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SO_NOSIGPIPE is set instead
+#endif
+#endif
+
+CLocalSocket::CLocalSocket(CLocalSocket&& other)
+    : m_fd(other.m_fd), m_buf(std::move(other.m_buf)) {
+  other.m_fd = -1;
+}
+
+CLocalSocket& CLocalSocket::operator=(CLocalSocket&& other) {
+  if (this != &other) {
+    Close();
+    m_fd = other.m_fd;
+    m_buf = std::move(other.m_buf);
+    other.m_fd = -1;
+  }
+  return *this;
+}
+
+bool CLocalSocket::ReadLine(std::string& line) {
+  size_t pos;
+  while ((pos = m_buf.find('\n')) == std::string::npos) {
+    if (!Fill()) {
+      if (m_buf.empty())
+        return false;
+      line.swap(m_buf);
+      m_buf.clear();
+      return true;
+    }
+  }
+  line.assign(m_buf, 0, pos);
+  m_buf.erase(0, pos + 1);
+  return true;
+}
+
+bool CLocalSocket::Read(char* buf, size_t len) {
+  while (m_buf.size() < len) {
+    if (!Fill())
+      return false;
+  }
+  memcpy(buf, m_buf.data(), len);
+  m_buf.erase(0, len);
+  return true;
+}
+
+#ifndef _WIN32
+
+static bool MakeAddress(const std::string& path, sockaddr_un& addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    return false;
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+// a socket not inherited by spawned processes, which doesn't raise SIGPIPE
+static int Prepare(int fd) {
+  if (fd >= 0) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+  }
+  return fd;
+}
+
+void CLocalSocket::Close() {
+  if (m_fd >= 0)
+    close(m_fd);
+  m_fd = -1;
+  m_buf.clear();
+}
+
+bool CLocalSocket::Listen(const std::string& path) {
+  Close();
+  sockaddr_un addr;
+  if (!MakeAddress(path, addr))
+    return false;
+
+  // a socket nobody accepts on is stale, anything else is left alone
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    CLocalSocket probe;
+    if (probe.Connect(path))
+      return false;
+    unlink(path.c_str());
+  }
+
+  m_fd = Prepare(socket(AF_UNIX, SOCK_STREAM, 0));
+  if (m_fd < 0)
+    return false;
+  if (bind(m_fd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(m_fd, SOMAXCONN) != 0) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+CLocalSocket CLocalSocket::Accept() {
+  for (;;) {
+    int fd = Prepare(accept(m_fd, 0, 0));
+    if (fd >= 0 || errno != EINTR)
+      return CLocalSocket(fd);
+  }
+}
+
+bool CLocalSocket::Connect(const std::string& path) {
+  Close();
+  sockaddr_un addr;
+  if (!MakeAddress(path, addr))
+    return false;
+
+  m_fd = Prepare(socket(AF_UNIX, SOCK_STREAM, 0));
+  if (m_fd < 0)
+    return false;
+  if (connect(m_fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool CLocalSocket::Write(const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(m_fd, buf, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool CLocalSocket::Fill() {
+  char chunk[64 * 1024];
+  for (;;) {
+    ssize_t n = recv(m_fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    m_buf.append(chunk, n);
+    return true;
+  }
+}
+
+#else
+
+void CLocalSocket::Close() {
+  m_fd = -1;
+  m_buf.clear();
+}
+
+bool CLocalSocket::Listen(const std::string&) { return false; }
+
+CLocalSocket CLocalSocket::Accept() { return CLocalSocket(); }
+
+bool CLocalSocket::Connect(const std::string&) { return false; }
+
+bool CLocalSocket::Write(const char*, size_t) { return false; }
+
+bool CLocalSocket::Fill() { return false; }
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef LOCALSOCKET_H
+#define LOCALSOCKET_H
+
+#include <cstddef>
+#include <string>
+
+// a Unix domain stream socket of the server mode, with a read buffer for
+// line based requests. not available on Windows: Listen and Connect fail.
+class CLocalSocket {
+public:
+  CLocalSocket() : m_fd(-1) {}
+  CLocalSocket(CLocalSocket&& other);
+  CLocalSocket& operator=(CLocalSocket&& other);
+  ~CLocalSocket() { Close(); }
+
+  // a socket file left by a server that is gone is replaced
+  // return: false if the path can't be bound
+  bool Listen(const std::string& path);
+  // return: an unopened socket on failure
+  CLocalSocket Accept();
+  bool Connect(const std::string& path);
+
+  bool IsOpen() const { return m_fd >= 0; }
+  void Close();
+
+  // a line without the '\n'
+  // return: false at the end of the stream before any character
+  bool ReadLine(std::string& line);
+  // exactly len bytes
+  bool Read(char* buf, size_t len);
+  bool Write(const char* buf, size_t len);
+  bool Write(const std::string& s) { return Write(s.data(), s.size()); }
+
+private:
+  int m_fd;
+  std::string m_buf; // received, not consumed yet
+
+  explicit CLocalSocket(int fd) : m_fd(fd) {}
+  bool Fill();
+
+  CLocalSocket(const CLocalSocket&);
+  CLocalSocket& operator=(const CLocalSocket&);
+};
+
+#endif
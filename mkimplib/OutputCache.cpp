@@ -0,0 +1,227 @@
+#include "OutputCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "GeneratorId.h"
+#include "Sha256.h"
+
+namespace fs = std::filesystem;
+
+// the hash of the generator sources, made by the build (GeneratorId.cmake):
+// the libraries of another generator never match
+static const char* CacheFormat = "mkimplib-cache " IMPLIBGEN_GENERATOR_ID;
+
+// unique among the threads and, very likely, the processes writing next to
+// each other
+static std::string TempPath(const std::string& path) {
+  static std::atomic<unsigned> counter(0);
+  size_t id = std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+              (size_t)std::chrono::steady_clock::now().time_since_epoch().count();
+  return path + ".tmp" + std::to_string(id) + "." + std::to_string(++counter);
+}
+
+void WriteFileAtomically(const std::string& path, const char* data,
+                         size_t len) {
+  std::string tmp = TempPath(path);
+  {
+    std::ofstream f(tmp, std::ios::binary);
+    if (!f.is_open())
+      throw std::runtime_error("Fail to create file " + path);
+    f.write(data, len);
+    f.close();
+    if (!f) {
+      std::error_code ec;
+      fs::remove(tmp, ec);
+      throw std::runtime_error("Failed to write to file " + path);
+    }
+  }
+
+  std::error_code ec;
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    throw std::runtime_error("Failed to replace file " + path);
+  }
+}
+
+// chunk of the file comparisons
+static const size_t CompareChunk = 64 * 1024;
+
+bool FileHasContent(const std::string& path, const char* data, size_t len) {
+  std::error_code ec;
+  uintmax_t size = fs::file_size(path, ec);
+  if (ec || size != len)
+    return false;
+
+  std::ifstream f(path, std::ios::binary);
+  std::vector<char> buf(std::min(len, CompareChunk));
+  for (size_t pos = 0; pos < len; pos += buf.size()) {
+    size_t n = std::min(buf.size(), len - pos);
+    if (!f.read(buf.data(), n) || memcmp(buf.data(), data + pos, n) != 0)
+      return false;
+  }
+  return true;
+}
+
+static bool SameFiles(const std::string& a, const std::string& b) {
+  std::error_code ec;
+  uintmax_t size = fs::file_size(a, ec);
+  if (ec || fs::file_size(b, ec) != size || ec)
+    return false;
+
+  std::ifstream fa(a, std::ios::binary), fb(b, std::ios::binary);
+  std::vector<char> ba(CompareChunk), bb(CompareChunk);
+  for (uintmax_t pos = 0; pos < size; pos += CompareChunk) {
+    size_t n = (size_t)std::min<uintmax_t>(CompareChunk, size - pos);
+    if (!fa.read(ba.data(), n) || !fb.read(bb.data(), n) ||
+        memcmp(ba.data(), bb.data(), n) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool ParseByteSize(const char* text, uint64_t* bytes) {
+  // strtoull takes -1 and wraps it around
+  if (!isdigit((unsigned char)text[0]))
+    return false;
+  char* end;
+  errno = 0;
+  unsigned long long n = strtoull(text, &end, 10);
+  if (errno == ERANGE)
+    return false;
+
+  int shift = 0;
+  switch (*end) {
+  case 'G': case 'g': shift = 30; ++end; break;
+  case 'M': case 'm': shift = 20; ++end; break;
+  case 'K': case 'k': shift = 10; ++end; break;
+  }
+
+  if (*end != 0 || n > (UINT64_MAX >> shift))
+    return false;
+  *bytes = (uint64_t)n << shift;
+  return true;
+}
+
+COutputCache::COutputCache(const std::string& dir, uint64_t maxBytes,
+                           CacheEvictionPolicy policy)
+    : m_dir(dir), m_maxBytes(maxBytes), m_policy(policy) {}
+
+std::string COutputCache::Key(const Sora::CManifest& m,
+                              const std::string& options) {
+  Sora::CSha256 hash;
+  hash.Update(CacheFormat, strlen(CacheFormat) + 1);
+  hash.Update(options.c_str(), options.size() + 1);
+  Sora::HashManifest(m, hash);
+  return hash.HexDigest();
+}
+
+std::string COutputCache::EntryPath(const std::string& key) const {
+  return (fs::path(m_dir) / key.substr(0, 2) / (key + ".lib")).string();
+}
+
+bool COutputCache::Fetch(const std::string& key, const std::string& output) {
+  std::string entry = EntryPath(key);
+  std::string tmp = TempPath(output);
+
+  // a copy, never a link: the outputs would share the time stamp the LRU
+  // refreshes, and a tool editing an output in place would write into the
+  // cache
+  std::error_code ec;
+  if (!fs::copy_file(entry, tmp, fs::copy_options::overwrite_existing, ec)) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+
+  fs::rename(tmp, output, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+
+  if (m_policy == CEP_LRU)
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  return true;
+}
+
+bool COutputCache::Matches(const std::string& key,
+                           const std::string& output) {
+  std::string entry = EntryPath(key);
+  if (!SameFiles(entry, output))
+    return false;
+  std::error_code ec;
+  if (m_policy == CEP_LRU)
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  return true;
+}
+
+void COutputCache::Store(const std::string& key, const char* data,
+                         size_t len) {
+  std::string entry = EntryPath(key);
+
+  std::error_code ec;
+  fs::create_directories(fs::path(entry).parent_path(), ec);
+  try {
+    WriteFileAtomically(entry, data, len);
+  } catch (std::exception&) {
+  }
+}
+
+void COutputCache::Evict() {
+  if (m_maxBytes == 0)
+    return;
+
+  struct Entry {
+    fs::path path;
+    uint64_t size;
+    fs::file_time_type time;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+
+  std::error_code ec;
+  for (fs::recursive_directory_iterator i(m_dir, ec), iend; !ec && i != iend;
+       i.increment(ec)) {
+    bool regular = i->is_regular_file(ec);
+    if (ec || !regular || i->path().extension() != ".lib") {
+      ec.clear();
+      continue;
+    }
+
+    Entry e;
+    e.path = i->path();
+    e.size = i->file_size(ec);
+    e.time = i->last_write_time(ec);
+    if (ec) {
+      ec.clear();
+      continue;
+    }
+    total += e.size;
+    entries.push_back(e);
+  }
+
+  if (total <= m_maxBytes)
+    return;
+
+  // oldest first: least recently used, or first added with CEP_FIFO
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.time < b.time; });
+
+  for (size_t i = 0; i < entries.size() && total > m_maxBytes; ++i) {
+    if (fs::remove(entries[i].path, ec))
+      total -= entries[i].size;
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef OUTPUTCACHE_H
+#define OUTPUTCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Manifest.h"
+
+enum CacheEvictionPolicy {
+  CEP_LRU,  // a hit makes the entry the newest one
+  CEP_FIFO  // entries are evicted in the order they were added
+};
+
+// content-addressed store of generated libraries:
+// <dir>/<first two hex digits of the key>/<key>.lib
+//
+// several processes may share the directory: entries are written to a
+// temporary file and renamed into place, readers never see a partial one.
+// the cache is best effort, failures to store or evict are ignored.
+class COutputCache {
+public:
+  // maxBytes: the size Evict trims the cache to, 0: unlimited
+  COutputCache(const std::string& dir, uint64_t maxBytes,
+               CacheEvictionPolicy policy);
+
+  // the key of the library built from the manifest by this version of the
+  // tool with the given options
+  static std::string Key(const Sora::CManifest& m, const std::string& options);
+
+  // place a copy of the cached library at output
+  // return: false on a miss
+  bool Fetch(const std::string& key, const std::string& output);
+
+  // true if output already holds the library of the key, it can be left
+  // alone
+  bool Matches(const std::string& key, const std::string& output);
+
+  void Store(const std::string& key, const char* data, size_t len);
+
+  // remove the oldest entries until the cache fits the size limit
+  void Evict();
+
+private:
+  std::string m_dir;
+  uint64_t m_maxBytes;
+  CacheEvictionPolicy m_policy;
+
+  std::string EntryPath(const std::string& key) const;
+};
+
+// parses 100, 64K, 512M, 2G
+// return: false if the text isn't a size or the size is over 64 bits
+bool ParseByteSize(const char* text, uint64_t* bytes);
+
+// write to a temporary file next to path and rename it over path, so path
+// is either the old or the new file, never a partial one
+void WriteFileAtomically(const std::string& path, const char* data,
+                         size_t len);
+
+// true if the file at path is exactly data, false if it differs or is missing.
+// a size mismatch decides without reading the file
+bool FileHasContent(const std::string& path, const char* data, size_t len);
+
+#endif
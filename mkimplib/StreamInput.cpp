@@ -0,0 +1,112 @@
+#include "StreamInput.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "BinaryManifest.h"
+#include "Manifest.h"
+
+// big enough for the binary frames of most dlls in one read
+static const size_t ReadChunk = 256 * 1024;
+
+CStreamInput::CStreamInput(FILE* f) : m_file(f), m_pos(0), m_records(0) {}
+
+bool CStreamInput::Fill() {
+  // the consumed bytes are dropped before the buffer grows
+  if (m_pos > 0) {
+    m_buf.erase(m_buf.begin(), m_buf.begin() + m_pos);
+    m_pos = 0;
+  }
+
+  size_t have = m_buf.size();
+  m_buf.resize(have + ReadChunk);
+  size_t got = fread(m_buf.data() + have, 1, ReadChunk, m_file);
+  m_buf.resize(have + got);
+  return got > 0;
+}
+
+bool CStreamInput::ReadLine(std::vector<char>& line) {
+  size_t scanned = 0; // after m_pos, without a newline
+  for (;;) {
+    std::vector<char>::iterator begin = m_buf.begin() + m_pos;
+    std::vector<char>::iterator nl =
+        std::find(begin + scanned, m_buf.end(), '\n');
+    if (nl != m_buf.end()) {
+      line.assign(begin, nl);
+      m_pos = nl - m_buf.begin() + 1;
+      return true;
+    }
+
+    scanned = m_buf.size() - m_pos;
+    if (scanned > MaxManifestSize)
+      throw std::runtime_error("Line of record " +
+                               std::to_string(m_records + 1) +
+                               " in the stream over 1 GB");
+    if (!Fill()) {
+      // the last line may have no newline
+      if (m_pos == m_buf.size())
+        return false;
+      line.assign(m_buf.begin() + m_pos, m_buf.end());
+      m_pos = m_buf.size();
+      return true;
+    }
+  }
+}
+
+bool CStreamInput::Read(char* buf, size_t len) {
+  while (len > 0) {
+    if (m_pos == m_buf.size() && !Fill())
+      return false;
+    size_t n = std::min(len, m_buf.size() - m_pos);
+    memcpy(buf, m_buf.data() + m_pos, n);
+    m_pos += n;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool CStreamInput::Next(std::string& file, std::vector<char>& text) {
+  if (m_pos == m_buf.size() && !Fill())
+    return false;
+
+  std::string error =
+      "Bad record " + std::to_string(m_records + 1) + " in the stream";
+
+  // JSON lines, blank ones are skipped
+  if (m_buf[m_pos] != Sora::BinaryStreamMagic[0]) {
+    do {
+      if (!ReadLine(text))
+        return false;
+      while (!text.empty() && (text.back() == '\r' || text.back() == ' '))
+        text.pop_back();
+    } while (text.empty());
+
+    if (!Sora::ParseJsonStreamFile(std::string_view(text.data(), text.size()),
+                                   file))
+      throw std::runtime_error(error + ", no \"file\" first");
+    ++m_records;
+    return true;
+  }
+
+  Sora::BinaryStreamFrame h;
+  if (!Read((char*)&h, sizeof(h)) ||
+      memcmp(h.magic, Sora::BinaryStreamMagic, 4) != 0)
+    throw std::runtime_error(error);
+
+  // a corrupt size fails before it is allocated
+  if (h.fileSize > MaxStreamFileSize || h.manifestSize > MaxManifestSize)
+    throw std::runtime_error(error + ", too big");
+
+  char pad[4];
+  file.resize(h.fileSize);
+  text.resize(h.manifestSize);
+  if (!Read(&file[0], file.size()) ||
+      !Read(pad, Sora::BinaryStreamPadding(h.fileSize)) ||
+      !Read(text.data(), text.size()) ||
+      !Read(pad, Sora::BinaryStreamPadding(h.manifestSize)))
+    throw std::runtime_error(error + ", cut short");
+  ++m_records;
+  return true;
+}
@@ -0,0 +1,49 @@
+#ifndef STREAMINPUT_H
+#define STREAMINPUT_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// the largest manifest read from a pipe or a socket (--stream, --inline),
+// far more than the 1M exports of a JSON manifest take: a corrupt size fails
+// the record, not the memory
+static const size_t MaxManifestSize = (size_t)1 << 30;
+
+// the longest path of a dll in a binary frame, the longest Windows path
+static const size_t MaxStreamFileSize = 32767;
+
+// the manifests dumpsyms /STREAM writes, read from a pipe: JSON lines with
+// the path of the dll as "file", or with /BINARY frames of binary manifests
+// (Manifest/BinaryManifest.h). the format is told by the first byte.
+class CStreamInput {
+public:
+  explicit CStreamInput(FILE* f);
+
+  // the next manifest, in any format ParseManifest reads, and the path of
+  // its dll. throws std::runtime_error on a bad record
+  // return: false at the end of the stream
+  bool Next(std::string& file, std::vector<char>& text);
+
+  size_t GetRecordCount() const { return m_records; }
+
+private:
+  FILE* m_file;
+  std::vector<char> m_buf; // read, not consumed yet from m_pos
+  size_t m_pos;
+  size_t m_records;
+
+  // return: false at the end of the stream
+  bool Fill();
+  // return: false at the end of the stream before any byte, throws on a
+  // line longer than MaxManifestSize
+  bool ReadLine(std::vector<char>& line);
+  // exactly len bytes
+  bool Read(char* buf, size_t len);
+
+  CStreamInput(const CStreamInput&);
+  CStreamInput& operator=(const CStreamInput&);
+};
+
+#endif
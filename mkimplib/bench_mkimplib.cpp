@@ -0,0 +1,205 @@
+// end-to-end time of mkimplib on one .def of 1k to 1M exports, x86 and x64
+//
+// usage: bench_mkimplib [--json <file>] [--seed <n>] [export count ...]
+//
+// the .def is a synthetic export set (SyntheticManifest.h): names of 8 to 32
+// characters, a quarter stdcall, a tenth by ordinal only. mkimplib is taken from the directory of bench_mkimplib and run once per
+// count and architecture with --stats=json, MKIMPLIB_CACHE unset. the table
+// gives the wall time of the process, the size of the library and the
+// phases mkimplib reports. with --json every run is also written to the file
+// as a JSON line, mkimplib's own report under "stats":
+// {"bench": "mkimplib", "case": "x64", "n": 1000, "ms": 12.3, "ns_per_item": 12300.0,
+//  "lib_bytes": 123456, "stats": {"phases": ..., "peak_rss_bytes": ...}}
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "SyntheticManifest.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace fs = std::filesystem;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+#ifdef _WIN32
+
+int main() {
+  printf("bench_mkimplib runs mkimplib with posix_spawn, not supported here\n");
+  return 0;
+}
+
+#else
+
+static void WriteDef(const fs::path& path, int n, uint64_t seed) {
+  FILE* f = fopen(path.string().c_str(), "w");
+  if (f == 0) {
+    printf("Fail to create %s\n", path.string().c_str());
+    exit(EXIT_FAILURE);
+  }
+  Sora::SyntheticSpec spec;
+  spec.count = n;
+  spec.dllName = "bench.dll";
+  spec.seed = seed;
+  spec.stdcall = 0.25;
+  spec.ordinalOnly = 0.1;
+  std::string text;
+  Sora::WriteSyntheticManifest(spec, true, text, [f](const std::string& t) {
+    fwrite(t.data(), 1, t.size(), f);
+  });
+  fclose(f);
+}
+
+// runs the command with its stdout into the file
+// return: the time in ms
+static double Run(const std::vector<std::string>& args, const fs::path& out) {
+  std::vector<char*> argv;
+  for (size_t i = 0; i < args.size(); ++i)
+    argv.push_back((char*)args[i].c_str());
+  argv.push_back(0);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 1, out.string().c_str(),
+                                   O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  Clock::time_point start = Clock::now();
+  pid_t pid;
+  if (posix_spawn(&pid, argv[0], &actions, 0, argv.data(), environ) != 0) {
+    fprintf(stderr, "Fail to run %s\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  double ms = MsSince(start);
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  return ms;
+}
+
+static std::string ReadFile(const fs::path& path) {
+  std::ifstream f(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(f),
+                     std::istreambuf_iterator<char>());
+}
+
+// the pretty printed report of --stats=json on one line
+static std::string OneLine(const std::string& text) {
+  std::string r;
+  bool space = false;
+  for (size_t i = 0; i < text.size(); ++i) {
+    char c = text[i];
+    if (c == '\n' || c == ' ') {
+      space = true;
+      continue;
+    }
+    if (space && !r.empty() && r.back() != '{' && c != '}')
+      r += ' ';
+    space = false;
+    r += c;
+  }
+  return r;
+}
+
+// the ms of a phase in the report, -1 if not found
+static double PhaseMs(const std::string& stats, const char* phase) {
+  std::string key = std::string("\"") + phase + "\": {";
+  size_t at = stats.find(key);
+  if (at == std::string::npos)
+    return -1;
+  at = stats.find("\"ms\": ", at);
+  if (at == std::string::npos)
+    return -1;
+  return atof(stats.c_str() + at + 6);
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<int> counts;
+  FILE* json = 0;
+  uint64_t seed = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      json = fopen(argv[++i], "w");
+      if (json == 0) {
+        printf("Fail to create %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], 0, 0);
+    } else {
+      counts.push_back(atoi(argv[i]));
+    }
+  }
+  if (counts.empty())
+    counts = {1000, 10000, 100000, 1000000};
+
+  std::string mkimplib =
+      (fs::absolute(argv[0]).parent_path() / "mkimplib").string();
+  // a library from the cache would time the cache
+  unsetenv("MKIMPLIB_CACHE");
+
+  fs::path dir = fs::temp_directory_path() /
+                 ("bench_mkimplib-" + std::to_string(getpid()));
+  fs::create_directories(dir);
+  fs::path def = dir / "bench.def", lib = dir / "bench.lib",
+           out = dir / "stats.json";
+
+  printf("%8s %4s %10s %12s %9s %9s %9s %9s\n", "exports", "arch", "wall ms",
+         "lib bytes", "parse", "build", "rawdata", "peak MB");
+  for (size_t c = 0; c < counts.size(); ++c) {
+    WriteDef(def, counts[c], seed);
+    for (int arch = 32; arch <= 64; arch += 32) {
+      double ms = Run({mkimplib, "--stats=json", "--arch",
+                       std::to_string(arch), def.string(), lib.string()},
+                      out);
+      std::string stats = OneLine(ReadFile(out));
+      uintmax_t bytes = fs::file_size(lib);
+      size_t rss = 0;
+      size_t at = stats.find("\"peak_rss_bytes\": ");
+      if (at != std::string::npos)
+        rss = strtoull(stats.c_str() + at + 18, 0, 10);
+
+      const char* name = arch == 64 ? "x64" : "x86";
+      printf("%8d %4s %10.2f %12ju %9.2f %9.2f %9.2f %9.1f\n", counts[c], name,
+             ms, bytes, PhaseMs(stats, "parse"), PhaseMs(stats, "build"),
+             PhaseMs(stats, "rawdata"), rss / 1048576.0);
+      if (json)
+        fprintf(json,
+                "{\"bench\": \"mkimplib\", \"case\": \"%s\", \"n\": %d, "
+                "\"ms\": %.3f, \"ns_per_item\": %.1f, \"lib_bytes\": %ju, "
+                "\"stats\": %s}\n",
+                name, counts[c], ms, ms * 1e6 / counts[c], bytes,
+                stats.c_str());
+    }
+  }
+
+  fs::remove_all(dir);
+  if (json)
+    fclose(json);
+  return 0;
+}
+
+#endif
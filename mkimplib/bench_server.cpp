@@ -0,0 +1,201 @@
+// time of generating many small libraries: a mkimplib process per DLL, an
+// mkimplibc process per DLL talking to mkimplib --serve, and requests sent
+// on open connections without any process, the floor of the server mode
+//
+// usage: bench_server [DLL count] [exports per DLL] [parallel jobs]
+//
+// mkimplib and mkimplibc are taken from the directory of bench_server.
+// the jobs run in parallel like a build would run them, one per hardware
+// thread by default. the libraries of the three runs must be identical.
+
+#include "LocalSocket.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace fs = std::filesystem;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+#ifdef _WIN32
+
+int main() {
+  printf("the server mode needs Unix domain sockets, not supported here\n");
+  return 0;
+}
+
+#else
+
+static pid_t Spawn(const std::vector<std::string>& args) {
+  std::vector<char*> argv;
+  for (size_t i = 0; i < args.size(); ++i)
+    argv.push_back((char*)args[i].c_str());
+  argv.push_back(0);
+
+  pid_t pid;
+  if (posix_spawn(&pid, argv[0], 0, 0, argv.data(), environ) != 0) {
+    fprintf(stderr, "Fail to run %s\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  return pid;
+}
+
+// runs the commands, jobs of them at a time
+static double RunProcesses(const std::vector<std::vector<std::string>>& cmds,
+                           int jobs) {
+  Clock::time_point start = Clock::now();
+  size_t next = 0, running = 0;
+  while (next < cmds.size() || running > 0) {
+    if (next < cmds.size() && running < (size_t)jobs) {
+      Spawn(cmds[next++]);
+      ++running;
+      continue;
+    }
+    int status;
+    if (wait(&status) > 0) {
+      --running;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "A generator run failed\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+  return MsSince(start);
+}
+
+// jobs connections, each sending its share of the requests in turn
+static double RunRequests(const std::string& socket,
+                          const std::vector<std::string>& requests,
+                          int jobs) {
+  Clock::time_point start = Clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < jobs; ++t) {
+    threads.emplace_back([&, t]() {
+      CLocalSocket s;
+      if (!s.Connect(socket)) {
+        fprintf(stderr, "Fail to connect to %s\n", socket.c_str());
+        exit(EXIT_FAILURE);
+      }
+      std::string reply;
+      for (size_t i = t; i < requests.size(); i += jobs) {
+        if (!s.Write(requests[i]) || !s.ReadLine(reply) ||
+            reply.compare(0, 3, "ok ") != 0) {
+          fprintf(stderr, "Request failed: %s\n", reply.c_str());
+          exit(EXIT_FAILURE);
+        }
+      }
+    });
+  }
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+  return MsSince(start);
+}
+
+static std::string ReadFile(const fs::path& path) {
+  std::ifstream f(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(f),
+                     std::istreambuf_iterator<char>());
+}
+
+static std::string Library(const fs::path& dir, int run, int i) {
+  return (dir / ("lib" + std::to_string(i) + "." + std::to_string(run) +
+                 ".lib"))
+      .string();
+}
+
+int main(int argc, char* argv[]) {
+  int count = argc > 1 ? atoi(argv[1]) : 500;
+  int exports = argc > 2 ? atoi(argv[2]) : 100;
+  int jobs = argc > 3 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+  if (jobs <= 0)
+    jobs = 1;
+
+  fs::path bin = fs::absolute(argv[0]).parent_path();
+  std::string mkimplib = (bin / "mkimplib").string();
+  std::string mkimplibc = (bin / "mkimplibc").string();
+
+  fs::path dir = fs::temp_directory_path() /
+                 ("bench_server." + std::to_string(getpid()));
+  fs::create_directories(dir);
+  std::string socket = (dir / "mkimplib.sock").string();
+
+  std::vector<std::string> inputs;
+  for (int i = 0; i < count; ++i) {
+    std::string path = (dir / ("dll" + std::to_string(i) + ".def")).string();
+    std::ofstream f(path);
+    f << "LIBRARY dll" << i << ".dll\nEXPORTS\n";
+    for (int j = 0; j < exports; ++j)
+      f << "  Function" << i << "_" << j << "@" << (j % 4) * 4 << "\n";
+    inputs.push_back(path);
+  }
+
+  // 0: mkimplib per DLL, 1: mkimplibc per DLL, 2: requests
+  std::vector<std::vector<std::string>> spawn, client;
+  std::vector<std::string> requests;
+  for (int i = 0; i < count; ++i) {
+    spawn.push_back({mkimplib, inputs[i], Library(dir, 0, i)});
+    client.push_back({mkimplibc, "--server", socket, inputs[i],
+                      Library(dir, 1, i)});
+    requests.push_back(dir.string() + " " + inputs[i] + " " +
+                       Library(dir, 2, i) + "\n");
+  }
+
+  double ms[3];
+  ms[0] = RunProcesses(spawn, jobs);
+
+  pid_t server = Spawn({mkimplib, "--serve", socket, "-j",
+                        std::to_string(jobs)});
+  CLocalSocket probe;
+  for (int i = 0; i < 500 && !probe.Connect(socket); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  probe.Close();
+
+  ms[1] = RunProcesses(client, jobs);
+  ms[2] = RunRequests(socket, requests, jobs);
+
+  kill(server, SIGTERM);
+  waitpid(server, 0, 0);
+
+  for (int i = 0; i < count; ++i) {
+    std::string lib = ReadFile(Library(dir, 0, i));
+    if (lib.empty() || lib != ReadFile(Library(dir, 1, i)) ||
+        lib != ReadFile(Library(dir, 2, i))) {
+      fprintf(stderr, "The libraries of %s differ\n", inputs[i].c_str());
+      return EXIT_FAILURE;
+    }
+  }
+  fs::remove_all(dir);
+
+  static const char* names[3] = {"mkimplib per DLL", "mkimplibc per DLL",
+                                 "requests, no process"};
+  printf("%d DLLs of %d exports, %d parallel jobs\n", count, exports, jobs);
+  printf("%-22s %10s %10s %10s\n", "", "total ms", "ms/DLL", "DLLs/s");
+  for (int r = 0; r < 3; ++r) {
+    printf("%-22s %10.1f %10.3f %10.0f\n", names[r], ms[r], ms[r] / count,
+           count * 1000.0 / ms[r]);
+  }
+  return 0;
+}
+
+#endif
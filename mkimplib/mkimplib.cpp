@@ -1,9 +1,111 @@
 /**
- * This program generates an import library from a JSON configuration file.
- * 
+ * This program generates an import library from a JSON configuration file,
+ * a .def file or the export table of the DLL itself.
+ *
  * Usage:
- *   MakeImpLib <input json> <output lib>
- * 
+ *   MakeImpLib [options] <input> <output lib>
+ *   MakeImpLib --from-dll <dll> <output lib>
+ *   MakeImpLib --batch [options] [-j <threads>] <input> <output lib> ...
+ *   MakeImpLib --batch [options] [-j <threads>] @<response file> ...
+ *   MakeImpLib --watch [options] [-j <threads>] <input> <output lib> ...
+ *   MakeImpLib --serve <socket> [-j <threads>] [--cache <dir>]
+ *   dumpsyms <directory> /STREAM | MakeImpLib --stream <output directory>
+ *       [options] [-j <threads>]
+ *
+ * Options:
+ *   --arch 32|64  architecture of .def inputs, x86 by default. stdcall and
+ *                 fastcall names (Sleep@4, @Add@8) are decorated for x86.
+ *   --from-dll    read the input as a PE image. DLLs are also recognized by
+ *                 their MZ signature without this option.
+ *   --targets 32,64
+ *                 fan-out: one library per architecture from a single parse,
+ *                 built in parallel. the output name must contain {arch},
+ *                 replaced by x86 or x64. .def names are decorated for each
+ *                 target, names given in the manifest are used as they are.
+ *   --shard-size <exports>
+ *                 build the members of a bigger export list in shards of
+ *                 this many exports on all the threads, merged into the same
+ *                 library. 4096 by default, 0: one thread per library.
+ *   --stats[=json] time every phase (parse, addimport, descriptor,
+ *                 pushrelocs, build, linkmembers, filloffsets, rawdata,
+ *                 write), count exports, members, symbols and bytes, count
+ *                 the allocations of every phase, and report the peak RSS,
+ *                 as a table or JSON.
+ *   --trace <file>
+ *                 write a timeline of the run in the Chrome trace-event
+ *                 format, for chrome://tracing or ui.perfetto.dev: the jobs,
+ *                 libraries, shards, phases and members of every thread, the
+ *                 depth of the queues and the bytes written. only in a build
+ *                 with -DIMPLIBGEN_TRACE=ON.
+ *   --cache <dir> reuse libraries generated before for the same export set,
+ *                 MKIMPLIB_CACHE if not given. the key is the hash of the
+ *                 loaded manifest, whatever its format, and the options.
+ *   --cache-size <bytes>      trim the cache to this size, K/M/G suffixes
+ *                             allowed, 0: unlimited. 1G by default.
+ *   --cache-policy lru|fifo   which entries to evict first, lru by default.
+ *   -MD           write a depfile next to each library, <output>.d, naming
+ *                 the libraries and the files read to make them, for Make
+ *                 and Ninja (deps = gcc).
+ *   -MF <file>    the depfile of a single library, implies -MD.
+ *   --if-changed  leave a library alone if the new one is byte for byte the
+ *                 same, so its time stays and restat skips the dependents.
+ *   --include <pattern>   only the exports matching one of the includes or
+ *                         allow lists go into the library.
+ *   --exclude <pattern>   leave the matching exports out.
+ *   --no-stub <pattern>   no call stub for the matching exports, only their
+ *                         __imp_ pointer.
+ *   --allow-list <file>   the names to keep, one per line, # comments.
+ *                 patterns are globs (* ?) or regexes after re:, matched
+ *                 against the whole export name.
+ *   --used-by <object|archive|@list>
+ *                 only the imports the COFF objects and archives reference,
+ *                 by their __imp_ or stub name; stubs nobody calls are left
+ *                 out. a @list names one file per line. the files are mapped
+ *                 and scanned in parallel, once for all the libraries.
+ *   --import-final
+ *                 import the forwarded exports from the DLL at the end of
+ *                 their forwarder chain (the target dumpsyms /RESOLVE
+ *                 records, the forwarder otherwise), saving the loader the
+ *                 hops. the library gets an import descriptor for each of
+ *                 those DLLs.
+ *
+ * The batch mode generates all the libraries in one process on a pool of
+ * worker threads and prints the aggregate timing. A response file lists one
+ * "<input json> <output lib>" pair per line, paths with spaces are quoted,
+ * lines starting with # are ignored.
+ *
+ * The watch mode takes the same arguments as the batch mode, generates all
+ * the libraries, then stays resident and regenerates the libraries of the
+ * inputs that change (inotify on Linux), until interrupted. The hash of each
+ * export set is kept, an input saved with the same exports is not rebuilt.
+ * A changed --allow-list or --used-by file is read again for all the inputs.
+ *
+ * The stream mode reads the manifests dumpsyms /STREAM writes from stdin,
+ * JSON lines or binary frames, and builds a library for each while dumpsyms
+ * is still dumping, no file in between: <output directory>/<path of the dll
+ * relative to the directory dumped, .lib instead of .dll>, -{arch} before
+ * .lib with several --targets. The main thread reads the stream into a
+ * queue of two manifests per thread, one task per thread builds the
+ * libraries. When the builders fall behind the queue fills, the pipe is
+ * no longer read and dumpsyms waits.
+ *
+ * The server mode listens on a Unix domain socket and generates libraries
+ * for mkimplibc, a client taking the arguments of a single mkimplib run, so
+ * a build spawns the small client instead of loading the generator for
+ * every DLL. Each connection is read by its own thread, the libraries are
+ * generated on the pool, the cache is shared by all clients. A request is
+ * one line of words, quoted if they contain spaces:
+ *   <working directory> [--arch 32|64] [--from-dll] [--targets 32,64]
+ *       [-MD] [-MF <file>] [--if-changed] [--include <pattern>] ...
+ *       [--used-by <file>] ... [--import-final]
+ *       [--inline <n>] <input> <output lib>
+ * relative paths are taken from the working directory of the client. With
+ * --inline, n bytes of export list in any input format follow the line and
+ * <input> only names it in messages, at most 1 GB. The reply is one line:
+ *   ok <libraries> <from cache> <symbols> <bytes> <ms>
+ *   error <message>
+ * A connection may send several requests, one after the other.
+ *
  * The input JSON structure includes:
  * - dllname: The name of the DLL.
  * - arch: Architecture (32 or 64-bit).
@@ -13,7 +115,7 @@
  *   - ord: Ordinal name.
  *   - thunk: Thunk name.
  *   - pubname: Public name.
- * 
+ *
  * Example JSON input:
  * {
  *   "dllname": "kernel32.dll",
@@ -30,85 +132,1122 @@
  * }
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
-#include <nlohmann/json.hpp>
+#include <memory>
+#include <mutex>
+#include <filesystem>
+#include <string>
+#include <thread>
 #include <vector>
-#include <Windows.h>
 
-#include "LibGenHelperFactory.h"
 #include "LibGenHelperInterfaces.h"
+#include "Manifest.h"
+#include "BoundedQueue.h"
+#include "BuildStats.h"
+#include "CoffScan.h"
+#include "FileWatcher.h"
+#include "LocalSocket.h"
+#include "OutputCache.h"
+#include "Sha256.h"
+#include "StreamInput.h"
+#include "SymbolFilter.h"
+#include "WorkPool.h"
+#include "coffTrace.h"
 
-using json = nlohmann::json;
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 struct MyMsgException {
   std::string fmt;
   std::string msg;
   MyMsgException(const char* p) : msg(p), fmt("%s") {}
   MyMsgException(const char* p1, const char* p2) : fmt(p1), msg(p2) {}
+
+  std::string Text() const {
+    std::vector<char> buf(fmt.size() + msg.size() + 1);
+    snprintf(buf.data(), buf.size(), fmt.c_str(), msg.c_str());
+    return buf.data();
+  }
 };
 
-int main(int argc, char* argv[]) {
+typedef std::chrono::steady_clock Clock;
+
+static double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+#ifdef IMPLIBGEN_TRACE
+// the libraries and depfiles written so far, for the trace counter
+static std::atomic<long long> s_bytesWritten(0);
+#endif
+
+struct Options {
+  int arch = 0; // for inputs without architecture, 0: default
+  int threads = 0;
+  bool fromDll = false;
+  std::vector<int> targets; // fan-out architectures, empty: the input's
+  int shardSize = 4096; // exports per shard of a library, 0: no sharding
+  COutputCache* cache = 0;
+  Sora::CWorkPool* pool = 0; // for batch jobs and fan-out targets
+  bool watch = false;
+  bool depfile = false; // -MD
+  std::string depfilePath; // -MF, for a single library
+  bool ifChanged = false;
+
+  // --include, --exclude, --no-stub and --allow-list, compiled into filter
+  // by SetupFilter
+  std::vector<std::pair<Sora::SymbolRule, std::string>> rules;
+  std::vector<std::string> allowLists;
+  std::shared_ptr<const Sora::CSymbolFilter> filter;
+
+  // --used-by, the lists expanded and scanned into references by
+  // SetupReferences
+  std::vector<std::string> usedBy;
+  std::vector<std::string> usedByArgs; // as given, for --watch to scan again
+  std::shared_ptr<const Sora::CSymbolReferences> references;
+
+  bool importFinal = false;
+};
+
+// one manifest -> library pair, or one library per target
+struct Job {
+  std::string input;
+  std::string output; // with {arch} for fan-out
+  // --serve: the export list sent with the request, read instead of input
+  std::shared_ptr<std::vector<char>> text;
+
+  // filled by RunJob
+  bool ok = false;
+  std::string error;
+  size_t symbols = 0;
+  size_t libraries = 0;
+  size_t cached = 0; // libraries taken from the cache
+  size_t kept = 0; // --if-changed: libraries that were already up to date
+  size_t bytes = 0;
+  double ms = 0;
+
+  // --watch: the hash of the export set the libraries were made of
+  std::string exports;
+  bool unchanged = false; // the input changed, its exports didn't
+
+  // the files read for the libraries and the libraries, for the depfile
+  std::vector<std::string> deps;
+  std::vector<std::string> outputs;
+};
+
+// one library of a job
+struct Target {
+  Sora::CManifest manifest;
+  std::string output;
+  size_t bytes = 0;
+  bool cached = false;
+  bool kept = false; // --if-changed: the output already was this library
+};
+
+static std::string OutputFor(const std::string& pattern, int arch) {
+  std::string r = pattern;
+  size_t pos = r.find("{arch}");
+  if (pos != std::string::npos)
+    r.replace(pos, 6, Sora::ArchitectureName(arch));
+  return r;
+}
+
+static void WriteLibrary(const Options& opts, Target& t) {
+  SORA_TRACE_SCOPE_ARG("library", "output", t.output);
+  // after the decoration for the target, the references are decorated
+  if (opts.references)
+    Sora::PruneUnreferenced(t.manifest, *opts.references);
+  const Sora::CManifest& manifest = t.manifest;
+
+  std::string key;
+  if (opts.cache != 0) {
+    // the arch is part of the manifest, no other option changes the output
+    key = COutputCache::Key(manifest, "");
+    t.kept = opts.ifChanged && opts.cache->Matches(key, t.output);
+    if (t.kept || opts.cache->Fetch(key, t.output)) {
+      std::ifstream f(t.output, std::ios::binary | std::ios::ate);
+      t.bytes = (size_t)f.tellg();
+      t.cached = true;
+      return;
+    }
+  }
+
+  // a big export list is built in shards on the threads, a single library
+  // gets a pool of its own for it. one thread gains nothing from shards
+  std::unique_ptr<Sora::CWorkPool> ownPool;
+  Sora::CWorkPool* pool = opts.pool;
+  bool shard = opts.shardSize > 0 &&
+               manifest.symbols.size() > (size_t)opts.shardSize;
+  if (shard && pool == 0) {
+    ownPool.reset(new Sora::CWorkPool(opts.threads));
+    pool = ownPool.get();
+  }
+  shard = shard && pool->GetThreadCount() > 1;
+
+  Sora::IImportLibraryBuilder* impBuilder = Sora::CreateImpLibBuilder(manifest);
+  if (shard)
+    impBuilder->SetSharding(pool, opts.shardSize);
+  Sora::AddImports(manifest, impBuilder);
+
+  // Save file
+  impBuilder->Build();
+
+  int nFileSize = impBuilder->GetDataLength();
+  std::vector<char> buffer(nFileSize);
+  impBuilder->GetRawData(reinterpret_cast<PBYTE>(buffer.data()));
+  impBuilder->Dispose();
+
+  // never written in place: readers see the old or the new library
+  {
+    Sora::CPhaseScope phase(Sora::BP_WRITE);
+    if (opts.ifChanged && FileHasContent(t.output, buffer.data(), nFileSize))
+      t.kept = true;
+    else
+      WriteFileAtomically(t.output, buffer.data(), nFileSize);
+    if (opts.cache != 0)
+      opts.cache->Store(key, buffer.data(), nFileSize);
+  }
+  if (!t.kept)
+    SORA_TRACE_COUNTER("bytes written", s_bytesWritten += nFileSize);
+
+  t.bytes = nFileSize;
+}
+
+// in Make syntax, which Ninja reads too: spaces and # escaped, $ doubled
+static std::string DepfileEscape(const std::string& path) {
+  std::string r;
+  for (size_t i = 0; i < path.size(); ++i) {
+    if (path[i] == ' ' || path[i] == '#')
+      r += '\\';
+    else if (path[i] == '$')
+      r += '$';
+    r += path[i];
+  }
+  return r;
+}
+
+// <libraries>: <files read>, by -MF or next to the first library
+static void WriteDepfile(const Options& opts, const Job& job) {
+  std::string text;
+  for (size_t i = 0; i < job.outputs.size(); ++i)
+    text += (i ? " " : "") + DepfileEscape(job.outputs[i]);
+  text += ":";
+  for (size_t i = 0; i < job.deps.size(); ++i)
+    text += " \\\n  " + DepfileEscape(job.deps[i]);
+  text += "\n";
+
+  std::string path = opts.depfilePath;
+  if (path.empty())
+    path = job.outputs[0] + ".d";
+  WriteFileAtomically(path, text.data(), text.size());
+  SORA_TRACE_COUNTER("bytes written", s_bytesWritten += text.size());
+}
+
+// --import-final: the forwarded exports are imported from the end of their
+// chain, or from the DLL they are forwarded to if it wasn't resolved
+static void ImportFromTargets(Sora::CManifest& m) {
+  std::vector<Sora::ExportSymbol>::iterator i, iend;
+  for (i = m.symbols.begin(), iend = m.symbols.end(); i != iend; ++i) {
+    if (i->target.empty())
+      i->target = i->forward;
+    if (!i->target.empty())
+      i->flags |= Sora::ESF_TARGET;
+  }
+}
+
+static void GenerateLibrary(const Options& opts, Job& job) {
+  Sora::CManifest manifest;
+  {
+    Sora::CPhaseScope phase(Sora::BP_PARSE);
+    if (job.text) {
+      manifest.Hold(job.text);
+      Sora::ParseManifest(job.text->data(), job.text->size(), opts.arch,
+                          manifest, job.input.c_str());
+    } else if (opts.fromDll) {
+      Sora::LoadDllManifest(job.input.c_str(), manifest);
+    } else {
+      Sora::LoadManifest(job.input.c_str(), opts.arch, manifest);
+    }
+    if (opts.filter)
+      opts.filter->Apply(manifest);
+    if (opts.importFinal)
+      ImportFromTargets(manifest);
+  }
+  if (!job.text)
+    job.deps.push_back(job.input);
+  job.deps.insert(job.deps.end(), opts.allowLists.begin(),
+                  opts.allowLists.end());
+  job.deps.insert(job.deps.end(), opts.usedBy.begin(), opts.usedBy.end());
+  job.symbols = manifest.symbols.size();
+  Sora::CountBuild(Sora::BC_EXPORTS, job.symbols);
+
+  // remembered once the libraries are written
+  std::string exports;
+  if (opts.watch) {
+    Sora::CSha256 hash;
+    Sora::HashManifest(manifest, hash);
+    exports = hash.HexDigest();
+    if (exports == job.exports) {
+      job.unchanged = true;
+      return;
+    }
+  }
+
+  if (opts.targets.empty()) {
+    Target t;
+    t.manifest = std::move(manifest);
+    t.output = job.output;
+    WriteLibrary(opts, t);
+    job.libraries = 1;
+    job.cached = t.cached;
+    job.kept = t.kept;
+    job.bytes = t.bytes;
+    job.outputs.push_back(t.output);
+  } else {
+    if (opts.targets.size() > 1 &&
+        job.output.find("{arch}") == std::string::npos) {
+      throw MyMsgException("No {arch} in the output name %s!",
+                           job.output.c_str());
+    }
+
+    // parsed once, decorated and built per target in parallel
+    std::vector<Target> targets(opts.targets.size());
+    {
+      Sora::CTaskGroup group(*opts.pool);
+      for (size_t i = 0; i < targets.size(); ++i) {
+        Target* t = &targets[i];
+        int arch = opts.targets[i];
+        group.Run([&opts, &manifest, &job, t, arch]() {
+          Sora::RetargetManifest(manifest, arch, t->manifest);
+          t->output = OutputFor(job.output, arch);
+          WriteLibrary(opts, *t);
+        });
+      }
+      group.Wait();
+    }
+
+    for (size_t i = 0; i < targets.size(); ++i) {
+      job.libraries += 1;
+      job.cached += targets[i].cached;
+      job.kept += targets[i].kept;
+      job.bytes += targets[i].bytes;
+      job.outputs.push_back(targets[i].output);
+    }
+  }
+  job.exports = exports;
+
+  if (opts.depfile) {
+    Sora::CPhaseScope phase(Sora::BP_WRITE);
+    WriteDepfile(opts, job);
+  }
+}
+
+// never throws, the outcome is recorded in the job
+static void RunJob(const Options& opts, Job& job) {
+  SORA_TRACE_SCOPE_ARG("job", "input", job.input);
+  Clock::time_point start = Clock::now();
+  job.ok = false;
+  job.unchanged = false;
+  job.error.clear();
+  job.libraries = job.cached = job.kept = job.bytes = 0;
+  job.deps.clear();
+  job.outputs.clear();
   try {
-    if (argc == 3) {
-      std::ifstream inputFile(argv[1]);
-      if (!inputFile.is_open()) {
-        throw MyMsgException("Fail to open input file!");
+    GenerateLibrary(opts, job);
+    job.ok = true;
+  } catch (MyMsgException& e) {
+    job.error = e.Text();
+  } catch (std::exception& e) {
+    job.error = e.what();
+  }
+  job.ms = MsSince(start);
+}
+
+// in parallel on the pool
+static void RunJobs(const Options& opts, const std::vector<Job*>& jobs) {
+  Sora::CTaskGroup group(*opts.pool);
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    Job* job = jobs[i];
+    group.Run([&opts, job]() {
+      SORA_TRACE_COUNTER("pool queue", opts.pool->GetQueuedCount());
+      RunJob(opts, *job);
+    });
+    SORA_TRACE_COUNTER("pool queue", opts.pool->GetQueuedCount());
+  }
+  group.Wait();
+}
+
+// splits a response file line or a server request into words,
+// "quoted words" may contain spaces
+static std::vector<std::string> SplitLine(const std::string& line) {
+  std::vector<std::string> r;
+  size_t i = 0, n = line.size();
+  while (i < n) {
+    while (i < n && isspace((unsigned char)line[i]))
+      ++i;
+    if (i == n)
+      break;
+
+    std::string word;
+    if (line[i] == '"') {
+      size_t end = line.find('"', i + 1);
+      if (end == std::string::npos)
+        end = n;
+      word = line.substr(i + 1, end - i - 1);
+      i = end + 1;
+    } else {
+      while (i < n && !isspace((unsigned char)line[i]))
+        word += line[i++];
+    }
+    r.push_back(word);
+  }
+  return r;
+}
+
+static void ReadResponseFile(const char* path, std::vector<Job>& jobs) {
+  std::ifstream f(path);
+  if (!f.is_open()) {
+    throw MyMsgException("Fail to open response file %s!", path);
+  }
+
+  std::string line;
+  while (std::getline(f, line)) {
+    std::vector<std::string> words = SplitLine(line);
+    if (words.empty() || words[0][0] == '#')
+      continue;
+    if (words.size() != 2) {
+      throw MyMsgException("Bad line in response file: %s", line.c_str());
+    }
+
+    Job job;
+    job.input = words[0];
+    job.output = words[1];
+    jobs.push_back(job);
+  }
+}
+
+// args: <input> <output> pairs and @response files
+static void CollectJobs(const std::vector<const char*>& args,
+                        std::vector<Job>& jobs) {
+  const char* pending = 0; // an input waiting for its output
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (args[i][0] == '@') {
+      ReadResponseFile(args[i] + 1, jobs);
+    } else if (pending == 0) {
+      pending = args[i];
+    } else {
+      Job job;
+      job.input = pending;
+      job.output = args[i];
+      jobs.push_back(job);
+      pending = 0;
+    }
+  }
+
+  if (pending != 0) {
+    throw MyMsgException("No output library for %s!", pending);
+  }
+}
+
+static int RunBatch(const Options& opts, const std::vector<const char*>& args) {
+  std::vector<Job> jobs;
+  CollectJobs(args, jobs);
+
+  Clock::time_point start = Clock::now();
+
+  std::vector<Job*> all;
+  for (size_t i = 0; i < jobs.size(); ++i)
+    all.push_back(&jobs[i]);
+  RunJobs(opts, all);
+
+  double wallMs = MsSince(start);
+
+  size_t failed = 0, libraries = 0, cached = 0, kept = 0, symbols = 0,
+         bytes = 0;
+  double jobMs = 0, maxMs = 0;
+  const Job* slowest = 0;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const Job& job = jobs[i];
+    if (!job.ok) {
+      std::cerr << job.error << std::endl;
+      ++failed;
+      continue;
+    }
+
+    libraries += job.libraries;
+    symbols += job.symbols;
+    bytes += job.bytes;
+    cached += job.cached;
+    kept += job.kept;
+    jobMs += job.ms;
+    if (job.ms > maxMs) {
+      maxMs = job.ms;
+      slowest = &job;
+    }
+  }
+
+  printf("%zu libraries (%zu failed, %zu from cache), %zu symbols, %zu bytes\n",
+         libraries, failed, cached, symbols, bytes);
+  if (opts.ifChanged)
+    printf("%zu libraries unchanged, left alone\n", kept);
+  printf("wall %.1f ms on %d threads, sum of jobs %.1f ms, %.1f libraries/s\n",
+         wallMs, opts.pool->GetThreadCount(), jobMs,
+         wallMs > 0 ? libraries * 1000.0 / wallMs : 0.0);
+  if (slowest != 0)
+    printf("slowest %s: %.1f ms\n", slowest->output.c_str(), maxMs);
+
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// the library of a dll in the stream, its path below the output directory
+static std::string StreamOutput(const Options& opts, const std::string& outDir,
+                                const std::string& file) {
+  namespace fs = std::filesystem;
+
+  fs::path rel = fs::path(file).lexically_normal();
+  if (rel.empty() || rel.is_absolute() || *rel.begin() == "..") {
+    throw MyMsgException("Bad path %s in the stream!", file.c_str());
+  }
+  rel.replace_extension();
+  std::string name = rel.filename().string();
+  if (opts.targets.size() > 1)
+    name += "-{arch}";
+  rel.replace_filename(name + ".lib");
+
+  fs::path output = fs::path(outDir) / rel;
+  fs::create_directories(output.parent_path());
+  return output.string();
+}
+
+// the libraries are built while the stream is read: the builders take the
+// manifests from a bounded queue, a full queue stops the reading
+static int RunStream(const Options& opts, const std::string& outDir) {
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+#endif
+  Clock::time_point start = Clock::now();
+  int threads = opts.pool->GetThreadCount();
+  Sora::CBoundedQueue<std::unique_ptr<Job>> queue(2 * threads);
+
+  std::mutex lock;
+  size_t failed = 0, libraries = 0, cached = 0, kept = 0, symbols = 0,
+         bytes = 0;
+  Sora::CTaskGroup group(*opts.pool);
+  for (int i = 0; i < threads; ++i) {
+    group.Run([&]() {
+      std::unique_ptr<Job> job;
+      while (queue.Pop(job)) {
+        SORA_TRACE_COUNTER("stream queue", (long long)queue.Size());
+        RunJob(opts, *job);
+
+        std::lock_guard<std::mutex> l(lock);
+        if (!job->ok) {
+          std::cerr << job->input << ": " << job->error << std::endl;
+          ++failed;
+          continue;
+        }
+        libraries += job->libraries;
+        cached += job->cached;
+        kept += job->kept;
+        symbols += job->symbols;
+        bytes += job->bytes;
       }
+    });
+  }
 
-      json j;
-      inputFile >> j;
+  CStreamInput input(stdin);
+  std::string error;
+  try {
+    std::string file;
+    std::vector<char> text;
+    while (input.Next(file, text)) {
+      std::unique_ptr<Job> job(new Job);
+      job->input = file;
+      job->output = StreamOutput(opts, outDir, file);
+      job->text = std::make_shared<std::vector<char>>(std::move(text));
+      text.clear();
+      queue.Push(std::move(job));
+      SORA_TRACE_COUNTER("stream queue", (long long)queue.Size());
+    }
+  } catch (MyMsgException& e) {
+    error = e.Text();
+  } catch (std::exception& e) {
+    error = e.what();
+  }
+  queue.Close();
+  group.Wait();
+
+  double wallMs = MsSince(start);
+  if (!error.empty())
+    std::cerr << error << std::endl;
+  printf("%zu manifests read, %zu libraries (%zu failed, %zu from cache), "
+         "%zu symbols, %zu bytes\n",
+         input.GetRecordCount(), libraries, failed, cached, symbols, bytes);
+  if (opts.ifChanged)
+    printf("%zu libraries unchanged, left alone\n", kept);
+  printf("wall %.1f ms on %d threads, %.1f libraries/s\n", wallMs, threads,
+         wallMs > 0 ? libraries * 1000.0 / wallMs : 0.0);
+
+  return failed == 0 && error.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// 32,64 or x86,x64
+static void ParseTargets(const char* list, std::vector<int>& targets) {
+  targets.clear();
+  std::string s = list;
+  size_t begin = 0;
+  while (begin <= s.size()) {
+    size_t end = s.find(',', begin);
+    if (end == std::string::npos)
+      end = s.size();
+    std::string name = s.substr(begin, end - begin);
+
+    int arch = atoi(name.c_str());
+    if (arch == 0) {
+      for (int a = 32; a <= 64; a += 32) {
+        if (name == Sora::ArchitectureName(a))
+          arch = a;
+      }
+    }
+    if (Sora::ArchitectureName(arch) == 0) {
+      throw MyMsgException("Bad target %s, use 32, 64, x86 or x64!",
+                           name.c_str());
+    }
+    if (std::find(targets.begin(), targets.end(), arch) == targets.end())
+      targets.push_back(arch);
+    begin = end + 1;
+  }
+}
+
+// the options of one library, for the command line and server requests
+// return: false if argv[i] is none of them, i is past the option otherwise
+static bool ParseJobOption(int argc, const char* const* argv, int& i,
+                           Options& opts) {
+  if (strcmp(argv[i], "--from-dll") == 0) {
+    opts.fromDll = true;
+  } else if (strcmp(argv[i], "--targets") == 0 && i + 1 < argc) {
+    ParseTargets(argv[++i], opts.targets);
+  } else if (strcmp(argv[i], "--arch") == 0 && i + 1 < argc) {
+    opts.arch = atoi(argv[++i]);
+    if (opts.arch != 32 && opts.arch != 64) {
+      throw MyMsgException("Bad architecture %s, use 32 or 64!", argv[i]);
+    }
+  } else if (strcmp(argv[i], "-MD") == 0) {
+    opts.depfile = true;
+  } else if (strcmp(argv[i], "-MF") == 0 && i + 1 < argc) {
+    opts.depfile = true;
+    opts.depfilePath = argv[++i];
+  } else if (strcmp(argv[i], "--if-changed") == 0) {
+    opts.ifChanged = true;
+  } else if (strcmp(argv[i], "--include") == 0 && i + 1 < argc) {
+    opts.rules.push_back(std::make_pair(Sora::SR_INCLUDE, argv[++i]));
+  } else if (strcmp(argv[i], "--exclude") == 0 && i + 1 < argc) {
+    opts.rules.push_back(std::make_pair(Sora::SR_EXCLUDE, argv[++i]));
+  } else if (strcmp(argv[i], "--no-stub") == 0 && i + 1 < argc) {
+    opts.rules.push_back(std::make_pair(Sora::SR_NOSTUB, argv[++i]));
+  } else if (strcmp(argv[i], "--allow-list") == 0 && i + 1 < argc) {
+    opts.allowLists.push_back(argv[++i]);
+  } else if (strcmp(argv[i], "--used-by") == 0 && i + 1 < argc) {
+    opts.usedBy.push_back(argv[++i]);
+  } else if (strcmp(argv[i], "--import-final") == 0) {
+    opts.importFinal = true;
+  } else if (strcmp(argv[i], "--shard-size") == 0 && i + 1 < argc) {
+    opts.shardSize = atoi(argv[++i]);
+    if (opts.shardSize < 0) {
+      throw MyMsgException("Bad shard size %s!", argv[i]);
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// the filter of the rules and allow lists, shared by the jobs. the patterns
+// are compiled and the allow lists read once
+static void SetupFilter(Options& opts) {
+  if (opts.rules.empty() && opts.allowLists.empty()) {
+    opts.filter.reset();
+    return;
+  }
+
+  std::shared_ptr<Sora::CSymbolFilter> filter(new Sora::CSymbolFilter);
+  for (size_t i = 0; i < opts.rules.size(); ++i)
+    filter->Add(opts.rules[i].first, opts.rules[i].second);
+  for (size_t i = 0; i < opts.allowLists.size(); ++i)
+    filter->LoadAllowList(opts.allowLists[i].c_str());
+  opts.filter = filter;
+}
+
+// the undefined symbols of the --used-by objects and archives. @lists are
+// expanded, their entries taken relative to base
+static void SetupReferences(Options& opts, const std::filesystem::path& base) {
+  if (opts.usedBy.empty()) {
+    opts.references.reset();
+    return;
+  }
+
+  opts.usedByArgs = opts.usedBy;
+  std::vector<std::string> files;
+  for (size_t i = 0; i < opts.usedBy.size(); ++i) {
+    const std::string& arg = opts.usedBy[i];
+    if (arg[0] != '@') {
+      files.push_back(arg);
+      continue;
+    }
+
+    std::ifstream f(arg.substr(1));
+    if (!f.is_open()) {
+      throw MyMsgException("Fail to open file list %s!", arg.c_str() + 1);
+    }
+    std::string line;
+    while (std::getline(f, line)) {
+      std::vector<std::string> words = SplitLine(line);
+      if (words.empty() || words[0][0] == '#')
+        continue;
+      for (size_t w = 0; w < words.size(); ++w)
+        files.push_back((base / words[w]).string());
+    }
+  }
+  opts.usedBy = files;
+
+  std::shared_ptr<Sora::CSymbolReferences> refs(new Sora::CSymbolReferences);
+  refs->ScanFiles(files, opts.pool);
+  opts.references = refs;
+}
+
+// the allow lists, the --used-by objects and their @lists, the inputs of
+// every job
+static void WatchSharedInputs(const Options& opts, CFileWatcher& watcher) {
+  for (size_t i = 0; i < opts.allowLists.size(); ++i)
+    watcher.Add(opts.allowLists[i]);
+  for (size_t i = 0; i < opts.usedBy.size(); ++i)
+    watcher.Add(opts.usedBy[i]);
+  for (size_t i = 0; i < opts.usedByArgs.size(); ++i) {
+    if (opts.usedByArgs[i][0] == '@')
+      watcher.Add(opts.usedByArgs[i].substr(1));
+  }
+}
+
+static bool Contains(const std::vector<std::string>& changed,
+                     const std::string& path) {
+  return std::find(changed.begin(), changed.end(), path) != changed.end();
+}
+
+// reads the changed allow lists and scans the changed --used-by files again
+// return: true if every job is affected
+static bool ReloadSharedInputs(Options& opts,
+                               const std::vector<std::string>& changed,
+                               std::vector<Job>& jobs) {
+  bool filter = false, references = false;
+  for (size_t i = 0; i < opts.allowLists.size(); ++i)
+    filter = filter || Contains(changed, opts.allowLists[i]);
+  for (size_t i = 0; i < opts.usedBy.size(); ++i)
+    references = references || Contains(changed, opts.usedBy[i]);
+  for (size_t i = 0; i < opts.usedByArgs.size(); ++i) {
+    references = references || (opts.usedByArgs[i][0] == '@' &&
+                                Contains(changed, opts.usedByArgs[i].substr(1)));
+  }
+
+  // on a failure the old filter and references stay
+  Options next = opts;
+  if (filter)
+    SetupFilter(next);
+  if (references) {
+    next.usedBy = next.usedByArgs;
+    SetupReferences(next, "");
+  }
+  opts = next;
+
+  // the references prune after the export set is hashed, so it can't tell
+  if (references) {
+    for (size_t i = 0; i < jobs.size(); ++i)
+      jobs[i].exports.clear();
+  }
+  return filter || references;
+}
+
+// stays resident: the pool, the cache and the hashes of the export sets are
+// kept between regenerations, only the jobs of changed inputs run again.
+// a changed allow list or --used-by file affects all of them
+static int RunWatch(Options opts, const std::vector<const char*>& args) {
+  std::vector<Job> jobs;
+  CollectJobs(args, jobs);
+
+  CFileWatcher watcher;
+  std::vector<Job*> all;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    watcher.Add(jobs[i].input);
+    all.push_back(&jobs[i]);
+  }
+  WatchSharedInputs(opts, watcher);
+
+  Clock::time_point start = Clock::now();
+  RunJobs(opts, all);
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (!jobs[i].ok)
+      std::cerr << jobs[i].error << std::endl;
+  }
+  printf("%zu inputs generated in %.1f ms, watching for changes\n",
+         jobs.size(), MsSince(start));
+  fflush(stdout);
+
+  for (;;) {
+    std::vector<std::string> changed = watcher.Wait();
+    start = Clock::now();
 
-      std::string dllName = j["dllname"];
-      int arch = j["arch"];
-      auto symbols = j["symbols"];
+    bool shared;
+    try {
+      shared = ReloadSharedInputs(opts, changed, jobs);
+    } catch (MyMsgException& e) {
+      std::cerr << e.Text() << std::endl;
+      continue;
+    } catch (std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      continue;
+    }
+    if (shared)
+      WatchSharedInputs(opts, watcher); // new entries of the @lists
+
+    std::vector<Job*> affected;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      if (shared || Contains(changed, jobs[i].input))
+        affected.push_back(&jobs[i]);
+    }
+    RunJobs(opts, affected);
 
-      Sora::IImportLibraryBuilder* impBuilder;
-      if (arch == 64) {
-        impBuilder = Sora::CreateX64ImpLibBuilder(dllName.c_str(), dllName.c_str());
+    size_t regenerated = 0;
+    for (size_t i = 0; i < affected.size(); ++i) {
+      const Job& job = *affected[i];
+      if (!job.ok) {
+        std::cerr << job.error << std::endl;
+      } else if (job.unchanged) {
+        printf("  %s: exports unchanged\n", job.input.c_str());
       } else {
-        impBuilder = Sora::CreateX86ImpLibBuilder(dllName.c_str(), dllName.c_str());
+        printf("  %s: %zu symbols, %.1f ms\n", job.output.c_str(),
+               job.symbols, job.ms);
+        regenerated += job.libraries;
       }
+    }
+    printf("%zu libraries regenerated in %.1f ms\n", regenerated,
+           MsSince(start));
+    fflush(stdout);
+
+    if (opts.cache != 0)
+      opts.cache->Evict();
+  }
+}
 
-      for (const auto& symbol : symbols) {
-        std::string cconv = symbol["cconv"];
-        std::string name = symbol["name"];
-        int ord = symbol["ord"];
-        std::string thunk = symbol["thunk"];
-        std::string pubname = symbol["pubname"];
+// parses a request line, reads the inline export list if there is one
+static void ReadRequest(CLocalSocket& client, const std::string& line,
+                        Options& opts, Job& job) {
+  namespace fs = std::filesystem;
 
-        if (!name.empty()) {
-          impBuilder->AddImportFunctionByName(pubname.c_str(), thunk.c_str(), name.c_str());
+  std::vector<std::string> words = SplitLine(line);
+  if (words.empty() || !fs::path(words[0]).is_absolute()) {
+    throw MyMsgException("Bad request, no working directory: %s",
+                         line.c_str());
+  }
+
+  std::vector<const char*> argv;
+  for (size_t i = 0; i < words.size(); ++i)
+    argv.push_back(words[i].c_str());
+
+  std::vector<std::string> paths;
+  size_t rules = opts.rules.size(), allowLists = opts.allowLists.size();
+  size_t usedBy = opts.usedBy.size();
+  long long inlineSize = -1;
+  for (int i = 1; i < (int)argv.size(); ++i) {
+    if (strcmp(argv[i], "--inline") == 0 && i + 1 < (int)argv.size()) {
+      const char* size = argv[++i];
+      char* end;
+      errno = 0;
+      unsigned long long n = strtoull(size, &end, 10);
+      if (!isdigit((unsigned char)size[0]) || *end != 0 || errno == ERANGE ||
+          n > MaxManifestSize) {
+        throw MyMsgException("Bad inline size %s!", size);
+      }
+      inlineSize = (long long)n;
+    } else if (argv[i][0] == '-' && argv[i][1] != 0) {
+      if (!ParseJobOption((int)argv.size(), argv.data(), i, opts)) {
+        throw MyMsgException("Option %s is not supported by the server!",
+                             argv[i]);
+      }
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    throw MyMsgException("Bad request, expected <input> <output lib>: %s",
+                         line.c_str());
+  }
+
+  fs::path cwd = words[0];
+  job.input = inlineSize >= 0 ? paths[0] : (cwd / paths[0]).string();
+  job.output = (cwd / paths[1]).string();
+  if (!opts.depfilePath.empty())
+    opts.depfilePath = (cwd / opts.depfilePath).string();
+  for (size_t i = allowLists; i < opts.allowLists.size(); ++i)
+    opts.allowLists[i] = (cwd / opts.allowLists[i]).string();
+  for (size_t i = usedBy; i < opts.usedBy.size(); ++i) {
+    std::string& arg = opts.usedBy[i];
+    if (arg[0] == '@')
+      arg = "@" + (cwd / arg.substr(1)).string();
+    else
+      arg = (cwd / arg).string();
+  }
+  try {
+    if (opts.rules.size() != rules || opts.allowLists.size() != allowLists)
+      SetupFilter(opts);
+    if (opts.usedBy.size() != usedBy)
+      SetupReferences(opts, cwd);
+  } catch (std::exception& e) {
+    throw MyMsgException("%s", e.what());
+  }
+  if (inlineSize >= 0) {
+    job.text = std::make_shared<std::vector<char>>((size_t)inlineSize);
+    if (!client.Read(job.text->data(), job.text->size())) {
+      throw MyMsgException("Connection closed in the export list of %s",
+                           job.input.c_str());
+    }
+  }
+}
+
+// the requests of one connection, in order
+static void ServeClient(const Options& server, CLocalSocket client) {
+  std::string line;
+  while (client.ReadLine(line)) {
+    Options opts = server;
+    Job job;
+    std::string error;
+    try {
+      ReadRequest(client, line, opts, job);
+    } catch (MyMsgException& e) {
+      error = e.Text();
+    } catch (std::exception& e) {
+      // out of memory for the export list...: this client only
+      error = std::string("Bad request: ") + e.what();
+    }
+
+    // the stream can't be trusted after a bad request
+    if (!error.empty()) {
+      std::replace(error.begin(), error.end(), '\n', ' ');
+      client.Write("error " + error + "\n");
+      return;
+    }
+
+    Sora::CTaskGroup group(*opts.pool);
+    group.Run([&opts, &job]() { RunJob(opts, job); });
+    group.Wait();
+
+    std::string reply;
+    if (job.ok) {
+      char buf[128];
+      snprintf(buf, sizeof(buf), "ok %zu %zu %zu %zu %.3f\n", job.libraries,
+               job.cached, job.symbols, job.bytes, job.ms);
+      reply = buf;
+    } else {
+      std::replace(job.error.begin(), job.error.end(), '\n', ' ');
+      reply = "error " + job.error + "\n";
+    }
+    if (!client.Write(reply))
+      return;
+  }
+}
+
+// a thread per connection waits for its requests, the pool does the work
+static int RunServer(const Options& opts, const char* path) {
+  CLocalSocket server;
+  if (!server.Listen(path)) {
+    throw MyMsgException("Fail to listen on %s!", path);
+  }
+  printf("listening on %s, %d threads\n", path, opts.pool->GetThreadCount());
+  fflush(stdout);
+
+  for (;;) {
+    CLocalSocket client = server.Accept();
+    if (!client.IsOpen()) {
+      // out of descriptors: let the connections finish
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    std::thread(ServeClient, std::cref(opts), std::move(client)).detach();
+  }
+}
+
+static void Usage() {
+  std::cout << "Make import library from JSON, .def or DLL\n"
+            << "using: MakeImpLib [options] <input> <output lib>\n"
+            << "       MakeImpLib --from-dll <dll> <output lib>\n"
+            << "       MakeImpLib --batch [options] [-j <threads>] <input> <output lib> ...\n"
+            << "       MakeImpLib --batch [options] [-j <threads>] @<response file> ...\n"
+            << "       MakeImpLib --watch [options] [-j <threads>] <input> <output lib> ...\n"
+            << "       MakeImpLib --serve <socket> [-j <threads>] [--cache <dir>]\n"
+            << "       dumpsyms <dir> /STREAM | MakeImpLib --stream <output dir> [options]\n"
+            << "options:\n"
+            << "  --arch 32|64  architecture of .def inputs (default 32)\n"
+            << "  --from-dll    read the inputs as PE images\n"
+            << "  --targets 32,64  one library per architecture, {arch} in the\n"
+            << "                   output name is replaced by x86 or x64\n"
+            << "  --shard-size <exports>  build big libraries in parallel shards\n"
+            << "                          of this size (default 4096, 0: off)\n"
+            << "  --stats[=json]   phase timings, allocations, counters and peak RSS\n"
+            << "  --trace <file>   Chrome trace-event timeline (IMPLIBGEN_TRACE builds)\n"
+            << "  --cache <dir> reuse the libraries of identical export sets\n"
+            << "  --cache-size <bytes>     cache size limit (default 1G, 0: none)\n"
+            << "  --cache-policy lru|fifo  cache eviction order (default lru)\n"
+            << "  -MD           write a depfile <output>.d for Make and Ninja\n"
+            << "  -MF <file>    the depfile of a single library\n"
+            << "  --if-changed  keep identical libraries and their time\n"
+            << "  --include <pattern>  only the matching exports\n"
+            << "  --exclude <pattern>  leave the matching exports out\n"
+            << "  --no-stub <pattern>  no call stub for the matching exports\n"
+            << "  --allow-list <file>  only the exports named in the file\n"
+            << "  --used-by <object|archive|@list>  only the imports they use\n"
+            << "                       patterns: globs (* ?) or re:<regex>\n"
+            << "  --import-final  import forwarded exports from their final DLL\n";
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    Options opts;
+    bool batch = false;
+    const char* cacheDir = getenv("MKIMPLIB_CACHE");
+    uint64_t cacheSize = (uint64_t)1 << 30;
+    CacheEvictionPolicy cachePolicy = CEP_LRU;
+    std::vector<const char*> args;
+    int stats = 0; // 1: table, 2: JSON
+    const char* serve = 0;
+    const char* stream = 0;
+    const char* trace = 0;
+
+    for (int i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], "--stats") == 0) {
+        stats = 1;
+      } else if (strcmp(argv[i], "--stats=json") == 0) {
+        stats = 2;
+      } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+        trace = argv[++i];
+      } else if (strcmp(argv[i], "--batch") == 0) {
+        batch = true;
+      } else if (strcmp(argv[i], "--watch") == 0) {
+        opts.watch = true;
+      } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+        serve = argv[++i];
+      } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+        stream = argv[++i];
+      } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+        cacheDir = argv[++i];
+      } else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+        if (!ParseByteSize(argv[++i], &cacheSize)) {
+          throw MyMsgException("Bad cache size %s!", argv[i]);
+        }
+      } else if (strcmp(argv[i], "--cache-policy") == 0 && i + 1 < argc) {
+        ++i;
+        if (strcmp(argv[i], "lru") == 0) {
+          cachePolicy = CEP_LRU;
+        } else if (strcmp(argv[i], "fifo") == 0) {
+          cachePolicy = CEP_FIFO;
         } else {
-          impBuilder->AddImportFunctionByOrdinal(pubname.c_str(), thunk.c_str(), ord);
+          throw MyMsgException("Bad cache policy %s, use lru or fifo!", argv[i]);
         }
+      } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+        opts.threads = atoi(argv[++i]);
+      } else if (!ParseJobOption(argc, argv, i, opts)) {
+        args.push_back(argv[i]);
       }
+    }
 
-      // Save file
-      impBuilder->Build();
+    if (!opts.depfilePath.empty() &&
+        (batch || opts.watch || serve != 0 || stream != 0)) {
+      throw MyMsgException("-MF is for a single library, use -MD!");
+    }
 
-      int nFileSize = impBuilder->GetDataLength();
-      std::vector<char> buffer(nFileSize);
-      impBuilder->GetRawData(reinterpret_cast<PBYTE>(buffer.data()));
+#ifdef IMPLIBGEN_TRACE
+    if (trace != 0)
+      Sora::StartTrace();
+#else
+    if (trace != 0) {
+      throw MyMsgException("No --trace %s, mkimplib is built without "
+                           "IMPLIBGEN_TRACE!", trace);
+    }
+#endif
 
-      std::ofstream outputFile(argv[2], std::ios::binary);
-      if (!outputFile.is_open()) {
-        throw MyMsgException("Fail to create library File!");
-      }
+    SetupFilter(opts);
 
-      outputFile.write(buffer.data(), nFileSize);
-      if (!outputFile) {
-        throw MyMsgException("Failed to write to output file!");
-      }
+    std::unique_ptr<COutputCache> cache;
+    if (cacheDir != 0 && *cacheDir != 0) {
+      cache.reset(new COutputCache(cacheDir, cacheSize, cachePolicy));
+      opts.cache = cache.get();
+    }
+
+    std::unique_ptr<Sora::CWorkPool> pool;
+    if (batch || opts.watch || serve != 0 || stream != 0 ||
+        !opts.targets.empty() || !opts.usedBy.empty()) {
+      pool.reset(new Sora::CWorkPool(opts.threads));
+      opts.pool = pool.get();
+    }
+    SetupReferences(opts, "");
+
+    CBuildStats buildStats;
+    if (stats != 0) {
+      Sora::SetBuildListener(&buildStats);
+      Sora::EnableAllocCounting(true);
+    }
+    Clock::time_point start = Clock::now();
 
-      impBuilder->Dispose();
+    int result = EXIT_SUCCESS;
+    if (serve != 0) {
+      result = RunServer(opts, serve);
+    } else if (stream != 0) {
+      result = RunStream(opts, stream);
+    } else if (opts.watch) {
+      result = RunWatch(opts, args);
+    } else if (batch) {
+      result = RunBatch(opts, args);
+    } else if (args.size() == 2) {
+      Job job;
+      job.input = args[0];
+      job.output = args[1];
+      GenerateLibrary(opts, job);
     } else {
-      std::cout << "Make import library from JSON\n"
-                << "using: MakeImpLib <input json> <output lib>\n";
+      Usage();
     }
+
+    if (cache)
+      cache->Evict();
+
+#ifdef IMPLIBGEN_TRACE
+    if (trace != 0 && !Sora::WriteTrace(trace)) {
+      throw MyMsgException("Fail to write trace %s!", trace);
+    }
+#endif
+
+    if (stats != 0) {
+      Sora::SetBuildListener(0);
+      if (stats == 2)
+        buildStats.PrintJson(stdout, MsSince(start));
+      else
+        buildStats.PrintTable(stdout, MsSince(start));
+      Sora::EnableAllocCounting(false);
+    }
+    return result;
   } catch (MyMsgException& e) {
-    std::cerr << e.fmt << e.msg << std::endl;
+    std::cerr << e.Text() << std::endl;
+    exit(EXIT_FAILURE);
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
     exit(EXIT_FAILURE);
   }
 }
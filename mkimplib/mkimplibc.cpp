@@ -0,0 +1,108 @@
+/**
+ * The client of mkimplib --serve: takes the arguments of a single mkimplib
+ * run and has the server generate the library, so a build system can call
+ * it instead of mkimplib without loading the generator for every DLL.
+ *
+ * Usage:
+ *   mkimplibc [--server <socket>] [options] <input> <output lib>
+ *
+ * The socket is MKIMPLIB_SERVER if --server is not given. The options are
+ * those of a single mkimplib run: --arch, --from-dll, --targets,
+ * --shard-size, -MD, -MF, --if-changed, the symbol filters, --used-by and
+ * --import-final.
+ * An input of - sends the export list read from stdin, in any input format.
+ * Relative paths are resolved by the server from the current directory.
+ * Nothing is printed on success, the server's message on failure.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "LocalSocket.h"
+
+// quoted if it contains spaces, the server splits on them
+static bool AppendWord(std::string& line, const std::string& word) {
+  if (word.find('"') != std::string::npos ||
+      word.find('\n') != std::string::npos)
+    return false;
+  line += ' ';
+  if (word.empty() || word.find_first_of(" \t") != std::string::npos)
+    line += '"' + word + '"';
+  else
+    line += word;
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  const char* path = getenv("MKIMPLIB_SERVER");
+  std::vector<std::string> args;
+  bool fromStdin = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else {
+      fromStdin = fromStdin || strcmp(argv[i], "-") == 0;
+      args.push_back(argv[i]);
+    }
+  }
+
+  if (args.empty()) {
+    std::cout << "Make import library with a running mkimplib --serve\n"
+              << "using: mkimplibc [--server <socket>] [options] <input> <output lib>\n"
+              << "the socket is MKIMPLIB_SERVER if --server is not given,\n"
+              << "an input of - reads the export list from stdin\n";
+    return EXIT_SUCCESS;
+  }
+  if (path == 0 || *path == 0) {
+    std::cerr << "No server, use --server or MKIMPLIB_SERVER!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string text;
+  if (fromStdin) {
+    std::cin >> std::noskipws;
+    text.assign(std::istreambuf_iterator<char>(std::cin),
+                std::istreambuf_iterator<char>());
+  }
+
+  std::error_code ec;
+  std::string line;
+  bool ok = AppendWord(line, std::filesystem::current_path(ec).string());
+  if (fromStdin)
+    ok = ok && AppendWord(line, "--inline") &&
+         AppendWord(line, std::to_string(text.size()));
+  for (size_t i = 0; i < args.size(); ++i)
+    ok = ok && AppendWord(line, args[i]);
+  if (!ok) {
+    std::cerr << "Quotes and line breaks are not allowed in arguments!"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  line.erase(0, 1);
+  line += '\n';
+
+  CLocalSocket server;
+  std::string reply;
+  if (!server.Connect(path)) {
+    std::cerr << "Fail to connect to mkimplib server " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!server.Write(line) || !server.Write(text) || !server.ReadLine(reply)) {
+    std::cerr << "Connection to mkimplib server " << path << " lost"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (reply.compare(0, 3, "ok ") == 0)
+    return EXIT_SUCCESS;
+  if (reply.compare(0, 6, "error ") == 0)
+    reply.erase(0, 6);
+  std::cerr << reply << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,338 @@
+// the helpers of mkimplib linked in, the depfiles and --if-changed through
+// the mkimplib given as the first argument
+#include "BinaryManifest.h"
+#include "OutputCache.h"
+#include "StreamInput.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+static std::string s_mkimplib;
+
+// runs mkimplib in the current directory, its output in mkimplib.log
+static bool Run(const std::string& args) {
+  std::string command =
+      "\"" + s_mkimplib + "\" " + args + " > mkimplib.log 2>&1";
+  if (system(command.c_str()) == 0)
+    return true;
+  std::ifstream log("mkimplib.log");
+  std::stringstream text;
+  text << log.rdbuf();
+  printf("mkimplib %s failed:\n%s", args.c_str(), text.str().c_str());
+  return false;
+}
+
+static std::string ReadText(const fs::path& path) {
+  std::ifstream f(path, std::ios::binary);
+  std::stringstream text;
+  text << f.rdbuf();
+  return text.str();
+}
+
+static void WriteText(const fs::path& path, const std::string& text) {
+  std::ofstream f(path, std::ios::binary);
+  f << text;
+}
+
+static void Put16(std::vector<char>& b, size_t at, unsigned short v) {
+  memcpy(&b[at], &v, sizeof(v));
+}
+
+static void Put32(std::vector<char>& b, size_t at, unsigned int v) {
+  memcpy(&b[at], &v, sizeof(v));
+}
+
+// an x86 object with one undefined external, the name in the string table
+static void WriteObject(const fs::path& path, const std::string& name) {
+  std::vector<char> b(20 + 18 + 4);
+  Put16(b, 0, 0x14C);
+  Put32(b, 8, 20);
+  Put32(b, 12, 1);
+  Put32(b, 20 + 4, 4);
+  b[20 + 16] = 2; // IMAGE_SYM_CLASS_EXTERNAL
+  Put32(b, 20 + 18, (unsigned int)(4 + name.size() + 1));
+  b.insert(b.end(), name.c_str(), name.c_str() + name.size() + 1);
+
+  std::ofstream f(path, std::ios::binary);
+  f.write(b.data(), b.size());
+}
+
+// a binary stream frame, the manifest isn't parsed by CStreamInput
+static std::string Frame(const std::string& file, const std::string& manifest) {
+  Sora::BinaryStreamFrame h;
+  memcpy(h.magic, Sora::BinaryStreamMagic, 4);
+  h.fileSize = (uint32_t)file.size();
+  h.manifestSize = (uint32_t)manifest.size();
+  std::string r((const char*)&h, sizeof(h));
+  r += file + std::string(Sora::BinaryStreamPadding(h.fileSize), '\0');
+  r += manifest;
+  r += std::string(Sora::BinaryStreamPadding(h.manifestSize), '\0');
+  return r;
+}
+
+// the records of a stream, "<file>=<text>" each, or the error
+static std::vector<std::string> ReadStream(const std::string& data,
+                                           std::string& error) {
+  error.clear();
+  FILE* f = tmpfile();
+  fwrite(data.data(), 1, data.size(), f);
+  rewind(f);
+
+  std::vector<std::string> records;
+  CStreamInput input(f);
+  std::string file;
+  std::vector<char> text;
+  try {
+    while (input.Next(file, text))
+      records.push_back(file + "=" + std::string(text.begin(), text.end()));
+  } catch (std::runtime_error& e) {
+    error = e.what();
+  }
+  fclose(f);
+  return records;
+}
+
+static const char defText[] = "LIBRARY k.dll\n"
+                              "EXPORTS\n"
+                              "Alpha\n"
+                              "Beta\n";
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: test_mkimplib <mkimplib>\n");
+    return 1;
+  }
+  s_mkimplib = fs::absolute(argv[1]).string();
+
+  fs::path dir = fs::temp_directory_path() / "test_mkimplib";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  fs::current_path(dir);
+
+  // a size mismatch, a different byte, the same bytes, no file
+  {
+    WriteText("same.bin", "abcdef");
+    Check(FileHasContent("same.bin", "abcdef", 6), "same content");
+    Check(!FileHasContent("same.bin", "abcdeg", 6), "different byte");
+    Check(!FileHasContent("same.bin", "abcde", 5), "different size");
+    Check(!FileHasContent("missing.bin", "", 0), "missing file");
+
+    std::string big(200 * 1024, 'x');
+    WriteText("big.bin", big);
+    Check(FileHasContent("big.bin", big.data(), big.size()), "big file");
+    big[150 * 1024] = 'y';
+    Check(!FileHasContent("big.bin", big.data(), big.size()),
+          "big file, a later chunk differs");
+  }
+
+  // JSON lines: blank ones skipped, CRs dropped, the last one without a
+  // newline
+  {
+    std::string error;
+    std::vector<std::string> r =
+        ReadStream("\n{\"file\": \"a.dll\"}\r\n\r\n  \n"
+                   "{\"file\": \"b.dll\", \"arch\": 64}",
+                   error);
+    Check(error.empty() && r.size() == 2 &&
+              r[0] == "a.dll={\"file\": \"a.dll\"}" &&
+              r[1] == "b.dll={\"file\": \"b.dll\", \"arch\": 64}",
+          "json lines");
+
+    r = ReadStream("{\"file\": \"a.dll\"}\n{\"arch\": 64}\n", error);
+    Check(r.size() == 1 &&
+              error == "Bad record 2 in the stream, no \"file\" first",
+          "json line without file");
+  }
+
+  // binary frames, padded; cut short, a bad magic, sizes too big to be
+  // allocated
+  {
+    std::string frames =
+        Frame("a.dll", "SBMF1") + Frame("sub/bc.dll", "SBMF");
+    std::string error;
+    std::vector<std::string> r = ReadStream(frames, error);
+    Check(error.empty() && r.size() == 2 && r[0] == "a.dll=SBMF1" &&
+              r[1] == "sub/bc.dll=SBMF",
+          "binary frames");
+
+    r = ReadStream(frames.substr(0, frames.size() - 6), error);
+    Check(r.size() == 1 && error == "Bad record 2 in the stream, cut short",
+          "truncated frame");
+    r = ReadStream(frames.substr(0, 7), error);
+    Check(r.empty() && error == "Bad record 1 in the stream",
+          "truncated frame header");
+
+    std::string bad = frames;
+    bad[3] = 'X';
+    r = ReadStream(bad, error);
+    Check(r.empty() && error == "Bad record 1 in the stream", "bad magic");
+
+    Sora::BinaryStreamFrame h;
+    memcpy(h.magic, Sora::BinaryStreamMagic, 4);
+    h.fileSize = 5;
+    h.manifestSize = 0xFFFFFFF0;
+    r = ReadStream(std::string((const char*)&h, sizeof(h)) + "a.dll", error);
+    Check(r.empty() && error == "Bad record 1 in the stream, too big",
+          "huge manifest size");
+    h.fileSize = 0x80000000;
+    h.manifestSize = 4;
+    r = ReadStream(std::string((const char*)&h, sizeof(h)), error);
+    Check(r.empty() && error == "Bad record 1 in the stream, too big",
+          "huge path size");
+  }
+
+  // sizes: suffixes, no sign, nothing over 64 bits
+  {
+    uint64_t n = 0;
+    Check(ParseByteSize("100", &n) && n == 100, "size");
+    Check(ParseByteSize("64K", &n) && n == 64 << 10, "size in K");
+    Check(ParseByteSize("2g", &n) && n == (uint64_t)2 << 30, "size in G");
+    Check(ParseByteSize("17179869183G", &n) && n == UINT64_MAX >> 30 << 30,
+          "largest size in G");
+    Check(!ParseByteSize("17179869184G", &n) &&
+              !ParseByteSize("99999999999G", &n) &&
+              !ParseByteSize("99999999999999999999", &n),
+          "size over 64 bits");
+    Check(!ParseByteSize("-1", &n) && !ParseByteSize("+1", &n) &&
+              !ParseByteSize(" 1", &n) && !ParseByteSize("", &n) &&
+              !ParseByteSize("1T", &n) && !ParseByteSize("1KB", &n),
+          "not a size");
+  }
+
+  // the cache: keys, copies out, matches, and which entries go first
+  {
+    char text[] = "LIBRARY k.dll\nEXPORTS\nAlpha\n";
+    char other[] = "LIBRARY k.dll\nEXPORTS\nBeta\n";
+    Sora::CManifest a, a2, b;
+    std::vector<char> copy(text, text + sizeof(text));
+    Sora::ParseDefManifest(text, sizeof(text) - 1, 32, a, "a.def");
+    Sora::ParseDefManifest(copy.data(), copy.size() - 1, 32, a2, "a.def");
+    Sora::ParseDefManifest(other, sizeof(other) - 1, 32, b, "b.def");
+    std::string key = COutputCache::Key(a, "");
+    Check(key.size() == 64 && key == COutputCache::Key(a2, "") &&
+              key != COutputCache::Key(b, "") &&
+              key != COutputCache::Key(a, "--no-stub"),
+          "cache keys");
+
+    fs::path cacheDir = dir / "cache";
+    COutputCache cache(cacheDir.string(), 250, CEP_LRU);
+    std::string lib(100, 'a');
+    Check(!cache.Fetch(key, "a.lib"), "cache miss");
+    cache.Store(key, lib.data(), lib.size());
+    Check(cache.Fetch(key, "a.lib") && ReadText("a.lib") == lib, "cache hit");
+    Check(!fs::equivalent("a.lib", cacheDir / key.substr(0, 2) /
+                                       (key + ".lib")),
+          "cache hit copied");
+    Check(cache.Matches(key, "a.lib"), "output matches");
+    WriteText("a.lib", std::string(100, 'b'));
+    Check(!cache.Matches(key, "a.lib"), "output differs");
+
+    // three entries of 100 bytes, 250 kept: the first one stored is used
+    // last, LRU evicts the second, FIFO the first
+    const char* keys[] = {"aa01", "bb02", "cc03"};
+    for (int policy = CEP_LRU; policy <= CEP_FIFO; ++policy) {
+      fs::remove_all(cacheDir);
+      COutputCache c(cacheDir.string(), 250, (CacheEvictionPolicy)policy);
+      fs::file_time_type now = fs::file_time_type::clock::now();
+      for (int i = 0; i < 2; ++i) {
+        c.Store(keys[i], lib.data(), lib.size());
+        fs::path entry = cacheDir / std::string(keys[i], 2) /
+                         (std::string(keys[i]) + ".lib");
+        fs::last_write_time(entry, now - std::chrono::hours(3 - i));
+      }
+      Check(c.Fetch(keys[0], "e.lib"), "cache entry");
+      c.Store(keys[2], lib.data(), lib.size());
+      c.Evict();
+
+      bool first = c.Fetch(keys[0], "e.lib");
+      bool second = c.Fetch(keys[1], "e.lib");
+      bool third = c.Fetch(keys[2], "e.lib");
+      if (policy == CEP_LRU)
+        Check(first && !second && third, "LRU eviction");
+      else
+        Check(!first && second && third, "FIFO eviction");
+    }
+
+    // unlimited
+    COutputCache all(cacheDir.string(), 0, CEP_LRU);
+    all.Store(keys[0], lib.data(), lib.size());
+    all.Evict();
+    Check(all.Fetch(keys[0], "e.lib") && all.Fetch(keys[2], "e.lib"),
+          "unlimited cache");
+  }
+
+  // -MD next to the library, the paths escaped for Make and Ninja
+  {
+    WriteText("in put#1.def", defText);
+    WriteText("jobs.rsp", "\"in put#1.def\" \"out $a#.lib\"\n");
+    Check(Run("--batch -MD @jobs.rsp"), "-MD run");
+    Check(ReadText("out $a#.lib.d") == "out\\ $$a\\#.lib: \\\n"
+                                      "  in\\ put\\#1.def\n",
+          "depfile escapes");
+  }
+
+  // -MF of a fan-out: both libraries, the input, the allow list and the
+  // consumer object
+  {
+    WriteText("k.def", defText);
+    WriteText("allow.txt", "Alpha\n");
+    WriteObject("use.obj", "__imp__Alpha");
+    Check(Run("--targets 32,64 --allow-list allow.txt --used-by use.obj "
+              "-MF k.d k.def k_{arch}.lib"),
+          "-MF run");
+    Check(ReadText("k.d") == "k_x86.lib k_x64.lib: \\\n"
+                             "  k.def \\\n"
+                             "  allow.txt \\\n"
+                             "  use.obj\n",
+          "depfile of targets");
+    Check(!fs::exists("k_x86.lib.d"), "-MF, no depfile next to the library");
+  }
+
+  // --if-changed leaves an identical library and its time alone, a changed
+  // one is written
+  {
+    WriteText("c.def", defText);
+    Check(Run("c.def c.lib"), "first build");
+    std::string first = ReadText("c.lib");
+    fs::file_time_type old =
+        fs::last_write_time("c.lib") - std::chrono::hours(1);
+    fs::last_write_time("c.lib", old);
+
+    Check(Run("--if-changed c.def c.lib"), "--if-changed run");
+    Check(fs::last_write_time("c.lib") == old && ReadText("c.lib") == first,
+          "identical library left alone");
+
+    Check(Run("c.def c.lib"), "build without --if-changed");
+    Check(fs::last_write_time("c.lib") != old, "library written again");
+
+    fs::last_write_time("c.lib", old);
+    WriteText("c.def", std::string(defText) + "Gamma\n");
+    Check(Run("--if-changed c.def c.lib"), "--if-changed run, new export");
+    Check(fs::last_write_time("c.lib") != old &&
+              ReadText("c.lib").find("Gamma") != std::string::npos,
+          "changed library written");
+  }
+
+  fs::current_path(fs::temp_directory_path());
+  fs::remove_all(dir);
+  return failures == 0 ? 0 : 1;
+}